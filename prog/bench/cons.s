@@ -0,0 +1,19 @@
+; cons.s: consumer on board 1 of the producer/consumer pair (prod.s+cons.s).
+; Receives 200 bytes, waiting on NI, and sums them.
+;! acc=64
+
+	.text 00
+	LD	IX,0c8
+	EOR	ACC,ACC
+	ST	ACC,(sum)
+wait:	BNI	wait
+	IN
+	ADD	ACC,(sum)
+	ST	ACC,(sum)
+	SUB	IX,1
+	BNZ	wait
+	LD	ACC,(sum)
+	HLT
+
+	.data 00
+sum:	.byte 0
@@ -0,0 +1,49 @@
+; crc.s: CRC-8 (polynomial x^8 + x^2 + x + 1, bitwise) over 128 bytes
+; generated by x = 5x + 3.  The CRC runs over 4 passes of the buffer.
+;! acc=65
+
+	.text 00
+	LD	ACC,5a			; fill buf[0..127]
+	EOR	IX,IX
+fill:	ST	ACC,(tmp)		; acc = 5 * acc + 3
+	SLL	ACC
+	SLL	ACC
+	ADD	ACC,(tmp)
+	ADD	ACC,3
+	ST	ACC,(IX+80)
+	ADD	IX,1
+	CMP	IX,80
+	BNZ	fill
+
+	LD	ACC,4
+	ST	ACC,(passes)
+	EOR	ACC,ACC			; crc
+pass:	LD	IX,0
+	ST	IX,(i)
+byte:	LD	IX,(i)
+	EOR	ACC,(IX+80)
+	LD	IX,8
+bit:	SLL	ACC
+	BNC	nox
+	EOR	ACC,7
+nox:	SUB	IX,1
+	BNZ	bit
+	LD	IX,(i)
+	ADD	IX,1
+	ST	IX,(i)
+	CMP	IX,80
+	BNZ	byte
+	ST	ACC,(tmp)
+	LD	ACC,(passes)
+	SUB	ACC,1
+	ST	ACC,(passes)
+	LD	ACC,(tmp)
+	LD	IX,(passes)
+	ADD	IX,0
+	BNZ	pass
+	HLT
+
+	.data 00
+passes:	.byte 0
+i:	.byte 0
+tmp:	.byte 0
@@ -0,0 +1,108 @@
+; muldiv.s: 8x8 -> 16 bit multiplication by shift-and-add and 16/8 bit
+; division by shift-and-subtract.  Each pair (x, y) is multiplied and the
+; product divided by y again; the quotients are summed.  4 rounds of 32 pairs.
+;! acc=e4
+
+	.text 00
+	LD	ACC,4
+	ST	ACC,(rounds)
+	EOR	ACC,ACC
+	ST	ACC,(sum)
+round:	EOR	IX,IX
+pair:	ST	IX,(i)
+	LD	ACC,(IX+xs)		; multiplicand ml:mh = x
+	ST	ACC,(ml)
+	LD	ACC,(IX+ys)		; multiplier r = y
+	ST	ACC,(r)
+	ST	ACC,(y)
+	EOR	ACC,ACC
+	ST	ACC,(mh)
+	ST	ACC,(lo)
+	ST	ACC,(hi)
+	LD	IX,8
+mul:	LD	ACC,(r)
+	SRL	ACC			; cf = next bit of the multiplier
+	ST	ACC,(r)
+	BNC	mul_shift
+	LD	ACC,(lo)		; hi:lo += mh:ml
+	ADD	ACC,(ml)
+	ST	ACC,(lo)
+	LD	ACC,(hi)
+	ADC	ACC,(mh)
+	ST	ACC,(hi)
+mul_shift:
+	LD	ACC,(ml)		; mh:ml <<= 1
+	SLL	ACC
+	ST	ACC,(ml)
+	LD	ACC,(mh)
+	RLA	ACC
+	ST	ACC,(mh)
+	SUB	IX,1
+	BNZ	mul
+
+	EOR	ACC,ACC			; (hi:lo) / y, restoring division
+	ST	ACC,(rem)
+	ST	ACC,(ql)
+	ST	ACC,(qh)
+	LD	IX,10			; 16 bits
+div:	LD	ACC,(lo)		; rem:hi:lo <<= 1
+	SLL	ACC
+	ST	ACC,(lo)
+	LD	ACC,(hi)
+	RLA	ACC
+	ST	ACC,(hi)
+	LD	ACC,(rem)
+	RLA	ACC
+	ST	ACC,(rem)
+	SUB	ACC,(y)			; cf = 1 if rem >= y
+	BNC	div_zero
+	ST	ACC,(rem)
+	SCF
+	BA	div_shift
+div_zero:
+	RCF
+div_shift:
+	LD	ACC,(ql)		; qh:ql = qh:ql << 1 | cf
+	RLA	ACC
+	ST	ACC,(ql)
+	LD	ACC,(qh)
+	RLA	ACC
+	ST	ACC,(qh)
+	SUB	IX,1
+	BNZ	div
+
+	LD	ACC,(sum)		; sum += ql + qh + rem
+	ADD	ACC,(ql)
+	ADD	ACC,(qh)
+	ADD	ACC,(rem)
+	ST	ACC,(sum)
+	LD	IX,(i)
+	ADD	IX,1
+	CMP	IX,20
+	BNZ	pair
+	LD	ACC,(rounds)
+	SUB	ACC,1
+	ST	ACC,(rounds)
+	BNZ	round
+	LD	ACC,(sum)
+	HLT
+
+	.data 00
+rounds:	.byte 0
+sum:	.byte 0
+i:	.byte 0
+ml:	.byte 0
+mh:	.byte 0
+r:	.byte 0
+y:	.byte 0
+lo:	.byte 0
+hi:	.byte 0
+rem:	.byte 0
+ql:	.byte 0
+qh:	.byte 0
+
+	.data 40
+xs:	.byte 0xb6,0x0e,0x75,0x0f,0xc7,0xba,0x21,0xd9,0x9c,0xae,0x30,0x4f,0x31,0x8c,0xb1,0x00
+	.byte 0x4f,0x2c,0x1f,0xbd,0x82,0x1e,0xc6,0x55,0x9e,0x95,0xc3,0xa0,0x6c,0x69,0xe7,0x5b
+ys:	.byte 0x4e,0x11,0x4a,0x5c,0x33,0x46,0x37,0x1f,0x20,0x58,0x69,0x0f,0x4b,0x56,0x60,0x0a
+	.byte 0x68,0x39,0x24,0x36,0x0f,0x4b,0x25,0x75,0x75,0x1a,0x66,0x17,0x34,0x64,0x64,0x75
@@ -0,0 +1,22 @@
+; prod.s: producer on board 0 of the producer/consumer pair (prod.s+cons.s).
+; Sends 200 bytes of x = 5x + 3 to the other board, waiting on NO.
+;! acc=fb
+
+	.text 00
+	LD	IX,0c8
+	LD	ACC,33
+	ST	ACC,(x)
+next:	LD	ACC,(x)
+	SLL	ACC
+	SLL	ACC
+	ADD	ACC,(x)
+	ADD	ACC,3
+	ST	ACC,(x)
+wait:	BNO	wait			; previous byte not taken yet
+	OUT
+	SUB	IX,1
+	BNZ	next
+	HLT
+
+	.data 00
+x:	.byte 0
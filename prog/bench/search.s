@@ -0,0 +1,69 @@
+; search.s: naive search of a 3-byte pattern in 128 bytes of a 4-letter
+; text (bits 4..3 of x = 5x + 3).  Counts the matches, twice over.
+;! acc=08
+
+	.text 00
+	LD	ACC,11			; fill text[0..127]
+	EOR	IX,IX
+fill:	ST	ACC,(tmp)
+	SLL	ACC
+	SLL	ACC
+	ADD	ACC,(tmp)
+	ADD	ACC,3
+	ST	ACC,(tmp)
+	SRL	ACC
+	SRL	ACC
+	SRL	ACC
+	AND	ACC,3
+	ST	ACC,(IX+80)
+	LD	ACC,(tmp)
+	ADD	IX,1
+	CMP	IX,80
+	BNZ	fill
+
+	EOR	ACC,ACC
+	ST	ACC,(count)
+	LD	ACC,2
+	ST	ACC,(rounds)
+round:	EOR	ACC,ACC
+	ST	ACC,(i)
+at:	EOR	ACC,ACC
+	ST	ACC,(j)
+match:	LD	IX,(j)			; pat[j] == text[i + j] ?
+	LD	ACC,(IX+pat)
+	ST	ACC,(c)
+	LD	IX,(i)
+	ADD	IX,(j)
+	LD	ACC,(IX+80)
+	CMP	ACC,(c)
+	BNZ	advance
+	LD	ACC,(j)
+	ADD	ACC,1
+	ST	ACC,(j)
+	CMP	ACC,(plen)
+	BNZ	match
+	LD	ACC,(count)		; found
+	ADD	ACC,1
+	ST	ACC,(count)
+advance:
+	LD	ACC,(i)
+	ADD	ACC,1
+	ST	ACC,(i)
+	CMP	ACC,7e			; 128 - 3 + 1
+	BNZ	at
+	LD	ACC,(rounds)
+	SUB	ACC,1
+	ST	ACC,(rounds)
+	BNZ	round
+	LD	ACC,(count)
+	HLT
+
+	.data 00
+tmp:	.byte 0
+count:	.byte 0
+rounds:	.byte 0
+i:	.byte 0
+j:	.byte 0
+c:	.byte 0
+plen:	.byte 3
+pat:	.byte 1,2,1
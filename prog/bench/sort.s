@@ -0,0 +1,54 @@
+; sort.s: bubble sort of 64 bytes generated by x = 5x + 3 (7 bits, so
+; that CMP compares them correctly).  2 rounds with different data.
+;! acc=37 ix=7d
+
+	.text 00
+	LD	ACC,2
+	ST	ACC,(rounds)
+	LD	ACC,2a
+	ST	ACC,(seed)
+round:	EOR	IX,IX			; fill arr[0..63]
+fill:	LD	ACC,(seed)		; seed = 5 * seed + 3
+	SLL	ACC
+	SLL	ACC
+	ADD	ACC,(seed)
+	ADD	ACC,3
+	ST	ACC,(seed)
+	AND	ACC,7f
+	ST	ACC,(IX+40)
+	ADD	IX,1
+	CMP	IX,40
+	BNZ	fill
+
+pass:	EOR	ACC,ACC
+	ST	ACC,(swapped)
+	EOR	IX,IX
+cmp:	LD	ACC,(IX+40)
+	CMP	ACC,(IX+41)
+	BLE	next
+	ST	ACC,(tmp)		; swap arr[i] and arr[i+1]
+	LD	ACC,(IX+41)
+	ST	ACC,(IX+40)
+	LD	ACC,(tmp)
+	ST	ACC,(IX+41)
+	ST	ACC,(swapped)		; non-zero
+next:	ADD	IX,1
+	CMP	IX,3f
+	BNZ	cmp
+	LD	ACC,(swapped)
+	ADD	ACC,0
+	BNZ	pass
+
+	LD	ACC,(rounds)
+	SUB	ACC,1
+	ST	ACC,(rounds)
+	BNZ	round
+	LD	ACC,(60)		; arr[32] and arr[63]
+	LD	IX,(7f)
+	HLT
+
+	.data 00
+rounds:	.byte 0
+seed:	.byte 0
+swapped: .byte 0
+tmp:	.byte 0
@@ -0,0 +1,88 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	alu.c
+ *	Descrioption:	reference formulas of the arithmetic instructions
+ */
+
+#include	"cpuboard.h"
+#include	"alu.h"
+
+/* キャリーフラグ判定 */
+Bit carry_flag(Uword opA, Uword opB) {
+    Uword msb_A = opA >> 7;
+    Uword msb_B = opB >> 7;
+    Uword CY = ((opA & 0x7f) + (opB & 0x7f)) >> 7;
+    if ((msb_A & msb_B) | (msb_A & CY) | (msb_B & CY)) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* オーバーフローフラグ判定 */
+Bit overflow_flag(Uword opA, Uword opB) {
+    Uword msb_A = opA >> 7;
+    Uword msb_B = opB >> 7;
+    Uword CY = ((opA & 0x7f) + (opB & 0x7f)) >> 7;
+    if ((msb_A & msb_B & !CY) | (!msb_A & !msb_B & CY)) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* ネガティブフラグ判定 */
+Bit negative_flag(Uword result) {
+    if (result & 0x80) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* ゼロフラグ判定 */
+Bit zero_flag(Uword result) {
+    if (result & 0xff) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+
+/*
+ * 算術命令の参照実装 (もとの add/adc/sub/sbc/compare と同じ式)
+ * alugen はこれと全組合せを比較してから ALU表を出力する.
+ */
+int alu_ref(int slot, Uword opA, Uword opB) {
+    Bit cf = (slot == ALU_ADC + 1 || slot == ALU_SBC + 1);
+    Uword result = 0;
+    Bit c = 0, v = 0;
+
+    switch (slot) {
+        case ALU_ADD:
+            result = opA + opB;
+            c = carry_flag(opA, opB);
+            v = (c | overflow_flag(opA, opB));
+            break;
+        case ALU_ADC:
+        case ALU_ADC + 1:
+            result = opA + opB + cf;
+            c = carry_flag(opA, opB);
+            v = overflow_flag(opA, opB);
+            break;
+        case ALU_SBC:
+        case ALU_SBC + 1:
+            result = opA + (~opB + 0x01) + (~cf + 0x01);
+            c = carry_flag(opA, ((~opB + 0x01) + (~cf + 0x01)));
+            v = overflow_flag(opA, opB);
+            break;
+        case ALU_CMP:   /* cf は変えない */
+            result = opA + (~opB + 1);
+            v = overflow_flag(opA, (~opB + 1));
+            break;
+    }
+    return c << 11 | v << 10 | negative_flag(result) << 9
+                 | zero_flag(result) << 8 | result;
+}
@@ -0,0 +1,46 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	alu.h
+ *	Descrioption:	table-driven ALU for the arithmetic instructions
+ */
+
+/*=============================================================================
+ *   ALU Table
+ *
+ *	alu_tab[slot][opA][opB] holds the flags packed as PackedFlags()
+ *	(cf vf nf zf), a byte each.  The result is a plain 8-bit addition
+ *	or subtraction (AluAdd(), AluSub()).  ADC and SBC take two slots,
+ *	the second one for cf=1; SUB is SBC with cf=0.  The table is
+ *	generated by alugen (alu_tab.c) after an exhaustive check of both
+ *	against alu_ref().
+ *===========================================================================*/
+#define	ALU_ADD		0
+#define	ALU_ADC		1	/* + cf */
+#define	ALU_SBC		3	/* + cf */
+#define	ALU_SUB		ALU_SBC
+#define	ALU_CMP		5
+#define	ALU_SLOTS	6
+
+typedef unsigned char	AluFlags;
+
+extern const AluFlags	alu_tab[ALU_SLOTS][256][256];
+
+#define	AluCF(F)	((F) >> 3 & 1)
+#define	AluVF(F)	((F) >> 2 & 1)
+#define	AluNF(F)	((F) >> 1 & 1)
+#define	AluZF(F)	((F) & 1)
+
+#define	AluAdd(A,B,C)	((Uword)((A) + (B) + (C)))
+#define	AluSub(A,B,C)	((Uword)((A) - (B) - (C)))
+
+
+/*=============================================================================
+ *   Reference Formulas (the flag specification)
+ *===========================================================================*/
+Bit	carry_flag(Uword, Uword);
+Bit	overflow_flag(Uword, Uword);
+Bit	negative_flag(Uword);
+Bit	zero_flag(Uword);
+int	alu_ref(int, Uword, Uword);	/* flags << 8 | result */
@@ -0,0 +1,182 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	alugen.c
+ *	Descrioption:	generator of the ALU table (checked against alu_ref)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	"cpuboard.h"
+#include	"alu.h"
+
+
+int	spec(int, int, int);
+int	plain(int, int, int);
+int	check(void);
+void	emit_table(FILE *);
+
+
+/*=============================================================================
+ *   Flag Specification
+ *
+ *	Written with 9-bit sums, independently of the formulas in alu.c:
+ *	cf is the carry out of bit 7 and the overflow is the sign rule of an
+ *	8-bit addition.  The board's own conventions are kept: ADD sets vf
+ *	on carry as well, ADC's carry ignores the carry in, SUB/SBC report
+ *	the overflow of opA + opB and their carry is the one of opA plus
+ *	the negated subtrahend, and CMP leaves cf alone (0 in the table).
+ *===========================================================================*/
+#define	OV(X,Y,S)	((~((X) ^ (Y)) & ((X) ^ (S)) & 0x80) != 0)
+
+int
+spec(int slot, int a, int b)
+{
+	int	cin = (slot == ALU_ADC + 1 || slot == ALU_SBC + 1);
+	int	r = 0, c = 0, v = 0, t;
+
+	switch( slot ) {
+	   case ALU_ADD:
+		r = a + b;
+		c = r >> 8;
+		v = c | OV(a,b,a + b);
+		break;
+	   case ALU_ADC:
+	   case ALU_ADC + 1:
+		r = a + b + cin;
+		c = (a + b) >> 8;
+		v = OV(a,b,a + b);
+		break;
+	   case ALU_SBC:
+	   case ALU_SBC + 1:
+		t = (-b - cin) & 0xff;
+		r = a - b - cin;
+		c = (a + t) >> 8;
+		v = OV(a,b,a + b);
+		break;
+	   case ALU_CMP:
+		t = -b & 0xff;
+		r = a - b;
+		v = OV(a,t,a + t);
+		break;
+	}
+	r &= 0xff;
+	return c << 11 | v << 10 | (r >> 7) << 9 | (r == 0) << 8 | r;
+}
+
+
+/*
+ *   The result as the simulator computes it (not from the table)
+ */
+int
+plain(int slot, int a, int b)
+{
+	int	cin = (slot == ALU_ADC + 1 || slot == ALU_SBC + 1);
+
+	switch( slot ) {
+	   case ALU_ADD:
+	   case ALU_ADC:
+	   case ALU_ADC + 1:
+		return AluAdd(a,b,cin);
+	   case ALU_SBC:
+	   case ALU_SBC + 1:
+		return AluSub(a,b,cin);
+	   case ALU_CMP:
+		return AluSub(a,b,0);
+	}
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Exhaustive Check: operation x carry in x opA x opB (2^17 per operation)
+ *
+ *	The flags of the specification against the reference formulas, and
+ *	its result against the plain addition or subtraction.
+ *===========================================================================*/
+int
+check(void)
+{
+	static int	op[] = { ALU_ADD, ALU_ADC, ALU_SBC, ALU_CMP };
+	static char	*name[] = { "ADD", "ADC", "SUB/SBC", "CMP" };
+	int	i, cin, a, b, slot, s, r, errors = 0;
+
+	for( i = 0 ; i < 4 ; i++ ) {
+		for( cin = 0 ; cin < 2 ; cin++ ) {
+			slot = op[i];
+			if( slot == ALU_ADC || slot == ALU_SBC )
+				slot += cin;
+			for( a = 0 ; a < 256 ; a++ )
+				for( b = 0 ; b < 256 ; b++ ) {
+					s = spec(slot,a,b);
+					r = alu_ref(slot,a,b);
+					if( s == r
+					    && (s & 0xff) == plain(slot,a,b) )
+						continue;
+					if( errors++ < 10 )
+						fprintf(stderr,"%s cf=%d "
+						  "%02x,%02x: spec %03x, "
+						  "reference %03x, plain "
+						  "%02x\n",name[i],cin,a,b,s,r,
+						  plain(slot,a,b));
+				}
+		}
+	}
+	return errors;
+}
+
+
+/*=============================================================================
+ *   Output
+ *===========================================================================*/
+void
+emit_table(FILE *fp)
+{
+	int	slot, a, b;
+
+	fprintf(fp,"/* generated by alugen: do not edit */\n\n");
+	fprintf(fp,"#include\t\"cpuboard.h\"\n#include\t\"alu.h\"\n\n");
+	fprintf(fp,"const AluFlags alu_tab[ALU_SLOTS][256][256] = {\n");
+	for( slot = 0 ; slot < ALU_SLOTS ; slot++ ) {
+		fprintf(fp,"    {\t/* slot %d */\n",slot);
+		for( a = 0 ; a < 256 ; a++ ) {
+			fprintf(fp,"\t{");
+			for( b = 0 ; b < 256 ; b++ )
+				fprintf(fp,"%s0x%x%s",
+					(b % 16) ? "" : "\n\t ",spec(slot,a,b) >> 8,
+					(b == 255) ? "" : ",");
+			fprintf(fp," },\n");
+		}
+		fprintf(fp,"    },\n");
+	}
+	fprintf(fp,"};\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	FILE	*fp;
+	int	errors;
+
+	if( argc != 2 ) {
+		fprintf(stderr,"Usage: alugen alu_tab.c\n");
+		exit(1);
+	}
+	if( (errors = check()) != 0 ) {
+		fprintf(stderr,"alugen: %d cases differ from the reference\n",
+								errors);
+		exit(1);
+	}
+	fprintf(stderr,"alugen: 4 operations x 2^17 cases agree with "
+						"the reference\n");
+
+	if( (fp = fopen(argv[1],"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",argv[1]);
+		exit(1);
+	}
+	emit_table(fp);
+	fclose(fp);
+	return 0;
+}
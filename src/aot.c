@@ -0,0 +1,106 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	aot.c
+ *	Descrioption:	loading and running translated programs
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<dlfcn.h>
+#include	"cpuboard.h"
+#include	"aot.h"
+
+
+/*=============================================================================
+ *   Load/Unload a Translated Program
+ *===========================================================================*/
+int
+aot_load(Cpub *cpub, char *file)
+{
+	Aot	*aot;
+	char	path[1024];
+
+	aot_unload(cpub);
+
+	if( (aot = malloc(sizeof(Aot))) == NULL )
+		return -1;
+	snprintf(path,sizeof(path),"%s%s",strchr(file,'/') ? "" : "./",file);
+	if( (aot->handle = dlopen(path,RTLD_NOW | RTLD_LOCAL)) == NULL ) {
+		fprintf(stderr,"%s\n",dlerror());
+		free(aot);
+		return -1;
+	}
+	aot->text = dlsym(aot->handle,"aot_text");
+	aot->run = (AotRun *)dlsym(aot->handle,"aot_run");
+	if( aot->text == NULL || aot->run == NULL ) {
+		fprintf(stderr,"%s: not a translated program\n",file);
+		dlclose(aot->handle);
+		free(aot);
+		return -1;
+	}
+
+	cpub->aot = aot;
+	if( !aot_valid(cpub) )
+		fprintf(stderr,"Warning: the text area differs from %s; "
+				"it will be interpreted.\n",file);
+	return 0;
+}
+
+
+void
+aot_unload(Cpub *cpub)
+{
+	if( cpub->aot == NULL )
+		return;
+	dlclose(cpub->aot->handle);
+	free(cpub->aot);
+	cpub->aot = NULL;
+}
+
+
+/*
+ *   A translation is only used while the text area is the one it was
+ *   made from (the program may have been reloaded or edited with 'w').
+ */
+int
+aot_valid(Cpub *cpub)
+{
+	return cpub->aot != NULL
+	    && !memcmp(cpub->aot->text,TextOf(cpub),IMEMORY_SIZE);
+}
+
+
+/*=============================================================================
+ *   Run Natively
+ *
+ *	Instructions at addresses which were not translated (reachable
+ *	only through JR or set by hand) are interpreted one at a time.
+ *	One of them may store into the text; then the translation is no
+ *	longer valid and AOT_FALLBACK is returned to go on interpreting.
+ *	The native code counts the performance counters; the instructions
+ *	it ran are added up in cpub->native, since they miss the coverage.
+ *===========================================================================*/
+int
+aot_exec(Cpub *cpub, int breakp, unsigned long *count)
+{
+	unsigned long	before;
+	int	status;
+
+	while( *count > 0 ) {
+		before = *count;
+		status = cpub->aot->run(cpub,breakp,count);
+		cpub->native += before - *count;
+		if( status != AOT_FALLBACK )
+			return status;
+		status = step_full(cpub);
+		--*count;
+		if( status == RUN_HALT || cpub->pc == breakp )
+			return status;
+		if( !aot_valid(cpub) )
+			return AOT_FALLBACK;
+	}
+	return RUN_STEP;
+}
@@ -0,0 +1,33 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	aot.h
+ *	Descrioption:	ahead-of-time translated programs (shared objects)
+ */
+
+/*=============================================================================
+ *   Interface of a Translated Program
+ *
+ *	aot_text[]	the text area the program was translated from
+ *	aot_run()	runs from cpub->pc until it halts, reaches the
+ *			break-point (after at least one instruction) or
+ *			has executed *count instructions; *count is
+ *			decreased by the number of executed instructions.
+ *			Returns RUN_HALT, RUN_STEP, or AOT_FALLBACK when
+ *			the pc is at an address that was not translated.
+ *===========================================================================*/
+#define	AOT_FALLBACK	2
+
+typedef int	AotRun(Cpub *, int, unsigned long *);
+
+typedef struct aot {
+	void		*handle;	/* dlopen() handle */
+	Uword		*text;
+	AotRun		*run;
+} Aot;
+
+int	aot_load(Cpub *, char *);
+void	aot_unload(Cpub *);
+int	aot_valid(Cpub *);
+int	aot_exec(Cpub *, int, unsigned long *);
@@ -0,0 +1,354 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	asm.c
+ *	Descrioption:	disassembler and assembler driven by the decode table
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<strings.h>
+#include	<ctype.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Disassemble an Instruction
+ *
+ *	mem is the program area.  Writes the instruction at a into buf
+ *	and returns its length in words.
+ *===========================================================================*/
+int
+disasm(Uword *mem, Addr a, char *buf)
+{
+	const Decode	*d = &isa_decode[mem[a & 0xff]];
+	Uword		opr = mem[(a + 1) & 0xff];
+	char		*reg = d->a ? "IX" : "ACC";
+	char		*s;
+
+	buf += sprintf(buf,"%s",d->name);
+	if( !strcmp(d->operands,"d") || !strcmp(d->operands,"cd") )
+		sprintf(buf," 0x%02x",opr);
+	else if( !strcmp(d->operands,"A") || !strcmp(d->operands,"sA") )
+		sprintf(buf," %s",reg);
+	else if( !strcmp(d->operands,"AB") ) {
+		buf += sprintf(buf," %s,",reg);
+		for( s = isa_mode_syntax[d->b] ; *s ; s++ )
+			if( *s == 'd' )
+				buf += sprintf(buf,"0x%02x",opr);
+			else
+				*buf++ = *s;
+		*buf = '\0';
+	}
+	return d->len;
+}
+
+
+/*=============================================================================
+ *   Assembler
+ *
+ *	Two passes over the source: the first one assigns the addresses of
+ *	the labels, the second one encodes.  An instruction is encoded by
+ *	looking for the decode table entries with the same mnemonic and
+ *	operands; the word equal to the operation code (e.g. HLT 0x0f) is
+ *	preferred, otherwise the lowest one.
+ *
+ *	    label:	mnemonic operands	; comment
+ *	    .text [addr]   .data [addr]   .byte value[,value...]
+ *
+ *	Numbers are hexadecimal and start with a digit (0x is optional).
+ *===========================================================================*/
+#define	LINESIZE	256
+#define	LABELMAX	256
+#define	LABELSIZE	32
+
+typedef struct assembler {
+	int	pass;
+	int	line;
+	Addr	loc;			/* location counter */
+	int	nlabel;
+	char	label[LABELMAX][LABELSIZE];
+	Addr	value[LABELMAX];
+	char	undef[LABELSIZE];	/* undefined label (second pass) */
+	Uword	image[MEMORY_SIZE];
+	Uword	used[MEMORY_SIZE];
+} Assembler;
+
+static int	asm_line(Assembler *, char *);
+static int	asm_insn(Assembler *, char *, char *);
+static int	match_operands(const Decode *, char *, Assembler *, Uword *);
+static int	get_value(Assembler *, char **, Uword *);
+static int	asm_error(Assembler *, char *, char *);
+
+
+int
+asm_source(Cpub *cpub, char *src)
+{
+	static Assembler	as;	/* too large for the stack */
+	char	line[LINESIZE];
+	char	*p, *e;
+	int	n, i;
+
+	memset(&as,0,sizeof(as));
+	for( as.pass = 1 ; as.pass <= 2 ; as.pass++ ) {
+		as.loc = 0x000;
+		as.line = 0;
+		for( p = src ; *p ; p = *e ? e + 1 : e ) {
+			for( e = p ; *e && *e != '\n' ; e++ )
+				;
+			n = e - p < LINESIZE - 1 ? e - p : LINESIZE - 1;
+			memcpy(line,p,n);
+			line[n] = '\0';
+			as.line++;
+			if( asm_line(&as,line) != 0 )
+				return -1;
+		}
+	}
+
+	text_private(cpub);
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		if( as.used[i] )
+			cpub->mem[i] = as.image[i];
+	return 0;
+}
+
+
+int
+asm_file(Cpub *cpub, char *file)
+{
+	FILE	*fp;
+	char	*src;
+	long	size;
+	int	r;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	fseek(fp,0L,SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	src = malloc(size + 1);
+	size = fread(src,1,size,fp);
+	src[size] = '\0';
+	fclose(fp);
+
+	r = asm_source(cpub,src);
+	free(src);
+	return r;
+}
+
+
+static int
+asm_line(Assembler *as, char *line)
+{
+	char	*p, *q, *mnem, *ops;
+	Uword	v;
+	int	i;
+
+	if( (p = strchr(line,';')) != NULL )
+		*p = '\0';
+
+	/*
+	 *   Labels
+	 */
+	for( p = line ; ; p = q + 1 ) {
+		while( isspace((unsigned char)*p) ) p++;
+		for( q = p ; isalnum((unsigned char)*q) || *q == '_' ; q++ )
+			;
+		if( *q != ':' || q == p )
+			break;
+		*q = '\0';
+		if( as->pass == 2 )
+			continue;
+		if( isdigit((unsigned char)*p) || strlen(p) >= LABELSIZE )
+			return asm_error(as,"invalid label",p);
+		for( i = 0 ; i < as->nlabel ; i++ )
+			if( !strcmp(as->label[i],p) )
+				return asm_error(as,"duplicate label",p);
+		if( as->nlabel == LABELMAX )
+			return asm_error(as,"too many labels",p);
+		strcpy(as->label[as->nlabel],p);
+		as->value[as->nlabel++] = as->loc;
+	}
+	if( *p == '\0' )
+		return 0;
+
+	/*
+	 *   Split into the mnemonic and the operands (blanks removed)
+	 */
+	mnem = p;
+	while( *p && !isspace((unsigned char)*p) ) p++;
+	if( *p ) *p++ = '\0';
+	ops = p;
+	for( q = p ; *p ; p++ )
+		if( !isspace((unsigned char)*p) )
+			*q++ = *p;
+	*q = '\0';
+	p = ops;
+	as->undef[0] = '\0';
+
+	/*
+	 *   Directives
+	 */
+	if( !strcmp(mnem,".text") || !strcmp(mnem,".data") ) {
+		v = 0;
+		if( *p && (get_value(as,&p,&v) != 0 || *p) )
+			return asm_error(as,*as->undef ? "undefined label"
+					      : "invalid address",
+					 *as->undef ? as->undef : mnem);
+		as->loc = (mnem[1] == 'd' ? 0x100 : 0x000) | v;
+		return 0;
+	}
+	if( !strcmp(mnem,".byte") ) {
+		do {
+			if( get_value(as,&p,&v) != 0 )
+				return asm_error(as,*as->undef ? "undefined label"
+						      : "invalid value",
+						 *as->undef ? as->undef : p);
+			as->image[as->loc] = v;
+			as->used[as->loc] = 1;
+			as->loc = (as->loc & 0x100) | ((as->loc + 1) & 0xff);
+		} while( *p++ == ',' );
+		if( p[-1] != '\0' )
+			return asm_error(as,"junk after the values",p - 1);
+		return 0;
+	}
+	return asm_insn(as,mnem,p);
+}
+
+
+static int
+asm_insn(Assembler *as, char *mnem, char *operands)
+{
+	const Decode	*d;
+	Uword		opr, word;
+	int		i, found = -1;
+	Addr		area = as->loc & 0x100;
+
+	for( i = 0 ; i < 256 ; i++ ) {
+		d = &isa_decode[i];
+		if( d->code == INVALID || strcasecmp(d->name,mnem) != 0 )
+			continue;
+		if( match_operands(d,operands,as,&word) != 0 )
+			continue;
+		if( found < 0 || i == d->code ) {
+			found = i;
+			opr = word;
+		}
+	}
+	if( found < 0 ) {
+		if( *as->undef )
+			return asm_error(as,"undefined label",as->undef);
+		for( i = 0 ; i < 256 ; i++ )
+			if( !strcasecmp(isa_decode[i].name,mnem) )
+				return asm_error(as,"invalid operands",operands);
+		return asm_error(as,"unknown instruction",mnem);
+	}
+
+	as->image[as->loc] = found;
+	as->used[as->loc] = 1;
+	as->loc = area | ((as->loc + 1) & 0xff);
+	if( isa_decode[found].len == 2 ) {
+		as->image[as->loc] = opr;
+		as->used[as->loc] = 1;
+		as->loc = area | ((as->loc + 1) & 0xff);
+	}
+	return 0;
+}
+
+
+/*
+ *   Match the operands against an entry; *opr gets the second word
+ */
+static int
+match_operands(const Decode *d, char *p, Assembler *as, Uword *opr)
+{
+	char	*fmt = d->operands;
+	char	*reg = d->a ? "IX" : "ACC";
+	char	*s;
+
+	*opr = 0;
+	if( *fmt == 'c' || *fmt == 's' )	/* suffix of the mnemonic */
+		fmt++;
+	for( ; *fmt ; fmt++ ) {
+		switch( *fmt ) {
+		   case '-':
+			break;
+		   case 'd':
+			if( get_value(as,&p,opr) != 0 )
+				return -1;
+			break;
+		   case 'A':
+			if( strncasecmp(p,reg,strlen(reg)) != 0 )
+				return -1;
+			p += strlen(reg);
+			break;
+		   case 'B':
+			if( *p++ != ',' )
+				return -1;
+			for( s = isa_mode_syntax[d->b] ; *s ; s++ ) {
+				if( *s == 'd' ) {
+					if( get_value(as,&p,opr) != 0 )
+						return -1;
+				} else if( toupper((unsigned char)*p++) != *s )
+					return -1;
+			}
+			break;
+		}
+	}
+	return *p == '\0' ? 0 : -1;
+}
+
+
+/*
+ *   A number or a label; labels are undefined in the first pass
+ */
+static int
+get_value(Assembler *as, char **pp, Uword *v)
+{
+	char		name[LABELSIZE];
+	char		*p = *pp, *e;
+	unsigned long	n;
+	int		i;
+
+	if( isdigit((unsigned char)*p) ) {
+		n = strtoul(p,&e,16);
+		if( n > 0xff )
+			return -1;
+		*v = n;
+		*pp = e;
+		return 0;
+	}
+	for( e = p ; isalnum((unsigned char)*e) || *e == '_' ; e++ )
+		;
+	if( e == p || e - p >= LABELSIZE )
+		return -1;
+	memcpy(name,p,e - p);
+	name[e - p] = '\0';
+	if( !strcasecmp(name,"ACC") || !strcasecmp(name,"IX") )
+		return -1;
+	*pp = e;
+	*v = 0;
+	for( i = 0 ; i < as->nlabel ; i++ )
+		if( !strcmp(as->label[i],name) ) {
+			*v = as->value[i] & 0xff;
+			return 0;
+		}
+	if( as->pass == 1 )
+		return 0;
+	strcpy(as->undef,name);
+	return -1;
+}
+
+
+static int
+asm_error(Assembler *as, char *mesg, char *token)
+{
+	fprintf(stderr,"line %d: %s: %s\n",as->line,mesg,token);
+	return -1;
+}
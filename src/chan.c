@@ -0,0 +1,252 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	chan.c
+ *	Descrioption:	input/output channels of a board (files and pipes)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<poll.h>
+#include	"cpuboard.h"
+#include	"chan.h"
+
+
+static Channel	*chan_get(Cpub *);
+static void	chan_fill(Channel *, int);
+static void	chan_drain(Channel *);
+
+
+/*=============================================================================
+ *   Open/Close
+ *===========================================================================*/
+static Channel *
+chan_get(Cpub *cpub)
+{
+	Channel	*ch = cpub->chan;
+
+	if( ch == NULL ) {
+		if( (ch = calloc(1,sizeof(Channel))) == NULL ) {
+			fprintf(stderr,"Unable to allocate a channel\n");
+			return NULL;
+		}
+		ch->in = ch->out = -1;
+		cpub->chan = ch;
+	}
+	return ch;
+}
+
+
+/*
+ *   Input from a file or a named pipe; waiting for it stops when *stop
+ *   is set
+ */
+int
+chan_input(Cpub *cpub, char *file, int *stop)
+{
+	Channel	*ch;
+	int	fd;
+
+	if( (fd = open(file,O_RDONLY)) < 0 ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	if( (ch = chan_get(cpub)) == NULL ) {
+		close(fd);
+		return -1;
+	}
+	if( ch->in >= 0 )
+		close(ch->in);
+	else
+		ch->link = cpub->ibuf;
+	ch->in = fd;
+	ch->stop = stop;
+	ch->eof = 0;
+	ch->head = ch->tail = 0;
+	ch->ibuf.flag = 0;
+	cpub->ibuf = &ch->ibuf;
+	chan_in(cpub);			/* the first byte */
+	return 0;
+}
+
+
+/*
+ *   Output to a file ("-": the standard output)
+ */
+int
+chan_output(Cpub *cpub, char *file)
+{
+	Channel	*ch;
+	int	fd;
+
+	if( !strcmp(file,"-") )
+		fd = 1;
+	else if( (fd = open(file,O_WRONLY|O_CREAT|O_TRUNC,0666)) < 0 ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	if( (ch = chan_get(cpub)) == NULL ) {
+		if( fd != 1 )
+			close(fd);
+		return -1;
+	}
+	if( ch->out >= 0 ) {
+		chan_drain(ch);
+		if( ch->out != 1 )
+			close(ch->out);
+	}
+	ch->out = fd;
+	cpub->obuf.flag = 0;
+	return 0;
+}
+
+
+void
+chan_close(Cpub *cpub)
+{
+	Channel	*ch = cpub->chan;
+
+	if( ch == NULL )
+		return;
+	if( ch->in >= 0 ) {
+		close(ch->in);
+		cpub->ibuf = ch->link;
+	}
+	if( ch->out >= 0 ) {
+		chan_drain(ch);
+		if( ch->out != 1 )
+			close(ch->out);
+	}
+	free(ch);
+	cpub->chan = NULL;
+}
+
+
+void
+chan_flush(Cpub *cpub)
+{
+	if( cpub->chan != NULL && cpub->chan->out >= 0 )
+		chan_drain(cpub->chan);
+}
+
+
+void
+chan_report(Cpub *cpub)
+{
+	Channel	*ch = cpub->chan;
+
+	if( ch == NULL ) {
+		fprintf(stderr,"   no channels\n");
+		return;
+	}
+	if( ch->in >= 0 )
+		fprintf(stderr,"   in:  %llu bytes read, %u buffered%s\n",
+			ch->nread,ch->head - ch->tail,
+			ch->eof ? ", end of input" : "");
+	if( ch->out >= 0 )
+		fprintf(stderr,"   out: %llu bytes written, %u buffered\n",
+			ch->nwritten,ch->nout);
+}
+
+
+/*
+ *   Before a run: the byte a stopped wait did not get
+ */
+void
+chan_resume(Cpub *cpub)
+{
+	if( cpub->chan != NULL )
+		chan_in(cpub);
+}
+
+
+/*=============================================================================
+ *   IN/OUT (called by in() and out())
+ *===========================================================================*/
+void
+chan_in(Cpub *cpub)
+{
+	Channel	*ch = cpub->chan;
+
+	if( ch->in < 0 || ch->ibuf.flag )
+		return;
+	if( ch->head - ch->tail < CHAN_LOW && !ch->eof )
+		chan_fill(ch,ch->head == ch->tail);
+	if( ch->head == ch->tail )
+		return;			/* end of the input: flag stays 0 */
+	ch->ibuf.buf = ch->ring[ch->tail++ & (CHAN_RING - 1)];
+	ch->ibuf.flag = 1;
+}
+
+
+void
+chan_out(Cpub *cpub)
+{
+	Channel	*ch = cpub->chan;
+
+	if( ch->out < 0 )
+		return;
+	ch->obuf[ch->nout++] = cpub->acc;
+	cpub->obuf.flag = 0;
+	if( ch->nout == CHAN_RING )
+		chan_drain(ch);
+}
+
+
+/*
+ *   Read into the free part of the ring; waits for a pipe only if the
+ *   ring is empty, and no longer than the stop flag allows
+ */
+static void
+chan_fill(Channel *ch, int wait)
+{
+	struct pollfd	pfd;
+	unsigned int	at, room;
+	ssize_t		n;
+
+	pfd.fd = ch->in;
+	pfd.events = POLLIN;
+	if( !wait ) {
+		if( poll(&pfd,1,0) <= 0 )
+			return;
+	} else {
+		if( ch->out >= 0 )
+			chan_drain(ch);	/* a filter waiting for its input */
+		while( poll(&pfd,1,CHAN_WAIT) <= 0 )
+			if( ch->stop != NULL
+			    && __atomic_load_n(ch->stop,__ATOMIC_RELAXED) )
+				return;
+	}
+	at = ch->head & (CHAN_RING - 1);
+	room = CHAN_RING - (ch->head - ch->tail);
+	if( room > CHAN_RING - at )
+		room = CHAN_RING - at;
+	if( (n = read(ch->in,ch->ring + at,room)) <= 0 ) {
+		ch->eof = 1;
+		return;
+	}
+	ch->head += n;
+	ch->nread += n;
+}
+
+
+static void
+chan_drain(Channel *ch)
+{
+	unsigned int	done = 0;
+	ssize_t		n;
+
+	while( done < ch->nout ) {
+		if( (n = write(ch->out,ch->obuf + done,ch->nout - done)) <= 0 ) {
+			fprintf(stderr,"Unable to write the output\n");
+			break;
+		}
+		done += n;
+	}
+	ch->nwritten += done;
+	ch->nout = 0;
+}
@@ -0,0 +1,49 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	chan.h
+ *	Descrioption:	input/output channels of a board (files and pipes)
+ */
+
+/*=============================================================================
+ *   Channels
+ *
+ *	The input side replaces the board's ibuf with a buffer refilled
+ *	from a ring whenever IN takes a byte, so the flag only stays 0 at
+ *	the end of the input.  The ring is filled by large reads from the
+ *	file or pipe.  The output side takes every OUT byte at once
+ *	(obuf.flag stays 0) and writes them in batches.  A board waiting
+ *	for a pipe looks at the stop flag every CHAN_WAIT ms and gives up
+ *	once it is set; the flag is then 0 until chan_resume() at the next
+ *	run.
+ *===========================================================================*/
+#define	CHAN_RING	(64*1024)	/* power of 2 */
+#define	CHAN_LOW	(CHAN_RING/4)	/* refill below this (if readable) */
+#define	CHAN_WAIT	100		/* ms between looks at the stop flag */
+
+typedef struct channel {
+	int		in, out;	/* file descriptors (-1: none) */
+	IOBuf		ibuf;		/* replaces cpub->ibuf */
+	IOBuf		*link;		/* the replaced one */
+	int		eof;
+	int		*stop;		/* atomic: give up waiting (or NULL) */
+	unsigned int	head, tail;	/* ring[tail..head) is ready */
+	unsigned int	nout;
+	unsigned long long	nread, nwritten;
+	Uword		ring[CHAN_RING];
+	Uword		obuf[CHAN_RING];
+} Channel;
+
+int	chan_input(Cpub *, char *, int *);
+int	chan_output(Cpub *, char *);
+void	chan_close(Cpub *);
+void	chan_flush(Cpub *);
+void	chan_report(Cpub *);
+void	chan_resume(Cpub *);
+void	chan_in(Cpub *);
+void	chan_out(Cpub *);
+
+/* 1: the board still takes input from a channel */
+#define	ChanLive(C)	((C)->chan != NULL && (C)->chan->in >= 0 \
+			 && !((C)->chan->eof && (C)->chan->head == (C)->chan->tail))
@@ -0,0 +1,230 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	coverage.c
+ *	Descrioption:	coverage bitmaps (merge, save/load and report)
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"coverage.h"
+#include	"isa.h"
+
+
+static int	insn_form(Uword);
+static void	form_name(int, char *);
+static int	count_bits(Uword *, int);
+
+static char	*flag_name[4] = { "zf", "nf", "vf", "cf" };
+
+
+/*=============================================================================
+ *   Reset/Merge
+ *===========================================================================*/
+void
+cov_reset(Coverage *cov)
+{
+	memset(cov,0,sizeof(Coverage));
+}
+
+
+void
+cov_merge(Coverage *dst, Coverage *src)
+{
+	Uword	*d = (Uword *)dst, *s = (Uword *)src;
+	int	i;
+
+	for( i = 0 ; i < sizeof(Coverage) ; i++ )
+		d[i] |= s[i];
+}
+
+
+/*=============================================================================
+ *   Save/Load a Coverage File (raw bitmaps)
+ *===========================================================================*/
+int
+cov_save(Coverage *cov, char *file)
+{
+	FILE	*fp;
+
+	if( (fp = fopen(file,"wb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	fwrite(cov,sizeof(Coverage),1,fp);
+	fclose(fp);
+	return 0;
+}
+
+
+int
+cov_load(Coverage *cov, char *file)
+{
+	FILE	*fp;
+	int	n;
+
+	if( (fp = fopen(file,"rb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	n = fread(cov,sizeof(Coverage),1,fp);
+	fclose(fp);
+	if( n != 1 ) {
+		fprintf(stderr,"%s: not a coverage file\n",file);
+		return -1;
+	}
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Instruction Forms
+ *
+ *	Instruction words which decode to the same operation, operand A
+ *	and addressing mode (or shift mode, or condition) are one form.
+ *===========================================================================*/
+static int
+insn_form(Uword ir)
+{
+	Cpub	cpub;
+	Uword	code;
+
+	cpub.ir = ir;
+	code = decrypt_instruction(&cpub);
+	switch( code ) {
+	   case Ssm:
+	   case Rsm:
+		return code << 8 | decrypt_operandA(&cpub) << 3
+				 | isa_decode[ir].sub;
+	   case Bbc:
+		return code << 8 | isa_decode[ir].sub;
+	   case LD: case ST: case SBC: case ADC: case SUB:
+	   case ADD: case EOR: case OR: case AND: case CMP:
+		return code << 8 | decrypt_operandA(&cpub) << 3
+				 | decrypt_operandB(&cpub);
+	}
+	return code << 8;
+}
+
+
+static void
+form_name(int form, char *buf)
+{
+	Uword	code = form >> 8;
+
+	switch( code ) {
+	   case Ssm:
+	   case Rsm:
+		sprintf(buf,"%s %s",mnemonic(form >> 8 | (form & 0x03)),
+			(form & 0x08) ? "IX" : "ACC");
+		break;
+	   case Bbc:
+		sprintf(buf,"B%s",isa_cond_name[form & 0x0f]);
+		break;
+	   case LD: case ST: case SBC: case ADC: case SUB:
+	   case ADD: case EOR: case OR: case AND: case CMP:
+		sprintf(buf,"%s %s,%s",mnemonic(code),
+			(form & 0x08) ? "IX" : "ACC",
+			isa_mode_syntax[form & 0x07]);
+		break;
+	   default:
+		sprintf(buf,"%s",mnemonic(code));
+		break;
+	}
+}
+
+
+static int
+count_bits(Uword *bits, int n)
+{
+	int	i, count = 0;
+
+	for( i = 0 ; i < n ; i++ )
+		count += CovTest(bits,i);
+	return count;
+}
+
+
+/*=============================================================================
+ *   Coverage Summary
+ *===========================================================================*/
+void
+cov_report(Coverage *cov, int verbose)
+{
+	int	forms[256], covered[256];
+	int	nforms = 0, ncovered = 0;
+	int	ir, i, f, old, new, count;
+	Uword	trans[4][4];
+	char	name[32];
+
+	/*
+	 *   Instruction forms
+	 */
+	for( ir = 0 ; ir < 256 ; ir++ ) {
+		f = insn_form(ir);
+		for( i = 0 ; i < nforms && forms[i] != f ; i++ )
+			;
+		if( i == nforms ) {
+			forms[nforms] = f;
+			covered[nforms++] = 0;
+		}
+		covered[i] |= CovTest(cov->insn,ir);
+	}
+	for( i = 0 ; i < nforms ; i++ )
+		ncovered += covered[i];
+	fprintf(stderr,"   instruction forms\t%3d/%3d\n",ncovered,nforms);
+	if( verbose ) {
+		for( i = 0 ; i < nforms ; i++ ) {
+			if( covered[i] ) continue;
+			form_name(forms[i],name);
+			fprintf(stderr,"\t\tnot executed: %s\n",name);
+		}
+	}
+
+	/*
+	 *   Branch outcomes
+	 */
+	fprintf(stderr,"   branch outcomes\t%3d/%3d\n",
+		count_bits(cov->branch,32),32);
+	if( verbose ) {
+		for( i = 0 ; i < 32 ; i++ ) {
+			if( CovTest(cov->branch,i) ) continue;
+			fprintf(stderr,"\t\tnever %s: B%s\n",
+				(i & 1) ? "taken" : "fall through",
+				isa_cond_name[i >> 1]);
+		}
+	}
+
+	/*
+	 *   Flag transitions (each flag: 0->0, 0->1, 1->0, 1->1)
+	 */
+	memset(trans,0,sizeof(trans));
+	for( i = 0 ; i < 256 ; i++ ) {
+		if( !CovTest(cov->flags,i) ) continue;
+		for( f = 0 ; f < 4 ; f++ ) {
+			old = (i >> (4 + f)) & 1;
+			new = (i >> f) & 1;
+			trans[f][old << 1 | new] = 1;
+		}
+	}
+	count = 0;
+	for( f = 0 ; f < 4 ; f++ )
+		for( i = 0 ; i < 4 ; i++ )
+			count += trans[f][i];
+	fprintf(stderr,"   flag transitions\t%3d/%3d\n",count,16);
+	if( verbose ) {
+		for( f = 3 ; f >= 0 ; f-- )
+			for( i = 0 ; i < 4 ; i++ )
+				if( !trans[f][i] )
+					fprintf(stderr,"\t\tnever %s %d->%d\n",
+						flag_name[f],i >> 1,i & 1);
+	}
+
+	/*
+	 *   Text addresses
+	 */
+	fprintf(stderr,"   text addresses\t%3d/%3d\n",
+		count_bits(cov->text,256),256);
+}
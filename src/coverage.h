@@ -0,0 +1,43 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	coverage.h
+ *	Descrioption:	coverage bitmaps of the instruction set
+ */
+
+/*=============================================================================
+ *   Coverage Bitmaps
+ *
+ *	Every event is a single bit, so marking it is a single OR and
+ *	the bitmaps of several runs merge by OR-ing them together.  The
+ *	instructions other than Bbc mark the upper half of branch[], which
+ *	is never reported, so that no test is needed.
+ *===========================================================================*/
+typedef struct coverage {
+	Uword	insn[256/8];	/* instruction words (opcode x A x B) */
+	Uword	text[256/8];	/* executed text addresses */
+	Uword	branch[64/8];	/* Bbc condition code << 1 | taken */
+	Uword	flags[256/8];	/* old flags << 4 | new flags */
+} Coverage;
+
+#define	CovMark(B,I)	((B)[(I) >> 3] |= 1 << ((I) & 7))
+#define	CovTest(B,I)	(((B)[(I) >> 3] >> ((I) & 7)) & 1)
+
+/*
+ *   The bits of an executed instruction: IA is its address and F the
+ *   flags before it (isa.h is needed where it is used)
+ */
+#define	CovStep(B,C,IA,F)	do { \
+	const Decode	*d_ = &isa_decode[(C)->ir]; \
+	CovMark((B)->text,IA); \
+	CovMark((B)->insn,(C)->ir); \
+	CovMark((B)->flags,(F) << 4 | PackedFlags(C)); \
+	CovMark((B)->branch,(d_->bcc ^ 1) << 5 | d_->sub << 1 | (C)->bt); \
+} while(0)
+
+void	cov_reset(Coverage *);
+void	cov_merge(Coverage *, Coverage *);
+int	cov_save(Coverage *, char *);
+int	cov_load(Coverage *, char *);
+void	cov_report(Coverage *, int);
@@ -7,51 +7,15 @@
  */
 
 #include    <stdio.h>
+#include	<string.h>
 #include	"cpuboard.h"
-
-/* 命令コード */
-enum instruction_code {
-    NOP = 0x00,
-    HLT = 0x0f,
-    OUT = 0x10,
-    IN  = 0x1f,
-    RCF = 0x20,
-    SCF = 0x2f,
-    LD  = 0x60,
-    ST  = 0x70,
-    ADD = 0xb0,
-    ADC = 0x90,
-    SUB = 0xa0,
-    SBC = 0x80,
-    CMP = 0xf0,
-    AND = 0xe0,
-    OR  = 0xd0,
-    EOR = 0xc0,
-    Ssm = 0x40,
-    Rsm = 0x44,
-    Bbc = 0x30,
-    JAL = 0x0a,
-    JR  = 0x0b
-};
-
-/* アドレッシングモード */
-enum operand_b {
-    ACC = 0x00,
-    IX  = 0x01,
-    IMMEDIATE_ADDR = 0x02,
-    ABS_ADDR_TEXT = 0x04,
-    ABS_ADDR_DATA = 0x05,
-    IX_MOD_ADDR_TEXT = 0x06,
-    IX_MOD_ADDR_DATA = 0x07
-};
-
-/* Shift Mode */
-enum shift_mode {
-    RA = 0x00,
-    LA = 0x01,
-    RL = 0x02,
-    LL = 0x03
-};
+#include	"coverage.h"
+#include	"isa.h"		/* 命令コード, アドレッシングモード, Shift Mode */
+#include	"alu.h"		/* ALU表, フラグ判定 */
+#include	"dev.h"		/* メモリマップドデバイス */
+#include	"chan.h"	/* 入出力チャネル */
+#include	"fuse.h"	/* 融合命令 */
+#include	"text.h"	/* 共有テキスト */
 
 /* プロトタイプ宣言 */
 Uword decrypt_instruction(Cpub *);
@@ -59,10 +23,7 @@ Uword decrypt_operandA(Cpub *);
 Uword fetch_operandA(Cpub *);
 Uword decrypt_operandB(Cpub *);
 Uword fetch_operandB(Cpub *);
-Bit carry_flag(Uword, Uword);
-Bit overflow_flag(Uword, Uword);
-Bit negative_flag(Uword);
-Bit zero_flag(Uword);
+AluFlags alu(Cpub *, int, Uword, Uword);
 void out(Cpub *);
 void in(Cpub *);
 void reset_cf(Cpub *);
@@ -84,17 +45,40 @@ void jal(Cpub *);
 void jr(Cpub *);
 void err_mesg(char *);
 
+/*
+ * 性能カウンタ: 解読表の 0/1 の値を掛けて足すだけ (条件分岐なし).
+ * en は pc がサンプル範囲内なら 1, bt は Bbc 以外では使われない.
+ */
+#define PmuCount(C, IA) do { \
+    const Decode *d_ = &isa_decode[(C)->ir]; \
+    Pmu *p_ = &(C)->pmu; \
+    Count en_ = p_->off[IA] ^ 1; \
+    p_->insns += en_; \
+    p_->cls[d_->cls] += en_; \
+    p_->branch[(C)->bt] += en_ & d_->bcc; \
+    p_->reads[d_->region] += en_ & d_->rd; \
+    p_->writes[d_->region] += en_ & d_->wr; \
+    p_->cycles += en_ * d_->cycles; \
+    p_->stalls += (en_ & d_->poll & (C)->bt) * d_->cycles; \
+} while (0)
+
+/*
+ * カバレッジ: 1命令ぶんのビットを立てる (cov が NULL なら何もしない).
+ * IA は命令のアドレス, F は実行前のフラグ.
+ */
+#define CovCount(C, IA, F) do { \
+    if ((C)->cov != NULL) \
+        CovStep((C)->cov, C, IA, F); \
+} while (0)
+
 /*=============================================================================
  *   Simulation of a Single Instruction
  *===========================================================================*/
-int
-step(Cpub *cpub)
+/* 命令実行 (フェッチ済みの ir) */
+static int
+execute(Cpub *cpub)
 {
     int return_status = RUN_STEP;
-    /* 命令フェッチとPC更新 */
-    cpub->mar = cpub->pc;
-    cpub->pc++;
-    cpub->ir = cpub->mem[cpub->mar];
 
     /* 命令解読 */
     Uword decrypted_code = decrypt_instruction(cpub);
@@ -171,90 +155,101 @@ step(Cpub *cpub)
     return return_status;
 }
 
-/* 命令解読 */
-Uword decrypt_instruction(Cpub *cpub) {
-    Uword UPPER_4BIT = cpub->ir & 0xf0;     /* 上位4bit */
-
-    /* JAL, JR */
-    if (cpub->ir == JAL) return JAL;
-    if (cpub->ir == JR ) return JR;
-
-    /* NOP, HLT */
-    if (UPPER_4BIT == 0x00) {
-        Uword bit4 = cpub->ir & 0x08;       /* 下位4bit目 */
-        if (bit4 == 0) {
-            return NOP;
-        } else {
-            return HLT;
-        }
-    }
+/* 命令フェッチ, PC更新, 解読と実行だけ (計測なし) */
+int
+step(Cpub *cpub)
+{
+    cpub->mar = cpub->pc;
+    cpub->pc++;
+    cpub->ir = TextOf(cpub)[cpub->mar];
+    return execute(cpub);
+}
 
-    /* RCF, SCF */
-    if (UPPER_4BIT == 0x10) {
-        Uword bit4 = cpub->ir & 0x08;
-        if (bit4 == 0) {
-            return RCF;
-        } else {
-            return SCF;
-        }
+/* step() にデバイス, カバレッジ, 性能カウンタ, サイクル数を加えたもの */
+int
+step_full(Cpub *cpub)
+{
+    /* デバイスのイベントと割り込み (最も早いイベントの時刻になったときだけ) */
+    if (cpub->dev != NULL && cpub->cycle >= cpub->dev->next) {
+        int s = dev_service(cpub);
+        if (s != RUN_STEP)
+            return s == DEV_ASLEEP ? RUN_STEP : RUN_HALT;   /* 眠ったまま */
     }
+    return step_counted(cpub);
+}
 
-    /* Ssm, Rsm */
-    if (UPPER_4BIT == 0x40) {
-        Uword bit3 = cpub->ir & 0x04;       /* 下位3bit目 */
-        if (bit3 == 0) {
-            return Ssm;
-        } else {
-            return Rsm;
-        }
+/* step_full() からデバイスを除いたもの (トレーサは割り込みの後の状態を記録する) */
+int
+step_counted(Cpub *cpub)
+{
+    int return_status;
+    Uword flags, ia;
+    flags = PackedFlags(cpub);
+    ia = cpub->pc;
+    cpub->mar = cpub->pc;
+    cpub->pc++;
+    cpub->ir = TextOf(cpub)[cpub->mar];
+    return_status = execute(cpub);
+    CovCount(cpub, ia, flags);
+    PmuCount(cpub, ia);
+    cpub->cycle += isa_decode[cpub->ir].cycles;
+    return return_status;
+}
+
+/*=============================================================================
+ *   Simulation of a Superinstruction (fuse.h)
+ *===========================================================================*/
+/* 融合命令の中の1命令: フェッチ, 実行, カバレッジと性能カウンタは step_full() と同じ */
+#define FusedInsn(C, OP) do { \
+    Uword f_ = PackedFlags(C), ia_ = (C)->pc; \
+    (C)->mar = (C)->pc; \
+    (C)->pc++; \
+    (C)->ir = TextOf(C)[(C)->mar]; \
+    OP; \
+    CovCount(C, ia_, f_); \
+    PmuCount(C, ia_); \
+    (C)->cycle += isa_decode[(C)->ir].cycles; \
+} while (0)
+
+int
+step_fused(Cpub *cpub, int kind)
+{
+    int return_status = RUN_STEP;
+
+    switch (kind) {
+        case FUSE_CLEAR:        /* EOR r,r: オペランドを読まずに 0 */
+            FusedInsn(cpub, {
+                if (isa_decode[cpub->ir].a) cpub->ix = 0; else cpub->acc = 0;
+                cpub->vf = 0;
+                cpub->nf = 0;
+                cpub->zf = 1;
+            });
+            break;
+        case FUSE_CMP_B:
+            FusedInsn(cpub, compare(cpub));
+            FusedInsn(cpub, branch(cpub));
+            break;
+        case FUSE_SUB_B:
+            FusedInsn(cpub, sub(cpub));
+            FusedInsn(cpub, branch(cpub));
+            break;
+        case FUSE_LD_ADD_ST:    /* STのモードはメモリなので停止しない */
+            FusedInsn(cpub, load(cpub));
+            FusedInsn(cpub, add(cpub));
+            FusedInsn(cpub, return_status = store(cpub));
+            break;
     }
+    return return_status;
+}
 
-    /* それ以外 */
-    return UPPER_4BIT;
-
-    //switch (UPPER_4BIT) {
-    //    case LD:
-    //        return LD;
-    //    case ST:
-    //        return ST;
-    //    case ADD:
-    //        return ADD;
-    //    case ADC:
-    //        return ADC;
-    //    case SUB:
-    //        return SUB;
-    //    case 0x80:
-    //        return SBC;
-    //    case 0xf0:
-    //        return CMP;
-    //    case 0xe0:
-    //        return AND;
-    //    case 0xd0:
-    //        return OR;
-    //    case 0xc0:
-    //        return EOR;
-    //    case 0x40:
-    //        bit3 = cpub->ir & 0x40;
-    //        if (bit3 == 0) {
-    //            return Ssm;
-    //        } else {
-    //            return Rsm;
-    //        }
-    //    case 0x30:
-    //        return Bbc;
-    //    default:
-    //        err_mesg("decrypt_instruction()");
-    //        break;
-    //}
+/* 命令解読 (isa.defから生成した解読表を引く) */
+Uword decrypt_instruction(Cpub *cpub) {
+    return isa_decode[cpub->ir].code;
 }
 
 /* オペランド解読(A) */
 Uword decrypt_operandA(Cpub *cpub) {
-    if (cpub->ir & 0x08) {
-        return 1;   /* IX */
-    } else {
-        return 0;   /* ACC */
-    }
+    return isa_decode[cpub->ir].a;  /* 0: ACC, 1: IX */
 }
 
 /* オペランドフェッチ(A) */
@@ -268,100 +263,28 @@ Uword fetch_operandA(Cpub *cpub) {
 
 /* オペランド解読(B) */
 Uword decrypt_operandB(Cpub *cpub) {
-    Uword decrypted_opB = cpub->ir & 0x07;
-    if (decrypted_opB == 0x03) decrypted_opB = 0x02;    // 即値アドレスのときは下位1bitを0に設定
-    return decrypted_opB;
+    return isa_decode[cpub->ir].b;  /* 即値アドレスは 0x02 にまとめてある */
 }
 
-/* オペランドフェッチ(B) */
+/* オペランドフェッチ(B) (アドレッシングモードごとに生成した関数) */
 Uword fetch_operandB(Cpub *cpub) {
-    Uword decrypted_opB = decrypt_operandB(cpub);
-    Uword second_word;
-    switch (decrypted_opB) {
-        case ACC:  /* ACC */
-            return cpub->acc;
-        case IX:  /* IX */
-            return cpub->ix;
-        case IMMEDIATE_ADDR:  /* 即値アドレス */
-            cpub->mar = cpub->pc;
-            cpub->pc++;
-            second_word = cpub->mem[cpub->mar];
-            return second_word;
-        case ABS_ADDR_TEXT:  /* 絶対アドレス(プログラム領域) */
-            cpub->mar = cpub->pc;
-            cpub->pc++;
-            second_word = cpub->mem[cpub->mar];
-            return cpub->mem[second_word];
-        case ABS_ADDR_DATA:  /* 絶対アドレス(データ領域) */
-            cpub->mar = cpub->pc;
-            cpub->pc++;
-            second_word = cpub->mem[cpub->mar];
-            return cpub->mem[0x100 + second_word];
-        case IX_MOD_ADDR_TEXT:  /* IX修飾アドレス(プログラム領域) */
-            cpub->mar = cpub->pc;
-            cpub->pc++;
-            second_word = cpub->mem[cpub->mar];
-            return cpub->mem[second_word + cpub->ix];
-        case IX_MOD_ADDR_DATA:  /* IX修飾アドレス(データ領域) */
-            cpub->mar = cpub->pc;
-            cpub->pc++;
-            second_word = cpub->mem[cpub->mar];
-            return cpub->mem[0x100 + second_word + cpub->ix];
-    }
-}
-
-/* キャリーフラグ判定 */
-Bit carry_flag(Uword opA, Uword opB) {
-    Uword msb_A = opA >> 7;
-    Uword msb_B = opB >> 7;
-    Uword CY = ((opA & 0x7f) + (opB & 0x7f)) >> 7;
-    if ((msb_A & msb_B) | (msb_A & CY) | (msb_B & CY)) {
-        return 1;
-    } else {
-        return 0;
-    }
-}
-
-/* オーバーフローフラグ判定 */
-Bit overflow_flag(Uword opA, Uword opB) {
-    Uword msb_A = opA >> 7;
-    Uword msb_B = opB >> 7;
-    Uword CY = ((opA & 0x7f) + (opB & 0x7f)) >> 7;
-    if ((msb_A & msb_B & !CY) | (!msb_A & !msb_B & CY)) {
-        return 1;
-    } else {
-        return 0;
-    }
-}
-
-/* ネガティブフラグ判定 */
-Bit negative_flag(Uword result) {
-    if (result & 0x80) {
-        return 1;
-    } else {
-        return 0;
-    }
-}
-
-/* ゼロフラグ判定 */
-Bit zero_flag(Uword result) {
-    if (result & 0xff) {
-        return 0;
-    } else {
-        return 1;
-    }
+    return isa_fetch[isa_decode[cpub->ir].b](cpub);
 }
 
 /* OUT命令 */
 void out(Cpub *cpub) {
     cpub->obuf.buf = cpub->acc;
     cpub->obuf.flag = 1;
+    if (cpub->chan != NULL)
+        chan_out(cpub);     /* チャネルに出力 (flagは0に戻る) */
 }
 
 /* IN命令 */
 void in(Cpub *cpub) {
     cpub->acc = cpub->ibuf->buf;
-    cpub->ibuf->flag = 1;
+    cpub->ibuf->flag = 0;
+    if (cpub->chan != NULL)
+        chan_in(cpub);      /* チャネルから次の1バイト */
 }
 
 /* RCF命令 */
@@ -390,7 +313,7 @@ int store(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     cpub->mar = cpub->pc;
     cpub->pc++;
-    Uword second_word = cpub->mem[cpub->mar];
+    Uword second_word = TextOf(cpub)[cpub->mar];
     int return_status = RUN_STEP;
 
     switch (decrypted_opB) {
@@ -407,39 +330,54 @@ int store(Cpub *cpub) {
             return_status = RUN_HALT;
             break;
         case ABS_ADDR_TEXT:  /* 絶対アドレス(プログラム領域) */
-            cpub->mem[second_word] = fetched_opA;
+            cpub->wa = second_word;
             break;
         case ABS_ADDR_DATA:  /* 絶対アドレス(データ領域) */
-            cpub->mem[0x100 + second_word] = fetched_opA;
+            cpub->wa = 0x100 + second_word;
             break;
-        case IX_MOD_ADDR_TEXT:  /* IX修飾アドレス(プログラム領域) */
-            cpub->mem[second_word + cpub->ix] = fetched_opA;
+        case IX_MOD_ADDR_TEXT:  /* IX修飾アドレス(プログラム領域, 0xff を越えるとデータ領域) */
+            cpub->wa = second_word + cpub->ix;
             break;
-        case IX_MOD_ADDR_DATA:  /* IX修飾アドレス(データ領域) */
-            cpub->mem[0x100 + second_word + cpub->ix] = fetched_opA;
+        case IX_MOD_ADDR_DATA:  /* IX修飾アドレス(データ領域, 8ビットで一周) */
+            cpub->wa = 0x100 + (Uword)(second_word + cpub->ix);
             break;
         default:
             return_status = RUN_HALT;
             break;
     }
+    if (return_status == RUN_STEP) {
+        if (cpub->text != NULL && cpub->wa < IMEMORY_SIZE)
+            text_private(cpub);                /* 共有テキストなら自分の写しへ */
+        StateHashWrite(cpub, cpub->wa, fetched_opA);
+        MemAt(cpub, cpub->wa) = fetched_opA;   /* バンク切替後の実体 */
+        cpub->wf = 1;
+        if (cpub->dev != NULL)
+            dev_write(cpub, cpub->wa);
+    }
     return return_status;
 }
 
+/* 算術命令: フラグは ALU表を1回引くだけ, 結果はふつうの加減算 (参照実装は alu.c) */
+AluFlags alu(Cpub *cpub, int slot, Uword opA, Uword opB) {
+    AluFlags f = alu_tab[slot][opA][opB];
+
+    cpub->vf = AluVF(f);
+    cpub->nf = AluNF(f);
+    cpub->zf = AluZF(f);
+    return f;
+}
+
 /* ADD命令 */
 void add(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     Uword fetched_opB = fetch_operandB(cpub);
-    Uword sum = fetched_opA + fetched_opB;
-
-    cpub->cf = carry_flag(fetched_opA, fetched_opB);
-    cpub->vf = (cpub->cf | overflow_flag(fetched_opA, fetched_opB));
-    cpub->nf = negative_flag(sum);
-    cpub->zf = zero_flag(sum);
+    Uword result = AluAdd(fetched_opA, fetched_opB, 0);
 
+    cpub->cf = AluCF(alu(cpub, ALU_ADD, fetched_opA, fetched_opB));
     if (decrypt_operandA(cpub)) {
-        cpub->ix = sum;
+        cpub->ix = result;
     } else {
-        cpub->acc = sum;
+        cpub->acc = result;
     }
 }
 
@@ -447,17 +385,13 @@ void add(Cpub *cpub) {
 void adc(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     Uword fetched_opB = fetch_operandB(cpub);
-    Uword sum = fetched_opA + fetched_opB + cpub->cf;
-
-    cpub->cf = carry_flag(fetched_opA, fetched_opB);
-    cpub->vf = overflow_flag(fetched_opA, fetched_opB);
-    cpub->nf = negative_flag(sum);
-    cpub->zf = zero_flag(sum);
+    Uword result = AluAdd(fetched_opA, fetched_opB, cpub->cf);
 
+    cpub->cf = AluCF(alu(cpub, ALU_ADC + cpub->cf, fetched_opA, fetched_opB));
     if (decrypt_operandA(cpub)) {
-        cpub->ix = sum;
+        cpub->ix = result;
     } else {
-        cpub->acc = sum;
+        cpub->acc = result;
     }
 }
 
@@ -465,17 +399,13 @@ void adc(Cpub *cpub) {
 void sub(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     Uword fetched_opB = fetch_operandB(cpub);
-    Uword sub = fetched_opA + (~fetched_opB + 0x01);
-
-    cpub->cf = carry_flag(fetched_opA, ((~fetched_opB) + 0x01));
-    cpub->vf = overflow_flag(fetched_opA, fetched_opB);
-    cpub->nf = negative_flag(sub);
-    cpub->zf = zero_flag(sub);
+    Uword result = AluSub(fetched_opA, fetched_opB, 0);
 
+    cpub->cf = AluCF(alu(cpub, ALU_SUB, fetched_opA, fetched_opB));
     if (decrypt_operandA(cpub)) {
-        cpub->ix = sub;
+        cpub->ix = result;
     } else {
-        cpub->acc = sub;
+        cpub->acc = result;
     }
 }
 
@@ -483,29 +413,22 @@ void sub(Cpub *cpub) {
 void sbc(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     Uword fetched_opB = fetch_operandB(cpub);
-    Uword sbc = fetched_opA + (~fetched_opB + 0x01) + (~cpub->cf + 0x01);
-
-    cpub->cf = carry_flag(fetched_opA, ((~fetched_opB + 0x01) + (~cpub->cf + 0x01)));
-    cpub->vf = overflow_flag(fetched_opA, fetched_opB);
-    cpub->nf = negative_flag(sbc);
-    cpub->zf = zero_flag(sbc);
+    Uword result = AluSub(fetched_opA, fetched_opB, cpub->cf);
 
+    cpub->cf = AluCF(alu(cpub, ALU_SBC + cpub->cf, fetched_opA, fetched_opB));
     if (decrypt_operandA(cpub)) {
-        cpub->ix = sbc;
+        cpub->ix = result;
     } else {
-        cpub->acc = sbc;
+        cpub->acc = result;
     }
 }
 
-/* CMP命令 */
+/* CMP命令 (cf は変えない) */
 void compare(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
     Uword fetched_opB = fetch_operandB(cpub);
-    Uword result = fetched_opA + (~fetched_opB + 1);
 
-    cpub->vf = overflow_flag(fetched_opA, (~fetched_opB + 1));
-    cpub->nf = negative_flag(result);
-    cpub->zf = zero_flag(result);
+    alu(cpub, ALU_CMP, fetched_opA, fetched_opB);
 }
 
 /* AND命令 */
@@ -562,7 +485,7 @@ void eor(Cpub *cpub) {
 /* Shift命令 */
 void shift(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
-    Uword sm = cpub->ir & 0x03;
+    Uword sm = isa_decode[cpub->ir].sub;
     Uword msb = fetched_opA & 0x80;
     Uword lsb = fetched_opA & 0x01;
     Uword shifted;
@@ -576,8 +499,8 @@ void shift(Cpub *cpub) {
             break;
         case LA:  /* SLA */
             shifted = fetched_opA << 1;
-            cpub->cf = msb;
-            cpub->vf = (fetched_opA ^ shifted) & 0x80; //符号bitが変わったら
+            cpub->cf = msb >> 7;
+            cpub->vf = ((fetched_opA ^ shifted) & 0x80) >> 7; //符号bitが変わったら
             break;
         case RL:  /* SRL */
             shifted = fetched_opA >> 1;
@@ -586,7 +509,7 @@ void shift(Cpub *cpub) {
             break;
         case LL:  /* SLL */
             shifted = fetched_opA << 1;
-            cpub->cf = msb;
+            cpub->cf = msb >> 7;
             cpub->vf = 0;
             break;
     }
@@ -604,7 +527,7 @@ void shift(Cpub *cpub) {
 /* Rotate命令 */
 void rotate(Cpub *cpub) {
     Uword fetched_opA = fetch_operandA(cpub);
-    Uword sm = cpub->ir & 0x03;
+    Uword sm = isa_decode[cpub->ir].sub;
     Uword msb = fetched_opA & 0x80;
     Uword lsb = fetched_opA & 0x01;
     Uword rotated;
@@ -619,8 +542,8 @@ void rotate(Cpub *cpub) {
         case LA:  /* RLA */
             rotated = fetched_opA << 1;
             rotated = rotated | cpub->cf; 
-            cpub->cf = msb;
-            cpub->vf = (fetched_opA ^ rotated) & 0x80; //符号bitが変わったら
+            cpub->cf = msb >> 7;
+            cpub->vf = ((fetched_opA ^ rotated) & 0x80) >> 7; //符号bitが変わったら
             break;
         case RL:  /* RRL */
             rotated = fetched_opA >> 1;
@@ -631,7 +554,7 @@ void rotate(Cpub *cpub) {
         case LL:  /* RLL */
             rotated = fetched_opA << 1;
             rotated = rotated | (msb >> 7);
-            cpub->cf = msb;
+            cpub->cf = msb >> 7;
             cpub->vf = 0;
             break;
     }
@@ -648,61 +571,64 @@ void rotate(Cpub *cpub) {
 
 /* Branch命令 */
 void branch(Cpub *cpub) {
-    Uword bc = cpub->ir & 0x0f;
+    Uword bc = isa_decode[cpub->ir].sub;
     Uword B2;
+    Bit taken = 0;
     cpub->mar = cpub->pc;
     cpub->pc++;
-    B2 = cpub->mem[cpub->mar];
+    B2 = TextOf(cpub)[cpub->mar];
     switch (bc) {
         case 0x00:  /* A */
-            cpub->pc = B2;
+            taken = 1;
             break;
         case 0x08:  /* VF */
-            if (cpub->vf == 1) cpub->pc = B2;
+            taken = (cpub->vf == 1);
             break;
         case 0x01:  /* NZ */
-            if (cpub->zf == 0) cpub->pc = B2;
+            taken = (cpub->zf == 0);
             break;
         case 0x09:  /* Z */
-            if (cpub->zf == 1) cpub->pc = B2;
+            taken = (cpub->zf == 1);
             break;
         case 0x02:  /* ZP */
-            if (cpub->nf == 0) cpub->pc = B2;
+            taken = (cpub->nf == 0);
             break;
         case 0x0a:  /* N */
-            if (cpub->nf == 1) cpub->pc = B2;
+            taken = (cpub->nf == 1);
             break;
         case 0x03:  /* P */
-            if ((cpub->nf | cpub->zf) == 0) cpub->pc = B2;
+            taken = ((cpub->nf | cpub->zf) == 0);
             break;
         case 0x0b:  /* ZN */
-            if ((cpub->nf | cpub->zf) == 1) cpub->pc = B2;
+            taken = ((cpub->nf | cpub->zf) == 1);
             break;
         case 0x04:  /* NI */
-            if (cpub->ibuf->flag == 0) cpub->pc = B2;
+            taken = (cpub->ibuf->flag == 0);
             break;
         case 0x0c:  /* NO */
-            if (cpub->obuf.flag == 1) cpub->pc = B2;
+            taken = (cpub->obuf.flag == 1);
             break;
         case 0x05:  /* NC */
-            if (cpub->cf == 0) cpub->pc = B2;
+            taken = (cpub->cf == 0);
             break;
         case 0x0d:  /* C */
-            if (cpub->cf == 1) cpub->pc = B2;
+            taken = (cpub->cf == 1);
             break;
         case 0x06:  /* GE */
-            if ((cpub->vf ^ cpub->nf) == 0) cpub->pc = B2;
+            taken = ((cpub->vf ^ cpub->nf) == 0);
             break;
         case 0x0e:  /* LT */
-            if ((cpub->vf ^ cpub->nf) == 1) cpub->pc = B2;
+            taken = ((cpub->vf ^ cpub->nf) == 1);
             break;
         case 0x07:  /* GT */
-            if (((cpub->vf ^ cpub->nf) | (cpub->zf)) == 0) cpub->pc = B2;
+            taken = (((cpub->vf ^ cpub->nf) | (cpub->zf)) == 0);
             break;
         case 0x0f:  /* LE */
-            if (((cpub->vf ^ cpub->nf) | (cpub->zf)) == 1) cpub->pc = B2;
+            taken = (((cpub->vf ^ cpub->nf) | (cpub->zf)) == 1);
             break;
     }
+    cpub->bt = taken;
+    if (taken) cpub->pc = B2;
 }
 
 /* JAL命令 */
@@ -710,7 +636,7 @@ void jal(Cpub *cpub) {
     Uword B2;
     cpub->mar = cpub->pc;
     cpub->pc++;
-    B2 = cpub->mem[cpub->mar];
+    B2 = TextOf(cpub)[cpub->mar];
     cpub->acc = cpub->pc;
     cpub->pc = B2;
 }
@@ -720,7 +646,103 @@ void jr(Cpub *cpub) {
     cpub->pc = cpub->acc;
 }
 
+/* 命令ニーモニック */
+char *mnemonic(Uword ir) {
+    return isa_decode[ir].name;
+}
+
+/*=============================================================================
+ *   Memory Map
+ *
+ *   ページ表は各ページの実体を指す. 新しいボードは mem_map() で自分の
+ *   メモリ (2領域の配置) を指してから使う.
+ *===========================================================================*/
+void mem_map(Cpub *cpub) {
+    int i;
+
+    for (i = 0; i < PAGES; i++) {
+        cpub->page[i] = cpub->mem + (i << PAGE_SHIFT);
+    }
+}
+
+/*
+ * m, w, gdb のアドレスの語: 000-1ff はボードのメモリ (変換前), 200- はバンク.
+ * テキストに書くときは先に text_private() を呼ぶ.
+ */
+Uword *mem_word(Cpub *cpub, unsigned long addr) {
+    if (addr < IMEMORY_SIZE) {
+        return &TextOf(cpub)[addr];
+    }
+    if (addr < MEMORY_SIZE) {
+        return &cpub->mem[addr];
+    }
+    if (addr < XMEMORY_SIZE && cpub->xmem != NULL) {
+        return &cpub->xmem[addr - MEMORY_SIZE];
+    }
+    return NULL;
+}
+
+/* 表示用の写し: テキストとメモリは写しのもの, バンクは元のボードのものを指す */
+void cpub_copy(Cpub *to, Cpub *from) {
+    int i;
+
+    *to = *from;
+    memcpy(to->mem, TextOf(from), IMEMORY_SIZE);
+    to->text = NULL;
+    for (i = 0; i < PAGES; i++) {
+        if (i < PAGES / 2 || from->page[i] == from->mem + (i << PAGE_SHIFT)) {
+            to->page[i] = to->mem + (i << PAGE_SHIFT);
+        }
+    }
+}
+
+/*=============================================================================
+ *   State Hash
+ *
+ *   メモリ部分は Σ (mem[i]+1) * mem_key[i] で, 書き込み時に差分だけ更新する.
+ *   レジスタ部分は小さいので state_hash() で毎回まぜる.
+ *===========================================================================*/
+unsigned long long mem_key[STATE_KEYS];
+
+static unsigned long long mix64(unsigned long long x) {
+    x ^= x >> 30;  x *= 0xbf58476d1ce4e5b9ULL;   /* splitmix64 */
+    x ^= x >> 27;  x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+void state_hash_init(Cpub *cpub) {
+    int i;
+
+    if (mem_key[0] == 0) {
+        for (i = 0; i < STATE_KEYS; i++) {
+            mem_key[i] = mix64(0x9e3779b97f4a7c15ULL * (i + 1)) | 1;
+        }
+    }
+    cpub->hash = 0;
+    for (i = 0; i < MEMORY_SIZE; i++) {
+        cpub->hash += (MemAt(cpub, i) + 1) * mem_key[i];
+    }
+}
+
+unsigned long long state_hash(Cpub *cpub) {
+    unsigned long long regs;
+
+    regs = (unsigned long long)cpub->pc
+         | (unsigned long long)cpub->acc << 8
+         | (unsigned long long)cpub->ix << 16
+         | (unsigned long long)PackedFlags(cpub) << 24
+         | (unsigned long long)cpub->ibuf->flag << 28
+         | (unsigned long long)cpub->ibuf->buf << 32
+         | (unsigned long long)cpub->obuf.flag << 40
+         | (unsigned long long)cpub->obuf.buf << 48;
+    return cpub->hash + mix64(regs);
+}
+
 /* エラーメッセージ表示用関数 */
+int err_mesg_off = 0;   /* 1: 表示しない (fuzzer等) */
+
 void err_mesg(char *msg) {
+    if (err_mesg_off) return;
     fprintf(stderr, "error: %s\n", msg);
 }
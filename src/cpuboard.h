@@ -21,11 +21,56 @@ typedef unsigned char	Bit;
 #define	MEMORY_SIZE	256*2
 #define	IMEMORY_SIZE	256
 
+/*
+ *   Banked extended memory: both regions are translated through a page
+ *   table of pointers to the words of each page.  mem_map() points them
+ *   at the board's own memory (the two-region layout) and a bank device
+ *   (dev.c) allocates the banks (Cpub::xmem) and switches them into the
+ *   windows at data 0x80 and 0xc0.  MemAt() masks the address and the
+ *   page number, so no operand leaves a page and the hot path has no
+ *   branch.  m, w and gdb see the banks after the board's memory.
+ */
+#define	PAGE_SHIFT	5
+#define	PAGE_WORDS	(1 << PAGE_SHIFT)
+#define	PAGES		((MEMORY_SIZE) >> PAGE_SHIFT)	/* of the two regions */
+#define	XBANK_SIZE	0x40				/* 2 pages */
+#define	XBANKS		64
+#define	XMEMORY_SIZE	((MEMORY_SIZE) + (XBANKS - 1) * XBANK_SIZE)
+
+#define	MemAt(C,A)	((C)->page[((A) >> PAGE_SHIFT) & (PAGES - 1)] \
+			  [(A) & (PAGE_WORDS - 1)])
+
+/*
+ *   The text pages are contiguous, in mem[] or in a text shared with the
+ *   other boards running the same program (text.h): fetch reads them
+ *   through the first page
+ */
+#define	TextOf(C)	((C)->page[0])
+
 typedef struct iobuf {
 	Bit	flag;
 	Uword	buf;
 } IOBuf;
 
+/*
+ *   Performance counters (updated by step_full() without conditionals;
+ *   instructions at a pc with off[pc] = 1 are not counted)
+ */
+#define	PMU_CLASS_MAX	8	/* enum pmu_class (isa.def) */
+
+typedef unsigned long long	Count;
+
+typedef struct pmu {
+	Count	insns;			/* instructions retired */
+	Count	cls[PMU_CLASS_MAX];	/* per instruction class */
+	Count	branch[2];		/* Bbc: not taken, taken */
+	Count	reads[2], writes[2];	/* memory operands: text, data */
+	Count	cycles;			/* modeled cycles */
+	Count	stalls;			/* cycles of taken BNI/BNO */
+	Uword	lo, hi;			/* sampled pc range */
+	Uword	off[IMEMORY_SIZE];	/* 1: pc outside the range */
+} Pmu;
+
 typedef struct cpuboard {
 	Uword	pc;
 	Uword	acc;
@@ -38,15 +83,88 @@ typedef struct cpuboard {
 	 */
     Uword   mar;
     Uword   ir;
+    Addr    wa;     /* address of the last memory write */
+    Bit     wf;     /* memory write flag (set by ST) */
+    Bit     bt;     /* branch taken (set by Bbc) */
 
-	Uword	mem[MEMORY_SIZE];	/* 0XX:Program, 1XX:Data */
+	struct trace	*trace;		/* execution trace (NULL: off) */
+	struct coverage	*cov;		/* coverage bitmaps (NULL: off) */
+	Count		native;		/* insns run natively: not covered */
+	unsigned long long	hash;	/* memory part of the state hash */
+	struct aot	*aot;		/* translated program (NULL: none) */
+	Pmu		pmu;		/* performance counters */
+	struct devices	*dev;		/* mapped devices (NULL: none) */
+	struct channel	*chan;		/* input/output channels (NULL: none) */
+	struct fusion	*fuse;		/* superinstructions (NULL: off) */
+	struct feed	*feed;		/* change feed (NULL: none) */
+	Count		cycle;		/* modeled cycles (device time) */
+	Uword		*page[PAGES];	/* words of each page (mem_map()) */
+	Uword		*xmem;		/* banks 1.. (NULL: no bank device) */
+	struct text	*text;		/* shared text (NULL: in mem[]) */
+
+	Uword	mem[MEMORY_SIZE];	/* 0XX:Program (unless shared), 1XX:Data */
 } Cpub;
 
+#define	PackedFlags(C)	((C)->cf<<3 | (C)->vf<<2 | (C)->nf<<1 | (C)->zf)
+
 /*=============================================================================
  *   Top Function of an Instruction Simulation
+ *
+ *	step() only executes the instruction.  step_full() also serves the
+ *	devices and counts the coverage, the performance counters and the
+ *	modeled cycles; the monitor and the tools reporting any of them use
+ *	it.  step_counted() is step_full() without the devices.
  *===========================================================================*/
 #define	RUN_HALT	0
 #define	RUN_STEP	1
 int	step(Cpub *);
+int	step_full(Cpub *);
+int	step_counted(Cpub *);
+
+Uword	decrypt_instruction(Cpub *);
+Uword	decrypt_operandA(Cpub *);
+Uword	decrypt_operandB(Cpub *);
+char	*mnemonic(Uword);
+
+extern int	err_mesg_off;
+
+
+/*=============================================================================
+ *   Memory Map (mem_map() on every new board)
+ *===========================================================================*/
+void	mem_map(Cpub *);
+Uword	*mem_word(Cpub *, unsigned long);
+void	cpub_copy(Cpub *, Cpub *);
+
+
+/*=============================================================================
+ *   Performance Counters
+ *===========================================================================*/
+void	pmu_reset(Cpub *);
+void	pmu_range(Cpub *, Uword, Uword);
+void	pmu_report(Cpub *);
+
+
+/*=============================================================================
+ *   State Hash (updated on every memory write)
+ *===========================================================================*/
+#define	STATE_KEYS	MEMORY_SIZE	/* keyed by the address (no banks:
+					   not used with devices) */
+
+extern unsigned long long	mem_key[STATE_KEYS];
+
+#define	StateHashWrite(C,A,V)	\
+	((C)->hash += ((unsigned long long)(V) - MemAt(C,A)) \
+		      * mem_key[(A) & ((MEMORY_SIZE) - 1)])
+
+void	state_hash_init(Cpub *);
+unsigned long long	state_hash(Cpub *);
+
+
+/*=============================================================================
+ *   Program Files
+ *===========================================================================*/
+int	read_mem_file(Cpub *, char *);
+int	write_mem_file(Cpub *, char *);
 
 
@@ -0,0 +1,537 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	dev.c
+ *	Descrioption:	memory-mapped devices on a timing wheel, interrupts
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"dev.h"
+
+
+#define	Reg(C,D,R)	((C)->mem[0x100 + (D)->base + (R)])
+
+static void	set_reg(Cpub *, Device *, int, Uword);
+static void	schedule(Devices *, Event *, Count);
+static void	cancel(Devices *, Event *);
+static void	run_due(Cpub *, Count);
+static void	raise_irq(Cpub *, Device *);
+static int	irq_pending(Cpub *);
+static int	irq_armed(Cpub *);
+static void	intc_write(Cpub *, Device *, int);
+static void	timer_write(Cpub *, Device *, int);
+static void	timer_event(Cpub *, Device *, int);
+static void	counter_write(Cpub *, Device *, int);
+static void	counter_event(Cpub *, Device *, int);
+static void	uart_write(Cpub *, Device *, int);
+static void	uart_event(Cpub *, Device *, int);
+static void	bank_write(Cpub *, Device *, int);
+
+#define	UART_RX		0	/* event kinds */
+#define	UART_TX		1
+
+static struct devtype {
+	char	*type;
+	int	size;
+	void	(*write)(Cpub *, Device *, int);
+	void	(*event)(Cpub *, Device *, int);
+} devtypes[] = {
+	{ "intc",	5,	intc_write,	NULL },
+	{ "timer",	4,	timer_write,	timer_event },
+	{ "counter",	4,	counter_write,	counter_event },
+	{ "uart",	5,	uart_write,	uart_event },
+	{ "bank",	2,	bank_write,	NULL },
+	{ NULL }
+};
+
+
+/*=============================================================================
+ *   Attach/Detach
+ *===========================================================================*/
+int
+dev_attach(Cpub *cpub, char *type, Uword base, char *in)
+{
+	Devices		*ds = cpub->dev;
+	Device		*d;
+	struct devtype	*t;
+	int		i;
+
+	for( t = devtypes ; t->type != NULL && strcmp(t->type,type) ; t++ )
+		;
+	if( t->type == NULL ) {
+		fprintf(stderr,"Unknown device: %s\n",type);
+		return -1;
+	}
+	if( base + t->size > (!strcmp(type,"bank") ? BANK_WINDOW
+						     : IMEMORY_SIZE) ) {
+		fprintf(stderr,"Invalid address: 0x%x\n",base);
+		return -1;
+	}
+	if( ds == NULL ) {
+		ds = cpub->dev = calloc(1,sizeof(Devices));
+		ds->next = DEV_NEVER;
+		ds->now = cpub->cycle;
+	}
+	if( ds->ndev == DEV_MAX
+	    || (!strcmp(type,"intc") && ds->intc != NULL) ) {
+		fprintf(stderr,"Too many devices\n");
+		return -1;
+	}
+	for( i = 0 ; i < t->size ; i++ )
+		if( ds->map[base + i] ) {
+			fprintf(stderr,"0x%03x is used by another device\n",
+				0x100 + base + i);
+			return -1;
+		}
+
+	if( !strcmp(type,"bank") && cpub->xmem == NULL
+	    && (cpub->xmem = calloc(XBANKS - 1,XBANK_SIZE)) == NULL ) {
+		fprintf(stderr,"Unable to allocate the banks\n");
+		return -1;
+	}
+
+	d = &ds->dev[ds->ndev];
+	memset(d,0,sizeof(Device));
+	if( in != NULL && (d->in = fopen(in,"rb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",in);
+		return -1;
+	}
+	d->type = t->type;
+	d->base = base;
+	d->size = t->size;
+	d->line = ds->ndev++;
+	d->write = t->write;
+	d->event = t->event;
+	for( i = 0 ; i < 2 ; i++ ) {
+		d->ev[i].dev = d;
+		d->ev[i].kind = i;
+	}
+	for( i = 0 ; i < t->size ; i++ ) {
+		ds->map[base + i] = d->line + 1;
+		set_reg(cpub,d,i,0);
+	}
+	if( !strcmp(type,"intc") )
+		ds->intc = d;
+	if( !strcmp(type,"uart") && d->in != NULL )
+		schedule(ds,&d->ev[UART_RX],cpub->cycle + 256 * DEV_TICK);
+	return 0;
+}
+
+
+void
+dev_detach(Cpub *cpub)
+{
+	Devices	*ds = cpub->dev;
+	int	i;
+
+	if( ds == NULL )
+		return;
+	for( i = 0 ; i < ds->ndev ; i++ )
+		if( ds->dev[i].in != NULL )
+			fclose(ds->dev[i].in);
+	fflush(stdout);
+	free(ds);
+	cpub->dev = NULL;
+	for( i = PAGES / 2 ; i < PAGES ; i++ )		/* the banks 0 */
+		cpub->page[i] = cpub->mem + (i << PAGE_SHIFT);
+	free(cpub->xmem);
+	cpub->xmem = NULL;
+}
+
+
+void
+dev_list(Cpub *cpub)
+{
+	Devices	*ds = cpub->dev;
+	Device	*d;
+	int	i;
+
+	if( ds == NULL ) {
+		fprintf(stderr,"   no devices\n");
+		return;
+	}
+	fprintf(stderr,"   cycle %llu, next event %s",cpub->cycle,
+		ds->next == DEV_NEVER ? "none\n" : "at ");
+	if( ds->next != DEV_NEVER )
+		fprintf(stderr,"%llu\n",ds->next);
+	for( i = 0 ; i < ds->ndev ; i++ ) {
+		d = &ds->dev[i];
+		fprintf(stderr,"   %d: %-8s 0x%03x-0x%03x\n",d->line,d->type,
+			0x100 + d->base,0x100 + d->base + d->size - 1);
+	}
+}
+
+
+/*=============================================================================
+ *   Timing Wheel
+ *
+ *	An event is linked into the slot of its cycle modulo WHEEL_SIZE;
+ *	only the slots passed since the last service are looked at.
+ *===========================================================================*/
+static void
+schedule(Devices *ds, Event *e, Count when)
+{
+	Event	**slot;
+
+	if( e->pending )
+		cancel(ds,e);
+	slot = &ds->wheel[when % WHEEL_SIZE];
+	e->when = when;
+	e->next = *slot;
+	*slot = e;
+	e->pending = 1;
+	if( when < ds->next )
+		ds->next = when;
+}
+
+
+static void
+cancel(Devices *ds, Event *e)
+{
+	Event	**p;
+
+	for( p = &ds->wheel[e->when % WHEEL_SIZE] ; *p ; p = &(*p)->next )
+		if( *p == e ) {
+			*p = e->next;
+			break;
+		}
+	e->pending = 0;
+}
+
+
+static void
+run_due(Cpub *cpub, Count now)
+{
+	Devices	*ds = cpub->dev;
+	Event	*due[DEV_MAX * 2], **p, *e;
+	Count	c, from;
+	int	n, i;
+
+	from = (now - ds->now >= WHEEL_SIZE) ? now - WHEEL_SIZE + 1
+					     : ds->now + 1;
+	for( c = from ; c <= now ; c++ ) {
+		/*
+		 *   Unlink the due events first: handlers may reschedule
+		 */
+		n = 0;
+		for( p = &ds->wheel[c % WHEEL_SIZE] ; (e = *p) != NULL ; ) {
+			if( e->when <= now ) {
+				*p = e->next;
+				e->pending = 0;
+				due[n++] = e;
+			} else
+				p = &e->next;
+		}
+		for( i = 0 ; i < n ; i++ )
+			due[i]->dev->event(cpub,due[i]->dev,due[i]->kind);
+	}
+	ds->now = now;
+
+	ds->next = DEV_NEVER;
+	for( i = 0 ; i < ds->ndev ; i++ )
+		for( n = 0 ; n < 2 ; n++ )
+			if( ds->dev[i].ev[n].pending
+			    && ds->dev[i].ev[n].when < ds->next )
+				ds->next = ds->dev[i].ev[n].when;
+}
+
+
+/*=============================================================================
+ *   Service: Due Events, Interrupts and Sleep
+ *
+ *	Called by step_full() before an instruction when the earliest event
+ *	is due.  A sleeping board skips to the next event directly, for at
+ *	most DEV_SLEEP_PASSES events; then it returns DEV_ASLEEP and
+ *	step_full() comes back without an instruction, so c can still be
+ *	stopped.
+ *	Sleeping with no enabled interrupt that a pending event can raise
+ *	halts the board.
+ *===========================================================================*/
+int
+dev_service(Cpub *cpub)
+{
+	Devices	*ds = cpub->dev;
+	Device	*ic = ds->intc;
+	int	pass;
+
+	for( pass = 0 ; pass < DEV_SLEEP_PASSES ; pass++ ) {
+		run_due(cpub,cpub->cycle);
+		if( irq_pending(cpub) ) {
+			ds->pc = cpub->pc;
+			ds->acc = cpub->acc;
+			ds->ix = cpub->ix;
+			ds->flags = PackedFlags(cpub);
+			set_reg(cpub,ic,4,cpub->pc);
+			cpub->pc = Reg(cpub,ic,2);
+			ds->in_irq = 1;
+			ds->sleeping = 0;
+			return RUN_STEP;
+		}
+		if( !ds->sleeping )
+			return RUN_STEP;
+		if( !irq_armed(cpub) ) {
+			fprintf(stderr,"Sleeping with no interrupt to come.\n");
+			ds->sleeping = 0;
+			return RUN_HALT;
+		}
+		cpub->cycle = ds->next;
+	}
+	return DEV_ASLEEP;
+}
+
+
+/*
+ *   1 if a pending event may raise an enabled interrupt line
+ */
+static int
+irq_armed(Cpub *cpub)
+{
+	Devices	*ds = cpub->dev;
+	Device	*d;
+	Uword	ctrl;
+	int	i;
+
+	if( ds->intc == NULL )
+		return 0;
+	for( i = 0 ; i < ds->ndev ; i++ ) {
+		d = &ds->dev[i];
+		if( !(Reg(cpub,ds->intc,0) & 1 << d->line) )
+			continue;
+		if( d->event == timer_event ) {
+			if( d->ev[0].pending && (Reg(cpub,d,0) & 0x04) )
+				return 1;
+		} else if( d->event == counter_event ) {
+			if( d->ev[0].pending && (Reg(cpub,d,0) & 0x02) )
+				return 1;
+		} else if( d->event == uart_event ) {
+			ctrl = Reg(cpub,d,3);
+			if( (d->ev[UART_RX].pending && (ctrl & 0x01))
+			    || (d->ev[UART_TX].pending && (ctrl & 0x02)) )
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+static int
+irq_pending(Cpub *cpub)
+{
+	Devices	*ds = cpub->dev;
+
+	return ds->intc != NULL && !ds->in_irq
+		&& (Reg(cpub,ds->intc,0) & Reg(cpub,ds->intc,1));
+}
+
+
+static void
+raise_irq(Cpub *cpub, Device *d)
+{
+	Devices	*ds = cpub->dev;
+
+	if( ds->intc == NULL )
+		return;
+	set_reg(cpub,ds->intc,1,Reg(cpub,ds->intc,1) | 1 << d->line);
+	ds->next = cpub->cycle;		/* checked before the next step */
+}
+
+
+/*
+ *   Called by store() after every memory write; a store into a bank
+ *   over a device register (the page is not the board's own) does not
+ *   reach the device
+ */
+void
+dev_write(Cpub *cpub, Addr a)
+{
+	Devices	*ds = cpub->dev;
+	Device	*d;
+
+	if( (a & ~0xff) != 0x100 || !ds->map[a & 0xff]
+	    || &MemAt(cpub,a) != &cpub->mem[a] )
+		return;
+	d = &ds->dev[ds->map[a & 0xff] - 1];
+	d->write(cpub,d,(a & 0xff) - d->base);
+}
+
+
+static void
+set_reg(Cpub *cpub, Device *d, int r, Uword v)
+{
+	Addr	a = 0x100 + d->base + r;
+
+	StateHashWrite(cpub,a,v);
+	cpub->mem[a] = v;
+}
+
+
+/*=============================================================================
+ *   Interrupt Controller
+ *===========================================================================*/
+static void
+intc_write(Cpub *cpub, Device *d, int r)
+{
+	Devices	*ds = cpub->dev;
+	Uword	ctrl = Reg(cpub,d,3);
+
+	if( r == 3 && (ctrl & 0x01) && ds->in_irq ) {	/* return */
+		cpub->pc = ds->pc;
+		cpub->acc = ds->acc;
+		cpub->ix = ds->ix;
+		cpub->cf = ds->flags >> 3 & 1;
+		cpub->vf = ds->flags >> 2 & 1;
+		cpub->nf = ds->flags >> 1 & 1;
+		cpub->zf = ds->flags & 1;
+		ds->in_irq = 0;
+	}
+	if( r == 3 && (ctrl & 0x02) )			/* sleep */
+		ds->sleeping = 1;
+	if( r == 3 )
+		set_reg(cpub,d,3,0);
+	ds->next = cpub->cycle;		/* IE, IP or CTRL: check again */
+}
+
+
+/*=============================================================================
+ *   Timer
+ *===========================================================================*/
+#define	Period(V)	(((V) ? (V) : 256) * DEV_TICK)
+
+static void
+timer_write(Cpub *cpub, Device *d, int r)
+{
+	if( r != 0 )
+		return;
+	if( Reg(cpub,d,0) & 0x01 )
+		schedule(cpub->dev,&d->ev[0],
+			 cpub->cycle + Period(Reg(cpub,d,1)));
+	else if( d->ev[0].pending )
+		cancel(cpub->dev,&d->ev[0]);
+}
+
+
+static void
+timer_event(Cpub *cpub, Device *d, int kind)
+{
+	Uword	ctrl = Reg(cpub,d,0);
+
+	set_reg(cpub,d,2,Reg(cpub,d,2) | 0x01);
+	set_reg(cpub,d,3,Reg(cpub,d,3) + 1);
+	if( ctrl & 0x04 )
+		raise_irq(cpub,d);
+	if( ctrl & 0x02 )
+		schedule(cpub->dev,&d->ev[kind],
+			 d->ev[kind].when + Period(Reg(cpub,d,1)));
+	else
+		set_reg(cpub,d,0,ctrl & ~0x01);
+}
+
+
+/*=============================================================================
+ *   Counter
+ *===========================================================================*/
+static void
+counter_write(Cpub *cpub, Device *d, int r)
+{
+	if( r != 0 )
+		return;
+	if( Reg(cpub,d,0) & 0x01 )
+		schedule(cpub->dev,&d->ev[0],
+			 cpub->cycle + (Reg(cpub,d,1) + 1) * DEV_TICK);
+	else if( d->ev[0].pending )
+		cancel(cpub->dev,&d->ev[0]);
+}
+
+
+static void
+counter_event(Cpub *cpub, Device *d, int kind)
+{
+	Uword	v = Reg(cpub,d,2) + 1;
+
+	set_reg(cpub,d,2,v);
+	if( (Reg(cpub,d,0) & 0x02) && v == Reg(cpub,d,3) )
+		raise_irq(cpub,d);
+	schedule(cpub->dev,&d->ev[kind],
+		 d->ev[kind].when + (Reg(cpub,d,1) + 1) * DEV_TICK);
+}
+
+
+/*=============================================================================
+ *   UART
+ *===========================================================================*/
+static void
+uart_write(Cpub *cpub, Device *d, int r)
+{
+	Count	bytetime = Period(Reg(cpub,d,4));
+
+	switch( r ) {
+	   case 0:	/* STATUS: receive the next byte once bit0 is cleared */
+		set_reg(cpub,d,0,(Reg(cpub,d,0) & 0x01)
+				 | (d->ev[UART_TX].pending ? 0x02 : 0)
+				 | (d->eof ? 0x04 : 0));
+		if( !(Reg(cpub,d,0) & 0x01) && d->in != NULL && !d->eof
+		    && !d->ev[UART_RX].pending )
+			schedule(cpub->dev,&d->ev[UART_RX],
+				 cpub->cycle + bytetime);
+		break;
+	   case 2:	/* TXDATA */
+		if( Reg(cpub,d,0) & 0x02 )
+			break;		/* busy: the byte is lost */
+		d->tx = Reg(cpub,d,2);
+		set_reg(cpub,d,0,Reg(cpub,d,0) | 0x02);
+		schedule(cpub->dev,&d->ev[UART_TX],cpub->cycle + bytetime);
+		break;
+	}
+}
+
+
+static void
+uart_event(Cpub *cpub, Device *d, int kind)
+{
+	int	c;
+
+	if( kind == UART_TX ) {
+		putchar(d->tx);
+		set_reg(cpub,d,0,Reg(cpub,d,0) & ~0x02);
+		if( Reg(cpub,d,3) & 0x02 )
+			raise_irq(cpub,d);
+		return;
+	}
+
+	if( Reg(cpub,d,0) & 0x01 )
+		return;		/* not taken yet: waits for STATUS */
+	if( (c = fgetc(d->in)) == EOF ) {
+		d->eof = 1;
+		set_reg(cpub,d,0,Reg(cpub,d,0) | 0x04);
+		return;
+	}
+	set_reg(cpub,d,1,c);
+	set_reg(cpub,d,0,Reg(cpub,d,0) | 0x01);
+	if( Reg(cpub,d,3) & 0x01 )
+		raise_irq(cpub,d);
+}
+
+
+/*=============================================================================
+ *   Bank Select
+ *
+ *	Points the pages of the window at the bank (Cpub::xmem) or back
+ *	at the board's own memory.
+ *===========================================================================*/
+static void
+bank_write(Cpub *cpub, Device *d, int r)
+{
+	Uword	n = Reg(cpub,d,r) & (XBANKS - 1);
+	Addr	w = 0x100 + BANK_WINDOW + r * XBANK_SIZE;
+	int	i;
+
+	set_reg(cpub,d,r,n);
+	for( i = 0 ; i < XBANK_SIZE >> PAGE_SHIFT ; i++ )
+		cpub->page[(w >> PAGE_SHIFT) + i] = n
+			? cpub->xmem + (n - 1) * XBANK_SIZE + (i << PAGE_SHIFT)
+			: cpub->mem + w + (i << PAGE_SHIFT);
+}
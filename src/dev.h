@@ -0,0 +1,92 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	dev.h
+ *	Descrioption:	memory-mapped devices on a timing wheel, interrupts
+ */
+
+/*=============================================================================
+ *   Devices
+ *
+ *	Device registers are locations of the data region.  A device
+ *	publishes its state by writing them and acts when the program
+ *	writes one (store() calls dev_write()); reads are plain memory.
+ *	Device events are kept on a timing wheel keyed by the modeled cycle
+ *	(Cpub::cycle) and step_full() calls dev_service() only when the
+ *	earliest one is due.
+ *
+ *	intc	interrupt controller
+ *		+0 IE	enabled lines (bit n: device n)
+ *		+1 IP	pending lines (set by the devices, cleared by writing)
+ *		+2 VEC	pc of the handler
+ *		+3 CTRL	write bit0: return from the handler (restores pc, acc,
+ *			ix and the flags), bit1: sleep until an interrupt
+ *		+4 SPC	pc of the interrupted program
+ *	timer	+0 CTRL	bit0 run, bit1 periodic, bit2 interrupt
+ *		+1 PERIOD  in units of DEV_TICK cycles (0: 256)
+ *		+2 STATUS  bit0 expired
+ *		+3 COUNT   expirations
+ *	counter	+0 CTRL	bit0 run, bit1 interrupt when VALUE reaches COMPARE
+ *		+1 PRESCALE  VALUE counts every (PRESCALE + 1) * DEV_TICK cycles
+ *		+2 VALUE
+ *		+3 COMPARE
+ *	uart	+0 STATUS  bit0 received, bit1 transmitting, bit2 end of input
+ *		   (clear bit0 to receive the next byte)
+ *		+1 RXDATA
+ *		+2 TXDATA  writing it transmits the byte (to stdout)
+ *		+3 CTRL	bit0 interrupt on receive, bit1 on transmit done
+ *		+4 BAUD	cycles per byte in units of DEV_TICK (0: 256)
+ *	bank	+0 SEL0	bank of the extended memory seen at data 0x80-0xbf
+ *		+1 SEL1	bank seen at data 0xc0-0xff (0: the board's own
+ *			memory; modulo XBANKS).  It sits below 0x80; the
+ *			registers of another device in a window are hidden
+ *			while a bank is selected there.  The banks are
+ *			allocated with the first bank device.
+ *===========================================================================*/
+#define	DEV_MAX		8
+#define	DEV_TICK	16		/* cycles */
+#define	WHEEL_SIZE	256		/* slots (one cycle each) */
+#define	DEV_NEVER	(~0ULL)
+#define	BANK_WINDOW	0x80		/* data address of SEL0's window */
+#define	DEV_SLEEP_PASSES	1024	/* events skipped per dev_service() */
+#define	DEV_ASLEEP	2		/* dev_service(): no instruction */
+
+typedef struct event {
+	Count		when;		/* cycle */
+	struct device	*dev;
+	int		kind;		/* passed to the handler */
+	int		pending;
+	struct event	*next;
+} Event;
+
+typedef struct device {
+	char	*type;
+	Addr	base;			/* address in the data region */
+	int	size;
+	int	line;			/* interrupt line */
+	void	(*write)(Cpub *, struct device *, int);
+	void	(*event)(Cpub *, struct device *, int);
+	Event	ev[2];
+	Uword	tx;			/* uart: byte being transmitted */
+	FILE	*in;			/* uart: received bytes */
+	int	eof;
+} Device;
+
+typedef struct devices {
+	Count	next;			/* cycle of the earliest event */
+	Count	now;			/* cycle up to which the wheel ran */
+	Event	*wheel[WHEEL_SIZE];
+	int	ndev;
+	Device	dev[DEV_MAX];
+	Uword	map[IMEMORY_SIZE];	/* data region: device number + 1 */
+	Device	*intc;
+	int	in_irq, sleeping;
+	Uword	pc, acc, ix, flags;	/* saved at the interrupt */
+} Devices;
+
+int	dev_attach(Cpub *, char *, Uword, char *);
+void	dev_detach(Cpub *);
+void	dev_list(Cpub *);
+int	dev_service(Cpub *);
+void	dev_write(Cpub *, Addr);
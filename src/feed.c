@@ -0,0 +1,340 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	feed.c
+ *	Descrioption:	state-change feed for front-ends (Unix-domain socket)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<errno.h>
+#include	<poll.h>
+#include	<time.h>
+#include	<sys/socket.h>
+#include	<sys/un.h>
+#include	"cpuboard.h"
+#include	"feed.h"
+
+
+static void	feed_accept(Feed *);
+static void	feed_requests(Feed *);
+static void	feed_drop(Feed *, int);
+static int	feed_send(Feed *, int, unsigned char *, int);
+static void	feed_regs(Cpub *, Uword *);
+static int	encode(Feed *, Cpub *, unsigned char *, Uword *, int);
+static double	feed_now(void);
+
+
+/*=============================================================================
+ *   Open/Close the Feed of a CPU Board
+ *===========================================================================*/
+int
+feed_open(Cpub *cpub, int cpub_id, char *path)
+{
+	struct sockaddr_un	sa;
+	Feed	*fe;
+	int	i;
+
+	if( strlen(path) >= sizeof(sa.sun_path) ) {
+		fprintf(stderr,"Socket path too long: %s\n",path);
+		return -1;
+	}
+	if( cpub->feed != NULL )
+		feed_close(cpub);
+
+	if( (fe = calloc(1,sizeof(Feed))) == NULL ) {
+		fprintf(stderr,"Unable to allocate the feed\n");
+		return -1;
+	}
+	memset(&sa,0,sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path,path);
+	unlink(path);			/* left by an earlier session */
+	if( (fe->lsock = socket(AF_UNIX,SOCK_STREAM,0)) < 0
+	    || bind(fe->lsock,(struct sockaddr *)&sa,sizeof(sa)) < 0
+	    || listen(fe->lsock,FEED_CLIENTS) < 0 ) {
+		fprintf(stderr,"Unable to listen on %s\n",path);
+		if( fe->lsock >= 0 )
+			close(fe->lsock);
+		free(fe);
+		return -1;
+	}
+	fcntl(fe->lsock,F_SETFL,O_NONBLOCK);
+
+	for( i = 0 ; i < FEED_CLIENTS ; i++ ) {
+		fe->client[i] = -1;
+		fe->owe[i] = 0;
+	}
+	fe->id = cpub_id;
+	fe->seq = 0;
+	fe->frames = fe->bytes = 0;
+	fe->last = 0;
+	strcpy(fe->path,path);
+	feed_regs(cpub,fe->regs);
+	memcpy(fe->mem,cpub->mem,MEMORY_SIZE);
+	if( cpub->xmem != NULL )
+		memcpy(fe->mem + MEMORY_SIZE,cpub->xmem,
+		       XMEMORY_SIZE - MEMORY_SIZE);
+	cpub->feed = fe;
+	return 0;
+}
+
+
+void
+feed_close(Cpub *cpub)
+{
+	Feed	*fe = cpub->feed;
+	int	i;
+
+	if( fe == NULL )
+		return;
+	for( i = 0 ; i < FEED_CLIENTS ; i++ )
+		if( fe->client[i] >= 0 )
+			close(fe->client[i]);
+	close(fe->lsock);
+	unlink(fe->path);
+	free(fe);
+	cpub->feed = NULL;
+}
+
+
+void
+feed_report(Cpub *cpub)
+{
+	Feed	*fe = cpub->feed;
+	int	i, n = 0;
+
+	if( fe == NULL ) {
+		fprintf(stderr,"   no feed\n");
+		return;
+	}
+	for( i = 0 ; i < FEED_CLIENTS ; i++ )
+		n += fe->client[i] >= 0;
+	fprintf(stderr,"   %s: %d clients, %llu frames, %llu bytes sent\n",
+		fe->path,n,fe->frames,fe->bytes);
+}
+
+
+/*=============================================================================
+ *   Publish the Changes
+ *
+ *	Takes new clients and resync requests, then sends a delta (if
+ *	anything changed) to the clients that are in step and a full frame
+ *	to the others.
+ *===========================================================================*/
+void
+feed_publish(Cpub *cpub)
+{
+	Feed	*fe = cpub->feed;
+	Uword	regs[8];
+	int	i, dlen, flen = 0;
+
+	feed_accept(fe);
+	feed_requests(fe);
+
+	feed_regs(cpub,regs);
+
+	/*
+	 *   The delta brings the copy up to date (even without clients),
+	 *   so it is taken before any full frame
+	 */
+	dlen = encode(fe,cpub,fe->dbuf,regs,0);
+	for( i = 0 ; i < FEED_CLIENTS ; i++ ) {
+		if( fe->client[i] < 0 )
+			continue;
+		if( fe->owe[i] ) {
+			if( flen == 0 )
+				flen = encode(fe,cpub,fe->fbuf,regs,1);
+			if( feed_send(fe,i,fe->fbuf,flen) )
+				fe->owe[i] = 0;
+		} else if( dlen > 0 && !feed_send(fe,i,fe->dbuf,dlen) )
+			fe->owe[i] = 1;
+	}
+	fe->last = feed_now();
+}
+
+
+/*
+ *   Between blocks of c: at most every FEED_PERIOD ms
+ */
+void
+feed_batch(Cpub *cpub)
+{
+	if( feed_now() - cpub->feed->last >= FEED_PERIOD * 1e-3 )
+		feed_publish(cpub);
+}
+
+
+/*
+ *   The fields of the mask (FD_PC ..) in order
+ */
+static void
+feed_regs(Cpub *cpub, Uword *regs)
+{
+	regs[0] = cpub->pc;
+	regs[1] = cpub->acc;
+	regs[2] = cpub->ix;
+	regs[3] = PackedFlags(cpub);
+	regs[4] = cpub->ibuf->flag;
+	regs[5] = cpub->ibuf->buf;
+	regs[6] = cpub->obuf.flag;
+	regs[7] = cpub->obuf.buf;
+}
+
+
+/*
+ *   A frame of the board into buf (full, or the changes since the copy,
+ *   which is updated); the length, or -1 if a delta has nothing
+ */
+static int
+encode(Feed *fe, Cpub *cpub, unsigned char *buf, Uword *regs, int full)
+{
+	unsigned char	*p = buf + FEED_HEADER_SIZE;
+	unsigned long long	insns = cpub->pmu.insns;
+	int		i, line, nlines = 0, mask = 0, len;
+	unsigned char	*np;
+
+	for( i = 0 ; i < 8 ; i++ )
+		if( full || regs[i] != fe->regs[i] ) {
+			mask |= 1 << i;
+			*p++ = regs[i];
+			fe->regs[i] = regs[i];
+		}
+	np = p;
+	p += 2;
+	for( line = 0 ; line < FEED_LINES ; line++ ) {
+		Uword	*m = mem_word(cpub,line * FEED_LINE);
+
+		if( m == NULL )			/* no banks */
+			break;
+		if( !full && !memcmp(m,fe->mem + line * FEED_LINE,FEED_LINE) )
+			continue;
+		*p++ = line;
+		*p++ = line >> 8;
+		memcpy(p,m,FEED_LINE);
+		memcpy(fe->mem + line * FEED_LINE,m,FEED_LINE);
+		p += FEED_LINE;
+		nlines++;
+	}
+	if( !full && mask == 0 && nlines == 0 )
+		return -1;
+	np[0] = nlines;
+	np[1] = nlines >> 8;
+
+	len = p - buf;
+	buf[0] = len;
+	buf[1] = len >> 8;
+	buf[2] = full ? FEED_FULL : FEED_DELTA;
+	buf[3] = fe->id;
+	if( !full )
+		fe->seq++;
+	for( i = 0 ; i < 4 ; i++ )
+		buf[4 + i] = fe->seq >> (8 * i);
+	for( i = 0 ; i < 8 ; i++ )
+		buf[8 + i] = insns >> (8 * i);
+	buf[16] = mask;
+	return len;
+}
+
+
+/*=============================================================================
+ *   Clients
+ *===========================================================================*/
+static void
+feed_accept(Feed *fe)
+{
+	int	s, i;
+
+	while( (s = accept(fe->lsock,NULL,NULL)) >= 0 ) {
+		for( i = 0 ; i < FEED_CLIENTS && fe->client[i] >= 0 ; i++ )
+			;
+		if( i == FEED_CLIENTS ) {
+			close(s);	/* no room */
+			continue;
+		}
+		fcntl(s,F_SETFL,O_NONBLOCK);
+		fe->client[i] = s;
+		fe->owe[i] = 1;
+	}
+}
+
+
+/*
+ *   FEED_RESYNC asks for a full frame; the end of the stream closes
+ */
+static void
+feed_requests(Feed *fe)
+{
+	unsigned char	req[64];
+	ssize_t		n;
+	int		i, k;
+
+	for( i = 0 ; i < FEED_CLIENTS ; i++ ) {
+		if( fe->client[i] < 0 )
+			continue;
+		while( (n = read(fe->client[i],req,sizeof(req))) > 0 )
+			for( k = 0 ; k < n ; k++ )
+				if( req[k] == FEED_RESYNC )
+					fe->owe[i] = 1;
+		if( n == 0 || (n < 0 && errno != EAGAIN
+			       && errno != EWOULDBLOCK) )
+			feed_drop(fe,i);
+	}
+}
+
+
+static void
+feed_drop(Feed *fe, int i)
+{
+	close(fe->client[i]);
+	fe->client[i] = -1;
+}
+
+
+/*
+ *   1 if the frame went out; 0 if the socket was full (nothing sent).
+ *   A frame partly sent is finished within a short wait, or the client
+ *   is dropped since its stream would be out of step.
+ */
+static int
+feed_send(Feed *fe, int i, unsigned char *buf, int len)
+{
+	struct pollfd	pfd;
+	ssize_t		n;
+	int		done = 0;
+
+	while( done < len ) {
+		n = send(fe->client[i],buf + done,len - done,MSG_NOSIGNAL);
+		if( n > 0 ) {
+			done += n;
+			continue;
+		}
+		if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ) {
+			if( done == 0 )
+				return 0;
+			pfd.fd = fe->client[i];
+			pfd.events = POLLOUT;
+			if( poll(&pfd,1,100) > 0 )
+				continue;
+		}
+		feed_drop(fe,i);
+		return 0;
+	}
+	fe->frames++;
+	fe->bytes += len;
+	return 1;
+}
+
+
+static double
+feed_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
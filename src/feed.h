@@ -0,0 +1,74 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	feed.h
+ *	Descrioption:	state-change feed for front-ends (Unix-domain socket)
+ */
+
+/*=============================================================================
+ *   Frame Format (little endian)
+ *
+ *	frame:	length(2) kind(1) board-id(1) seq(4) insns(8) mask(1)
+ *		[pc] [acc] [ix] [flags] [if] [ibuf] [of] [obuf]
+ *		nlines(2) { line(2) bytes(16) } ...
+ *
+ *	length counts the whole frame.  A full frame (FEED_FULL) has every
+ *	field and every line of the memory (as for m, with the banks of a
+ *	bank device; line = address / 16); a delta (FEED_DELTA) only the
+ *	fields flagged in the mask and the lines that changed since the
+ *	previous frame.  A client gets a full frame first and whenever it
+ *	sends FEED_RESYNC.
+ *===========================================================================*/
+#define	FEED_FULL	'F'
+#define	FEED_DELTA	'D'
+#define	FEED_RESYNC	'R'		/* request from a client */
+
+#define	FD_PC		0x01
+#define	FD_ACC		0x02
+#define	FD_IX		0x04
+#define	FD_FLAGS	0x08	/* cf<<3 | vf<<2 | nf<<1 | zf */
+#define	FD_IF		0x10
+#define	FD_IBUF		0x20
+#define	FD_OF		0x40
+#define	FD_OBUF		0x80
+
+#define	FEED_LINE	16
+#define	FEED_LINES	((XMEMORY_SIZE) / FEED_LINE)
+#define	FEED_HEADER_SIZE	17
+#define	FEED_FRAME_MAX	(FEED_HEADER_SIZE + 8 + 2 \
+			 + FEED_LINES * (2 + FEED_LINE))
+
+
+/*=============================================================================
+ *   Feed Server
+ *
+ *	The board's state is compared with the copy sent last, so nothing
+ *	is added to step_full().  Frames go out after each command and, while
+ *	c runs, at most every FEED_PERIOD ms between blocks.  A client
+ *	whose socket is full misses the frame and is sent a full one next.
+ *===========================================================================*/
+#define	FEED_CLIENTS	8
+#define	FEED_PERIOD	20		/* ms between frames of a run */
+#define	FEED_PATH_MAX	108
+
+typedef struct feed {
+	int		lsock;			/* listening socket */
+	int		client[FEED_CLIENTS];	/* -1: none */
+	int		owe[FEED_CLIENTS];	/* 1: owed a full frame */
+	int		id;			/* board */
+	unsigned int	seq;
+	unsigned long long	frames, bytes;
+	double		last;			/* time of the last frame */
+	char		path[FEED_PATH_MAX];
+	Uword		regs[8];		/* as sent last */
+	Uword		mem[XMEMORY_SIZE];
+	unsigned char	fbuf[FEED_FRAME_MAX];	/* full frame */
+	unsigned char	dbuf[FEED_FRAME_MAX];	/* delta */
+} Feed;
+
+int	feed_open(Cpub *, int, char *);
+void	feed_close(Cpub *);
+void	feed_publish(Cpub *);
+void	feed_batch(Cpub *);
+void	feed_report(Cpub *);
@@ -0,0 +1,202 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	fuse.c
+ *	Descrioption:	superinstructions (fused instruction sequences)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"fuse.h"
+#include	"text.h"
+
+
+const char	*fuse_name[FUSE_KINDS] = {
+	"", "EOR r,r", "CMP+Bbc", "SUB+Bbc", "LD+ADD+ST"
+};
+const int	fuse_insns[FUSE_KINDS] = { 1, 1, 2, 2, 3 };
+
+static Segment	*seg_of(Text *);
+static void	seg_scan(Segment *, Uword *);
+static int	match(Uword *, Uword, Uword *);
+
+static Segment		unfused;	/* no sequences (no memory) */
+static pthread_mutex_t	seg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*=============================================================================
+ *   On/Off
+ *===========================================================================*/
+int
+fuse_on(Cpub *cpub)
+{
+	if( cpub->fuse == NULL
+	    && (cpub->fuse = calloc(1,sizeof(Fusion))) == NULL ) {
+		fprintf(stderr,"Unable to allocate the fusion table\n");
+		return -1;
+	}
+	fuse_scan(cpub);
+	return 0;
+}
+
+
+void
+fuse_off(Cpub *cpub)
+{
+	free(cpub->fuse);
+	cpub->fuse = NULL;
+}
+
+
+/*=============================================================================
+ *   Scan the Text Area
+ *
+ *	The board shares its text with the boards of the same program and
+ *	takes the segment of that text, scanned by the first of them.  A
+ *	segment is never changed once scanned, so a board leaving the
+ *	text does not disturb the others (copy-on-write).
+ *===========================================================================*/
+void
+fuse_scan(Cpub *cpub)
+{
+	if( cpub->fuse != NULL && text_share(cpub) == 0 )
+		seg_of(cpub->text);
+}
+
+
+/*
+ *   The segment is published only once scanned, so a board finding it
+ *   set needs no lock
+ */
+static Segment *
+seg_of(Text *t)
+{
+	Segment	*sg;
+
+	if( t == NULL )
+		return &unfused;
+	if( (sg = __atomic_load_n(&t->seg,__ATOMIC_ACQUIRE)) != NULL )
+		return sg;
+	pthread_mutex_lock(&seg_lock);
+	if( (sg = t->seg) == NULL && (sg = malloc(sizeof(Segment))) != NULL ) {
+		seg_scan(sg,t->word);
+		__atomic_store_n(&t->seg,sg,__ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&seg_lock);
+	return sg != NULL ? sg : &unfused;
+}
+
+
+static void
+seg_scan(Segment *sg, Uword *text)
+{
+	Uword	at[3];
+	int	a, k, last;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		sg->kind[a] = k = match(text,a,at);
+		if( k == FUSE_NONE )
+			continue;
+		last = at[fuse_insns[k] - 1];
+		sg->len[a] = (Uword)(last + isa_decode[text[last]].len - a);
+		sg->inner[a][0] = fuse_insns[k] > 1 ? at[1] : a;
+		sg->inner[a][1] = fuse_insns[k] > 2 ? at[2] : sg->inner[a][0];
+	}
+}
+
+
+/*
+ *   Kind of the sequence at a; at[] gets the address of each instruction
+ */
+static int
+match(Uword *text, Uword a, Uword *at)
+{
+	const Decode	*d[3];
+	Uword		opr[3];
+	int		i;
+
+	for( i = 0 ; i < 3 ; i++ ) {
+		at[i] = i ? (Uword)(at[i - 1] + d[i - 1]->len) : a;
+		d[i] = &isa_decode[text[at[i]]];
+		opr[i] = text[(Uword)(at[i] + 1)];
+	}
+
+	/*
+	 *   LD r,X ; ADD r,B ; ST r,X through the same address (ix does
+	 *   not change on the way unless r is IX)
+	 */
+	if( d[0]->code == LD && d[1]->code == ADD && d[2]->code == ST
+	    && d[0]->a == d[1]->a && d[1]->a == d[2]->a
+	    && d[0]->b == d[2]->b && opr[0] == opr[2]
+	    && d[0]->b >= ABS_ADDR_TEXT
+	    && (d[0]->b < IX_MOD_ADDR_TEXT || d[0]->a == 0) )
+		return FUSE_LD_ADD_ST;
+	if( d[0]->code == CMP && d[1]->code == Bbc )
+		return FUSE_CMP_B;
+	if( d[0]->code == SUB && d[1]->code == Bbc )
+		return FUSE_SUB_B;
+	if( d[0]->code == EOR && ((d[0]->b == ACC && d[0]->a == 0)
+				  || (d[0]->b == IX && d[0]->a == 1)) )
+		return FUSE_CLEAR;
+	return FUSE_NONE;
+}
+
+
+/*=============================================================================
+ *   Execute the Sequence at pc (or one instruction)
+ *
+ *	Not across the break-point; *n gets the instructions executed.
+ *===========================================================================*/
+int
+fuse_step(Cpub *cpub, Addr breakp, int *n)
+{
+	Fusion	*fu = cpub->fuse;
+	Segment	*sg;
+	Uword	a = cpub->pc;
+	int	k;
+
+	if( cpub->text == NULL )		/* stored into the text */
+		fuse_scan(cpub);
+	sg = seg_of(cpub->text);
+	k = sg->kind[a];
+	if( k == FUSE_NONE || sg->inner[a][0] == breakp
+	    || sg->inner[a][1] == breakp ) {
+		*n = 1;
+		return step_full(cpub);
+	}
+	fu->fired[k]++;
+	*n = fuse_insns[k];
+	return step_fused(cpub,k);
+}
+
+
+/*=============================================================================
+ *   Report
+ *===========================================================================*/
+void
+fuse_report(Cpub *cpub)
+{
+	Fusion	*fu = cpub->fuse;
+	Segment	*sg;
+	int	a, k, sites[FUSE_KINDS];
+
+	if( fu == NULL ) {
+		fprintf(stderr,"   fusion off\n");
+		return;
+	}
+	sg = seg_of(cpub->text);
+	memset(sites,0,sizeof(sites));
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		sites[sg->kind[a]]++;
+	if( sg != &unfused )
+		fprintf(stderr,"   text segment shared by %d board(s)\n",
+			cpub->text->refs);
+	for( k = 1 ; k < FUSE_KINDS ; k++ )
+		fprintf(stderr,"   %-10s %3d sites %12llu fired\n",
+			fuse_name[k],sites[k],fu->fired[k]);
+}
@@ -0,0 +1,50 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	fuse.h
+ *	Descrioption:	superinstructions (fused instruction sequences)
+ */
+
+/*=============================================================================
+ *   Superinstructions
+ *
+ *	The text area is scanned when a program is loaded; a sequence
+ *	below starting at an address is executed by step_fused() with one
+ *	dispatch.  Each instruction of it still updates the registers,
+ *	the flags, mar/ir, the coverage and the performance counters as
+ *	step_full() does, so the effects are the same.  The sequences are
+ *	found in the board's shared text (text.h); a store into the text
+ *	makes the board's text private and the next fuse_step() shares and
+ *	scans the new one.
+ *===========================================================================*/
+#define	FUSE_NONE	0
+#define	FUSE_CLEAR	1	/* EOR r,r */
+#define	FUSE_CMP_B	2	/* CMP r,B ; Bbc d */
+#define	FUSE_SUB_B	3	/* SUB r,B ; Bbc d */
+#define	FUSE_LD_ADD_ST	4	/* LD r,X ; ADD r,B ; ST r,X */
+#define	FUSE_KINDS	5
+
+/*
+ *   Text segment: the decoded form of a shared text, made by the first
+ *   board scanning it and freed with the text
+ */
+typedef struct segment {
+	Uword	kind[IMEMORY_SIZE];
+	Uword	len[IMEMORY_SIZE];		/* words */
+	Uword	inner[IMEMORY_SIZE][2];		/* addresses of the others */
+} Segment;
+
+typedef struct fusion {
+	Count	fired[FUSE_KINDS];
+} Fusion;
+
+extern const char	*fuse_name[FUSE_KINDS];
+extern const int	fuse_insns[FUSE_KINDS];
+
+int	fuse_on(Cpub *);
+void	fuse_off(Cpub *);
+void	fuse_scan(Cpub *);
+void	fuse_report(Cpub *);
+int	fuse_step(Cpub *, Addr, int *);
+int	step_fused(Cpub *, int);	/* cpuboard.c */
@@ -0,0 +1,715 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	gdb.c
+ *	Descrioption:	GDB remote serial protocol server (debugger stub)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<ctype.h>
+#include	<errno.h>
+#include	<poll.h>
+#include	<sys/socket.h>
+#include	<sys/un.h>
+#include	<netinet/in.h>
+#include	<netinet/tcp.h>
+#include	<arpa/inet.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+#include	"chan.h"
+#include	"fuse.h"
+#include	"feed.h"
+#include	"gdb.h"
+#include	"text.h"
+
+
+static int	gdb_listen(char *);
+static int	command(Gdb *, int);
+static void	resume(Gdb *, int, int);
+static int	interrupted(Gdb *);
+static int	thread(char *, int);
+static int	mem_range(Cpub *, char **, unsigned long *, unsigned long *);
+static void	write_mem(Cpub *, unsigned long, unsigned char *, int);
+static void	get_regs(Cpub *, Uword *);
+static void	put_reg(Cpub *, int, Uword);
+static void	xfer_target(Gdb *, char *);
+static int	get_byte(Gdb *);
+static int	get_packet(Gdb *);
+static void	reply(Gdb *, char *, int);
+static void	put(Gdb *, char *);
+static void	send_all(Gdb *, unsigned char *, int);
+static int	hex(int);
+static unsigned long	number(char **);
+
+
+/*=============================================================================
+ *   Serve One Debugger Session
+ *
+ *	where: a port of the loopback interface (digits) or the path of a
+ *	Unix-domain socket.  Waits for the connection (Ctrl-C cancels)
+ *	and serves the debugger until it detaches, kills or disconnects.
+ *	current: the board of thread 1 .. at the start.
+ *===========================================================================*/
+int
+gdb_serve(Cpub *boards, int current, char *where, int *stop)
+{
+	struct pollfd	pfd;
+	Gdb	*g;
+	int	lsock, sock, one = 1, len;
+
+	if( (lsock = gdb_listen(where)) < 0 )
+		return -1;
+	fprintf(stderr,"Waiting for the debugger on %s (Ctrl-C: cancel).\n",
+		where);
+	__atomic_store_n(stop,0,__ATOMIC_RELAXED);
+	pfd.fd = lsock;
+	pfd.events = POLLIN;
+	while( poll(&pfd,1,200) <= 0 )
+		if( __atomic_load_n(stop,__ATOMIC_RELAXED) )
+			break;
+	sock = (pfd.revents & POLLIN) ? accept(lsock,NULL,NULL) : -1;
+	close(lsock);
+	if( !isdigit((unsigned char)where[0]) )
+		unlink(where);
+	if( sock < 0 ) {
+		fprintf(stderr,"No debugger.\n");
+		return -1;
+	}
+	setsockopt(sock,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+
+	if( (g = malloc(sizeof(Gdb))) == NULL ) {
+		fprintf(stderr,"Unable to allocate the debugger session\n");
+		close(sock);
+		return -1;
+	}
+	memset(g,0,sizeof(Gdb));
+	g->sock = sock;
+	g->boards = boards;
+	g->hg = g->hc = current;
+	g->ack = 1;
+	g->stop = stop;
+	snprintf(g->last,sizeof(g->last),"T05thread:%x;",current + 1);
+	fprintf(stderr,"Debugger connected.\n");
+
+	while( (len = get_packet(g)) >= 0 && command(g,len) )
+		;
+
+	close(sock);
+	free(g);
+	fprintf(stderr,"Debugger detached.\n");
+	return 0;
+}
+
+
+static int
+gdb_listen(char *where)
+{
+	struct sockaddr_un	su;
+	struct sockaddr_in	si;
+	int	s, one = 1;
+
+	if( isdigit((unsigned char)where[0]) ) {
+		memset(&si,0,sizeof(si));
+		si.sin_family = AF_INET;
+		si.sin_port = htons(atoi(where));
+		si.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if( (s = socket(AF_INET,SOCK_STREAM,0)) >= 0 ) {
+			setsockopt(s,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+			if( bind(s,(struct sockaddr *)&si,sizeof(si)) == 0
+			    && listen(s,1) == 0 )
+				return s;
+		}
+	} else if( strlen(where) < sizeof(su.sun_path) ) {
+		memset(&su,0,sizeof(su));
+		su.sun_family = AF_UNIX;
+		strcpy(su.sun_path,where);
+		unlink(where);		/* left by an earlier session */
+		if( (s = socket(AF_UNIX,SOCK_STREAM,0)) >= 0 ) {
+			if( bind(s,(struct sockaddr *)&su,sizeof(su)) == 0
+			    && listen(s,1) == 0 )
+				return s;
+		}
+	} else
+		s = -1;
+	fprintf(stderr,"Unable to listen on %s\n",where);
+	if( s >= 0 )
+		close(s);
+	return -1;
+}
+
+
+/*=============================================================================
+ *   Packets
+ *
+ *	Returns 0 to end the session.
+ *===========================================================================*/
+static int
+command(Gdb *g, int len)
+{
+	char		buf[GDB_PACKET], *p = (char *)g->pkt + 1;
+	Cpub		*cpub = &g->boards[g->hg];
+	Uword		regs[GDB_REGS];
+	unsigned long	addr, n, i;
+	int		k, t, c;
+
+	switch( g->pkt[0] ) {
+	   case '?':
+		put(g,g->last);
+		break;
+	   case 'g':
+		get_regs(cpub,regs);
+		for( k = 0 ; k < GDB_REGS ; k++ )
+			sprintf(buf + 2 * k,"%02x",regs[k]);
+		put(g,buf);
+		break;
+	   case 'G':
+		if( len != 1 + 2 * GDB_REGS ) {
+			put(g,"E01");
+			break;
+		}
+		for( k = 0 ; k < GDB_REGS ; k++ )
+			put_reg(cpub,k,hex(p[2 * k]) << 4 | hex(p[2 * k + 1]));
+		trace_snapshot(cpub);
+		put(g,"OK");
+		break;
+	   case 'p':
+		if( (k = number(&p)) >= GDB_REGS ) {
+			put(g,"E01");
+			break;
+		}
+		get_regs(cpub,regs);
+		sprintf(buf,"%02x",regs[k]);
+		put(g,buf);
+		break;
+	   case 'P':
+		k = number(&p);
+		if( k >= GDB_REGS || *p++ != '=' ) {
+			put(g,"E01");
+			break;
+		}
+		put_reg(cpub,k,number(&p));
+		trace_snapshot(cpub);
+		put(g,"OK");
+		break;
+
+	   /*
+	    *   Memory: hex (m, M) or binary (x, X)
+	    */
+	   case 'm':
+	   case 'x':
+		if( mem_range(cpub,&p,&addr,&n) != 0 ) {
+			put(g,"E01");
+			break;
+		}
+		k = 0;
+		if( g->pkt[0] == 'm' ) {
+			n = n < GDB_PACKET / 2 ? n : GDB_PACKET / 2 - 1;
+			for( i = 0 ; i < n ; i++ )
+				k += sprintf(buf + k,"%02x",
+					     *mem_word(cpub,addr + i));
+		} else {
+			buf[k++] = 'b';
+			for( i = 0 ; i < n && k < GDB_PACKET - 2 ; i++ ) {
+				c = *mem_word(cpub,addr + i);
+				if( c == '#' || c == '$' || c == '}' || c == '*' ) {
+					buf[k++] = '}';
+					c ^= 0x20;
+				}
+				buf[k++] = c;
+			}
+		}
+		reply(g,buf,k);
+		break;
+	   case 'M':
+	   case 'X':
+		if( mem_range(cpub,&p,&addr,&n) != 0 || *p++ != ':'
+		    || n * (g->pkt[0] == 'M' ? 2 : 1)
+		       > (unsigned long)(len - (p - (char *)g->pkt)) ) {
+			put(g,"E01");
+			break;
+		}
+		if( g->pkt[0] == 'M' )
+			for( i = 0 ; i < n ; i++, p += 2 )
+				buf[i] = hex(p[0]) << 4 | hex(p[1]);
+		else
+			for( i = 0 ; i < n && p < (char *)g->pkt + len ; i++ )
+				buf[i] = *p == '}' ? (p += 2, p[-1] ^ 0x20)
+						   : *p++;
+		write_mem(cpub,addr,(unsigned char *)buf,i);
+		put(g,"OK");
+		break;
+
+	   /*
+	    *   Breakpoints: Z0 and Z1 (there is no difference)
+	    */
+	   case 'Z':
+	   case 'z':
+		t = *p++;
+		if( (t != '0' && t != '1') || *p++ != ',' ) {
+			put(g,"");
+			break;
+		}
+		if( (addr = number(&p)) >= IMEMORY_SIZE ) {
+			put(g,"E01");
+			break;
+		}
+		k = g->pkt[0] == 'Z';
+		g->nbp += k - g->bp[addr];
+		g->bp[addr] = k;
+		put(g,"OK");
+		break;
+
+	   /*
+	    *   Execution
+	    */
+	   case 's':
+	   case 'c':
+		if( *p != '\0' )
+			g->boards[g->hc].pc = number(&p);
+		resume(g,g->hc,g->pkt[0] == 's');
+		break;
+	   case 'v':
+		if( !strcmp(p,"Cont?") )
+			put(g,"vCont;c;C;s;S");
+		else if( !strncmp(p,"Cont;",5) ) {
+			/* the first action alone: its board runs */
+			p += 5;
+			c = *p++;
+			if( c == 'C' || c == 'S' )
+				number(&p);	/* no signals */
+			t = *p == ':' ? thread(p + 1,g->hc) : g->hc;
+			if( t < 0 || strchr("cCsS",c) == NULL )
+				put(g,"E01");
+			else
+				resume(g,t,c == 's' || c == 'S');
+		} else if( !strcmp(p,"Kill") || !strncmp(p,"Kill;",5) ) {
+			put(g,"OK");
+			return 0;
+		} else
+			put(g,"");
+		break;
+
+	   /*
+	    *   Threads: the boards
+	    */
+	   case 'H':
+		c = *p++;
+		t = thread(p,c == 'g' ? g->hg : g->hc);
+		if( t < 0 || (c != 'g' && c != 'c') ) {
+			put(g,"E01");
+			break;
+		}
+		if( c == 'g' )
+			g->hg = t;
+		else
+			g->hc = t;
+		put(g,"OK");
+		break;
+	   case 'T':
+		put(g,thread(p,-1) >= 0 ? "OK" : "E01");
+		break;
+	   case 'q':
+		if( !strncmp(p,"Supported",9) ) {
+			sprintf(buf,"PacketSize=%x;QStartNoAckMode+;"
+				"binary-upload+;qXfer:features:read+",
+				GDB_PACKET);
+			put(g,buf);
+		} else if( !strncmp(p,"Xfer:features:read:",19) )
+			xfer_target(g,p + 19);
+		else if( !strcmp(p,"Attached") )
+			put(g,"1");
+		else if( !strcmp(p,"C") ) {
+			sprintf(buf,"QC%x",g->hg + 1);
+			put(g,buf);
+		} else if( !strcmp(p,"fThreadInfo") )
+			put(g,"m1,2");
+		else if( !strcmp(p,"sThreadInfo") )
+			put(g,"l");
+		else if( !strncmp(p,"ThreadExtraInfo,",16)
+			 && (t = thread(p + 16,-1)) >= 0 ) {
+			sprintf(buf,"%02x%02x%02x%02x",'C','P','U','0' + t);
+			put(g,buf);
+		} else
+			put(g,"");
+		break;
+	   case 'Q':
+		if( !strcmp(p,"StartNoAckMode") ) {
+			put(g,"OK");
+			g->ack = 0;
+		} else
+			put(g,"");
+		break;
+	   case 'D':
+		put(g,"OK");
+		return 0;
+	   case 'k':
+		return 0;
+	   default:
+		put(g,"");
+		break;
+	}
+	return 1;
+}
+
+
+/*=============================================================================
+ *   Resume a Board
+ *
+ *	A run goes on until the board halts, reaches a breakpoint (after
+ *	one instruction at least) or is interrupted; the socket and the
+ *	stop flag are looked at once per block.  With one breakpoint or
+ *	none the superinstructions are used, as c does.
+ *===========================================================================*/
+static void
+resume(Gdb *g, int id, int single)
+{
+#define	GDB_BLOCK	4096
+	Cpub		*cpub = &g->boards[id];
+	Addr		breakp = 0xffff;
+	unsigned long	count = 0, poll = GDB_BLOCK;
+	int		fused, status, n, a, sig = 5;
+
+	for( a = 0 ; g->nbp == 1 && a < IMEMORY_SIZE ; a++ )
+		if( g->bp[a] )
+			breakp = a;
+	fused = !single && g->nbp <= 1 && cpub->fuse != NULL
+		&& cpub->trace == NULL && cpub->dev == NULL;
+	__atomic_store_n(g->stop,0,__ATOMIC_RELAXED);
+	chan_resume(cpub);
+	while( 1 ) {
+		if( fused )
+			status = fuse_step(cpub,breakp,&n);
+		else {
+			status = cpub->trace != NULL ? trace_step(cpub)
+						     : step_full(cpub);
+			n = 1;
+		}
+		if( status == RUN_HALT || single || g->bp[cpub->pc] )
+			break;
+		if( (count += n) >= poll ) {
+			poll += GDB_BLOCK;
+			if( interrupted(g) ) {
+				sig = 2;
+				break;
+			}
+		}
+	}
+	chan_flush(cpub);
+	if( cpub->feed != NULL )
+		feed_publish(cpub);
+
+	snprintf(g->last,sizeof(g->last),"T%02xthread:%x;%s",sig,id + 1,
+		 status == RUN_HALT ? "hlt:;" : "");
+	g->hg = id;
+	put(g,g->last);
+}
+
+
+/*
+ *   An interrupt from the debugger (0x03) or Ctrl-C at the terminal;
+ *   anything else sent during a run is an acknowledgement
+ */
+static int
+interrupted(Gdb *g)
+{
+	struct pollfd	pfd;
+	int		i, n;
+
+	if( __atomic_load_n(g->stop,__ATOMIC_RELAXED) )
+		return 1;
+	if( g->ipos == g->ilen ) {
+		pfd.fd = g->sock;
+		pfd.events = POLLIN;
+		if( poll(&pfd,1,0) <= 0 )
+			return 0;
+		if( (n = read(g->sock,g->in,sizeof(g->in))) <= 0 )
+			return 1;	/* gone: the next read ends */
+		g->ipos = 0;
+		g->ilen = n;
+	}
+	for( i = g->ipos ; i < g->ilen ; i++ )
+		if( g->in[i] == 0x03 ) {
+			g->ipos = i + 1;
+			return 1;
+		}
+	g->ipos = g->ilen;
+	return 0;
+}
+
+
+/*
+ *   A thread id: 1, 2, or -1/0 (all, any: the board cur);
+ *   -1 if there is no such thread
+ */
+static int
+thread(char *p, int cur)
+{
+	long	t;
+
+	if( !strncmp(p,"-1",2) )
+		return cur;
+	t = number(&p);
+	if( t == 0 )
+		return cur;
+	return t <= 2 ? t - 1 : -1;
+}
+
+
+/*=============================================================================
+ *   Registers and Memory
+ *===========================================================================*/
+static void
+get_regs(Cpub *cpub, Uword *regs)
+{
+	regs[0] = cpub->pc;
+	regs[1] = cpub->acc;
+	regs[2] = cpub->ix;
+	regs[3] = PackedFlags(cpub);
+	regs[4] = cpub->ibuf->flag;
+	regs[5] = cpub->ibuf->buf;
+	regs[6] = cpub->obuf.flag;
+	regs[7] = cpub->obuf.buf;
+}
+
+
+static void
+put_reg(Cpub *cpub, int i, Uword v)
+{
+	switch( i ) {
+	   case 0:	cpub->pc = v; break;
+	   case 1:	cpub->acc = v; break;
+	   case 2:	cpub->ix = v; break;
+	   case 3:
+		cpub->cf = v >> 3 & 1;
+		cpub->vf = v >> 2 & 1;
+		cpub->nf = v >> 1 & 1;
+		cpub->zf = v & 1;
+		break;
+	   case 4:	cpub->ibuf->flag = v & 1; break;
+	   case 5:	cpub->ibuf->buf = v; break;
+	   case 6:	cpub->obuf.flag = v & 1; break;
+	   case 7:	cpub->obuf.buf = v; break;
+	}
+}
+
+
+/*
+ *   The registers of get_regs() in their order, for qXfer
+ */
+static const char	target_xml[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+	"<target version=\"1.0\">\n"
+	"  <feature name=\"cpuboard.core\">\n"
+	"    <flags id=\"cpuboard_flags\" size=\"1\">\n"
+	"      <field name=\"zf\" start=\"0\" end=\"0\"/>\n"
+	"      <field name=\"nf\" start=\"1\" end=\"1\"/>\n"
+	"      <field name=\"vf\" start=\"2\" end=\"2\"/>\n"
+	"      <field name=\"cf\" start=\"3\" end=\"3\"/>\n"
+	"    </flags>\n"
+	"    <reg name=\"pc\" bitsize=\"8\" type=\"code_ptr\" regnum=\"0\"/>\n"
+	"    <reg name=\"acc\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"ix\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"flags\" bitsize=\"8\" type=\"cpuboard_flags\"/>\n"
+	"    <reg name=\"if\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"ibuf\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"of\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"obuf\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"  </feature>\n"
+	"</target>\n";
+
+
+/*
+ *   annex:offset,length of qXfer:features:read; the document is sent
+ *   in parts, m while more follows and l with the last
+ */
+static void
+xfer_target(Gdb *g, char *p)
+{
+	char		buf[GDB_PACKET];
+	unsigned long	off, n, size = sizeof(target_xml) - 1;
+
+	if( strncmp(p,"target.xml:",11) ) {
+		put(g,"E00");
+		return;
+	}
+	p += 11;
+	off = number(&p);
+	if( *p++ != ',' || off > size ) {
+		put(g,"E01");
+		return;
+	}
+	n = number(&p);
+	if( n > size - off )
+		n = size - off;
+	if( n > GDB_PACKET - 1 )
+		n = GDB_PACKET - 1;
+	buf[0] = off + n < size ? 'm' : 'l';
+	memcpy(buf + 1,target_xml + off,n);
+	reply(g,buf,n + 1);
+}
+
+
+/*
+ *   addr,length: a read is cut at the end of the memory (the banks
+ *   only with a bank device)
+ */
+static int
+mem_range(Cpub *cpub, char **p, unsigned long *addr, unsigned long *len)
+{
+	unsigned long	end = cpub->xmem != NULL ? XMEMORY_SIZE : MEMORY_SIZE;
+
+	*addr = number(p);
+	if( *(*p)++ != ',' || *addr > end )
+		return -1;
+	*len = number(p);
+	if( *len > end - *addr )
+		*len = end - *addr;
+	return 0;
+}
+
+
+/*
+ *   The text is scanned again for the superinstructions, the state hash
+ *   recomputed and a trace given the new state, as after r
+ */
+static void
+write_mem(Cpub *cpub, unsigned long addr, unsigned char *data, int n)
+{
+	int	i;
+
+	if( addr < IMEMORY_SIZE )		/* copy-on-write */
+		text_private(cpub);
+	for( i = 0 ; i < n ; i++ )
+		*mem_word(cpub,addr + i) = data[i];
+	if( addr < IMEMORY_SIZE )
+		fuse_scan(cpub);
+	state_hash_init(cpub);
+	trace_snapshot(cpub);
+}
+
+
+/*=============================================================================
+ *   Framing: $data#checksum, acknowledged with + (or - to resend)
+ *
+ *	get_packet() returns the length of the data in pkt (terminated
+ *	with a NUL), or -1 when the connection is closed.
+ *===========================================================================*/
+static int
+get_byte(Gdb *g)
+{
+	int	n;
+
+	if( g->ipos == g->ilen ) {
+		while( (n = read(g->sock,g->in,sizeof(g->in))) < 0
+		       && errno == EINTR )
+			;			/* Ctrl-C at the terminal */
+		if( n <= 0 )
+			return -1;
+		g->ipos = 0;
+		g->ilen = n;
+	}
+	return g->in[g->ipos++];
+}
+
+
+static int
+get_packet(Gdb *g)
+{
+	int	c, len, sum, cs;
+
+	while( 1 ) {
+		while( (c = get_byte(g)) != '$' ) {
+			if( c < 0 )
+				return -1;
+			if( c == '-' && g->olen > 0 )
+				send_all(g,g->out,g->olen);
+		}
+		for( len = sum = 0 ; (c = get_byte(g)) != '#' ; sum += c ) {
+			if( c < 0 )
+				return -1;
+			if( len <= GDB_PACKET )
+				g->pkt[len++] = c;
+		}
+		cs = hex(get_byte(g)) << 4;
+		cs |= hex(get_byte(g));
+		if( !g->ack )
+			break;
+		if( len <= GDB_PACKET && cs == (sum & 0xff) ) {
+			send_all(g,(unsigned char *)"+",1);
+			break;
+		}
+		send_all(g,(unsigned char *)"-",1);
+	}
+	if( len > GDB_PACKET )
+		len = GDB_PACKET;		/* too long: cut */
+	g->pkt[len] = '\0';
+	return len;
+}
+
+
+static void
+reply(Gdb *g, char *data, int len)
+{
+	unsigned char	*p = g->out;
+	int		i, sum = 0;
+
+	*p++ = '$';
+	for( i = 0 ; i < len ; i++ )
+		sum += *p++ = (unsigned char)data[i];
+	p += sprintf((char *)p,"#%02x",sum & 0xff);
+	g->olen = p - g->out;
+	send_all(g,g->out,g->olen);
+}
+
+
+static void
+put(Gdb *g, char *s)
+{
+	reply(g,s,strlen(s));
+}
+
+
+static void
+send_all(Gdb *g, unsigned char *buf, int len)
+{
+	ssize_t	n;
+
+	while( len > 0 ) {
+		if( (n = send(g->sock,buf,len,MSG_NOSIGNAL)) <= 0 ) {
+			if( n < 0 && errno == EINTR )
+				continue;
+			break;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+
+static int
+hex(int c)
+{
+	if( c >= '0' && c <= '9' )
+		return c - '0';
+	if( c >= 'a' && c <= 'f' )
+		return c - 'a' + 10;
+	if( c >= 'A' && c <= 'F' )
+		return c - 'A' + 10;
+	return 0;
+}
+
+
+static unsigned long
+number(char **p)
+{
+	unsigned long	v = 0;
+
+	while( isxdigit((unsigned char)**p) )
+		v = v << 4 | hex(*(*p)++);
+	return v;
+}
@@ -0,0 +1,48 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	gdb.h
+ *	Descrioption:	GDB remote serial protocol server (debugger stub)
+ */
+
+/*=============================================================================
+ *   Remote Serial Protocol
+ *
+ *	A debugger (gdb, or a script speaking the protocol) connects on a
+ *	local TCP port or a Unix-domain socket.  The two boards are the
+ *	threads 1 and 2: g/G, p/P, m/M/x/X and Z/z act on the thread of
+ *	Hg, and s, c and vCont resume one board, that of Hc or the one
+ *	named in vCont, as c does at the prompt.  The debugger stops a
+ *	run with an interrupt (0x03).
+ *
+ *	registers:	pc acc ix flags if ibuf of obuf, a byte each
+ *			(flags = cf<<3 | vf<<2 | nf<<1 | zf), described
+ *			by target.xml (qXfer:features:read)
+ *	memory:		the address is as for m and w (000-0ff text,
+ *			100-1ff data, 200- the banks of a bank device)
+ *	breakpoints:	Z0/Z1 at a text address (kept by the server, the
+ *			text is not written), for both boards
+ *	stop replies:	T05 (step, breakpoint) or T02 (interrupt), with
+ *			thread:n; and hlt:; when the board halted
+ *===========================================================================*/
+#define	GDB_PACKET	4096	/* bytes between $ and # */
+#define	GDB_REGS	8
+
+typedef struct gdb {
+	int	sock;
+	Cpub	*boards;		/* [2] */
+	int	hg, hc;			/* boards of Hg and Hc */
+	int	ack;			/* 0 after QStartNoAckMode */
+	int	*stop;			/* set by Ctrl-C at the terminal */
+	int	nbp;
+	Uword	bp[IMEMORY_SIZE];	/* 1: breakpoint */
+	char	last[64];		/* stop reply for ? */
+	int	ipos, ilen;
+	unsigned char	in[GDB_PACKET];
+	unsigned char	pkt[GDB_PACKET + 1];
+	unsigned char	out[GDB_PACKET + 4];	/* $ reply # checksum */
+	int	olen;			/* sent last (again on -) */
+} Gdb;
+
+int	gdb_serve(Cpub *, int, char *, int *);
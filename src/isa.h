@@ -0,0 +1,44 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	isa.h
+ *	Descrioption:	tables generated from the instruction set (isa.def)
+ */
+
+#include	"isa_gen.h"	/* enums generated by isagen */
+
+
+/*=============================================================================
+ *   Decode Table (one entry per instruction word)
+ *===========================================================================*/
+typedef struct decode {
+	Uword	code;		/* enum instruction_code */
+	Uword	a;		/* operand A: 0 ACC, 1 IX */
+	Uword	b;		/* operand B: enum operand_b */
+	Uword	sub;		/* shift mode or branch condition */
+	Uword	len;		/* words */
+	Uword	cls;		/* enum pmu_class */
+	Uword	rd, wr;		/* memory operand read/written (0, 1) */
+	Uword	region;		/* of the memory operand: 0 text, 1 data */
+	Uword	bcc;		/* conditional branch (Bbc) */
+	Uword	poll;		/* BNI/BNO: taken while waiting */
+	Uword	cycles;		/* modeled cycles */
+	char	*name;		/* mnemonic */
+	char	*operands;	/* operand format (see isa.def) */
+} Decode;
+
+extern const Decode	isa_decode[256];
+extern Uword		(*const isa_fetch[8])(Cpub *);
+extern char		*const isa_mode_syntax[8];
+extern char		*const isa_cond_name[16];
+extern char		*const isa_shift_name[4];
+extern char		*const isa_class_name[PMU_CLASSES];
+
+
+/*=============================================================================
+ *   Disassembler and Assembler
+ *===========================================================================*/
+int	disasm(Uword *, Addr, char *);
+int	asm_source(Cpub *, char *);
+int	asm_file(Cpub *, char *);
@@ -0,0 +1,388 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	isagen.c
+ *	Descrioption:	generator of the instruction set tables from isa.def
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<ctype.h>
+
+
+/*=============================================================================
+ *   Instruction Set Description
+ *===========================================================================*/
+#define	NAMESIZE	32
+#define	EXPRSIZE	80
+#define	PMU_CLASS_MAX	8	/* as in cpuboard.h */
+
+char	classes[PMU_CLASS_MAX][NAMESIZE];
+int	nclasses;
+
+struct op {
+	char	name[NAMESIZE];
+	int	code, words, class;
+} ops[64];
+int	nops;
+
+struct mode {
+	char	name[NAMESIZE];
+	int	value;			/* enum value (first line of the name) */
+	int	words;
+	char	syntax[NAMESIZE];
+	char	operand[EXPRSIZE];
+	int	defined;
+} modes[8];
+
+struct shift {
+	char	name[NAMESIZE];
+	int	defined;
+} shifts[4];
+
+char	conds[16][NAMESIZE];
+int	polls[16];
+
+struct insn {
+	char	name[NAMESIZE];
+	char	pattern[9];
+	int	op;
+	char	operands[NAMESIZE];
+} insns[64];
+int	ninsns;
+
+void	error(int, char *);
+int	find_op(char *);
+int	find_class(char *);
+void	read_def(char *);
+int	field(char *, int, int);
+void	emit_header(FILE *);
+void	emit_table(FILE *);
+
+
+void
+error(int line, char *msg)
+{
+	fprintf(stderr,"isa.def:%d: %s\n",line,msg);
+	exit(1);
+}
+
+
+int
+find_op(char *name)
+{
+	int	i;
+
+	for( i = 0 ; i < nops ; i++ )
+		if( !strcmp(ops[i].name,name) )
+			return i;
+	return -1;
+}
+
+
+int
+find_class(char *name)
+{
+	int	i;
+
+	for( i = 0 ; i < nclasses ; i++ )
+		if( !strcmp(classes[i],name) )
+			return i;
+	return -1;
+}
+
+
+/*=============================================================================
+ *   Read the Description
+ *===========================================================================*/
+void
+read_def(char *file)
+{
+	FILE	*fp;
+	char	buf[256], kind[NAMESIZE], name[NAMESIZE], a[NAMESIZE];
+	char	b[NAMESIZE], c[NAMESIZE];
+	int	line = 0, n, v, i;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		exit(1);
+	}
+	while( fgets(buf,sizeof(buf),fp) != NULL ) {
+		line++;
+		buf[strcspn(buf,"\n")] = '\0';
+		if( sscanf(buf,"%31s",kind) != 1 || kind[0] == '#' )
+			continue;
+
+		if( !strcmp(kind,"class") ) {
+			if( sscanf(buf,"%*s %31s",name) != 1
+			    || nclasses == PMU_CLASS_MAX )
+				error(line,"syntax error");
+			strcpy(classes[nclasses++],name);
+		} else
+		if( !strcmp(kind,"op") ) {
+			n = sscanf(buf,"%*s %31s %i %31s %i",name,&v,a,&i);
+			if( n < 3 ) error(line,"syntax error");
+			strcpy(ops[nops].name,name);
+			ops[nops].code = v;
+			if( (ops[nops].class = find_class(a)) < 0 )
+				error(line,"unknown class");
+			ops[nops++].words = (n == 4) ? i : 0;
+		} else
+		if( !strcmp(kind,"mode") ) {
+			char	*expr;
+			n = sscanf(buf,"%*s %i %31s %i %31s %31s",
+							&v,name,&i,a,b);
+			if( n != 5 || v < 0 || v > 7 )
+				error(line,"syntax error");
+			expr = strstr(buf,b);	/* the rest of the line */
+			strcpy(modes[v].name,name);
+			modes[v].words = i;
+			strcpy(modes[v].syntax,a);
+			strncpy(modes[v].operand,expr,EXPRSIZE - 1);
+			modes[v].defined = 1;
+			modes[v].value = v;
+			for( i = 0 ; i < v ; i++ )
+				if( !strcmp(modes[i].name,name) )
+					modes[v].value = modes[i].value;
+		} else
+		if( !strcmp(kind,"shift") ) {
+			if( sscanf(buf,"%*s %i %31s",&v,name) != 2
+			    || v < 0 || v > 3 )
+				error(line,"syntax error");
+			strcpy(shifts[v].name,name);
+			shifts[v].defined = 1;
+		} else
+		if( !strcmp(kind,"cond") ) {
+			n = sscanf(buf,"%*s %i %31s %31s",&v,name,a);
+			if( n < 2 || v < 0 || v > 15
+			    || (n == 3 && strcmp(a,"poll")) )
+				error(line,"syntax error");
+			strcpy(conds[v],name);
+			polls[v] = (n == 3);
+		} else
+		if( !strcmp(kind,"insn") ) {
+			if( sscanf(buf,"%*s %31s %31s %31s %31s",name,a,b,c) != 4
+			    || strlen(a) != 8 )
+				error(line,"syntax error");
+			if( (v = find_op(b)) < 0 )
+				error(line,"unknown op");
+			strcpy(insns[ninsns].name,name);
+			strcpy(insns[ninsns].pattern,a);
+			insns[ninsns].op = v;
+			strcpy(insns[ninsns++].operands,c);
+		} else
+			error(line,"unknown line");
+	}
+	fclose(fp);
+}
+
+
+/*=============================================================================
+ *   Decoding by the Patterns
+ *===========================================================================*/
+int
+matches(struct insn *in, int ir)
+{
+	int	i, bit;
+
+	for( i = 0 ; i < 8 ; i++ ) {
+		bit = (ir >> (7 - i)) & 1;
+		if( (in->pattern[i] == '0' && bit)
+		    || (in->pattern[i] == '1' && !bit) )
+			return 0;
+	}
+	return 1;
+}
+
+
+/*
+ *   The value of the bits marked with the letter (-1: none)
+ */
+int
+field(char *pattern, int letter, int ir)
+{
+	int	i, v = 0, found = 0;
+
+	for( i = 0 ; i < 8 ; i++ ) {
+		if( pattern[i] == letter ) {
+			v = v << 1 | ((ir >> (7 - i)) & 1);
+			found = 1;
+		}
+	}
+	return found ? v : -1;
+}
+
+
+/*=============================================================================
+ *   Output
+ *===========================================================================*/
+void
+emit_header(FILE *fp)
+{
+	int	i, j;
+
+	fprintf(fp,"/* generated by isagen from isa.def: do not edit */\n\n");
+
+	fprintf(fp,"/* 命令コード */\nenum instruction_code {\n");
+	for( i = 0 ; i < nops ; i++ )
+		fprintf(fp,"    %s = 0x%02x,\n",ops[i].name,ops[i].code);
+	fprintf(fp,"};\n\n");
+
+	fprintf(fp,"/* アドレッシングモード */\nenum operand_b {\n");
+	for( i = 0 ; i < 8 ; i++ ) {
+		for( j = 0 ; j < i ; j++ )
+			if( !strcmp(modes[j].name,modes[i].name) )
+				break;
+		if( j == i )
+			fprintf(fp,"    %s = 0x%02x,\n",modes[i].name,i);
+	}
+	fprintf(fp,"};\n\n");
+
+	fprintf(fp,"/* Shift Mode */\nenum shift_mode {\n");
+	for( i = 0 ; i < 4 ; i++ )
+		fprintf(fp,"    %s = 0x%02x,\n",shifts[i].name,i);
+	fprintf(fp,"};\n\n");
+
+	fprintf(fp,"/* 命令クラス (性能カウンタ) */\nenum pmu_class {\n");
+	for( i = 0 ; i < nclasses ; i++ ) {
+		fprintf(fp,"    PMU_");
+		for( j = 0 ; classes[i][j] ; j++ )
+			fputc(toupper((unsigned char)classes[i][j]),fp);
+		fprintf(fp,",\n");
+	}
+	fprintf(fp,"    PMU_CLASSES\n};\n");
+}
+
+
+void
+emit_table(FILE *fp)
+{
+	struct insn	*in;
+	struct mode	*m;
+	char		name[NAMESIZE], *p;
+	int		ir, i, a, b, c, s, sub, len, code, mem, rd, wr;
+
+	fprintf(fp,"/* generated by isagen from isa.def: do not edit */\n\n"
+		"#include\t\"cpuboard.h\"\n#include\t\"isa.h\"\n\n");
+
+	/*
+	 *   Operand B fetch, specialized per addressing mode
+	 */
+	for( i = 0 ; i < 8 ; i++ ) {
+		m = &modes[i];
+		fprintf(fp,"/* %s */\nstatic Uword\nfetch_%d(Cpub *cpub)\n{\n",
+			m->syntax,i);
+		if( !strncmp(m->operand,"reg:",4) ) {
+			fprintf(fp,"\treturn %s;\n}\n\n",m->operand + 4);
+			continue;
+		}
+		fprintf(fp,"\tUword\td;\n\n"
+			"\tcpub->mar = cpub->pc;\n\tcpub->pc++;\n"
+			"\td = TextOf(cpub)[cpub->mar];\n");
+		if( !strncmp(m->operand,"mem:",4) )
+			fprintf(fp,"\treturn MemAt(cpub,%s);\n}\n\n",
+				m->operand + 4);
+		else
+			fprintf(fp,"\treturn d;\n}\n\n");
+	}
+	fprintf(fp,"Uword (*const isa_fetch[8])(Cpub *) = {\n");
+	for( i = 0 ; i < 8 ; i++ )
+		fprintf(fp,"\tfetch_%d,\n",i);
+	fprintf(fp,"};\n\n");
+
+	/*
+	 *   Names
+	 */
+	fprintf(fp,"char *const isa_mode_syntax[8] = {\n");
+	for( i = 0 ; i < 8 ; i++ )
+		fprintf(fp,"\t\"%s\",\n",modes[i].syntax);
+	fprintf(fp,"};\n\nchar *const isa_cond_name[16] = {\n");
+	for( i = 0 ; i < 16 ; i++ )
+		fprintf(fp,"\t\"%s\",\n",conds[i]);
+	fprintf(fp,"};\n\nchar *const isa_class_name[PMU_CLASSES] = {\n");
+	for( i = 0 ; i < nclasses ; i++ )
+		fprintf(fp,"\t\"%s\",\n",classes[i]);
+	fprintf(fp,"};\n\nchar *const isa_shift_name[4] = {\n");
+	for( i = 0 ; i < 4 ; i++ )
+		fprintf(fp,"\t\"%s\",\n",shifts[i].name);
+	fprintf(fp,"};\n\n");
+
+	/*
+	 *   Decode table
+	 */
+	fprintf(fp,"const Decode isa_decode[256] = {\n"
+		"\t/*\tcode\ta  b  sub len cls rd wr rgn bcc poll cyc "
+		"name\toperands */\n");
+	for( ir = 0 ; ir < 256 ; ir++ ) {
+		for( i = 0 ; i < ninsns && !matches(&insns[i],ir) ; i++ )
+			;
+		if( i == ninsns ) {
+			fprintf(stderr,"isa.def: 0x%02x is not decoded\n",ir);
+			exit(1);
+		}
+		in = &insns[i];
+		code = ops[in->op].code;
+		a = field(in->pattern,'A',ir);
+		b = field(in->pattern,'B',ir);
+		c = field(in->pattern,'c',ir);
+		s = field(in->pattern,'s',ir);
+		sub = (c >= 0) ? c : (s >= 0) ? s : 0;
+
+		strcpy(name,in->name);
+		if( c >= 0 ) strcat(name,conds[c]);
+		if( s >= 0 ) strcat(name,shifts[s].name);
+
+		len = 1;
+		if( strchr(in->operands,'d') ) len = 2;
+		if( b >= 0 && modes[b].words == 2 ) len = 2;
+		if( ops[in->op].words ) len = ops[in->op].words;
+
+		mem = b >= 0 && !strncmp(modes[b].operand,"mem:",4);
+		wr = mem && !strcmp(classes[ops[in->op].class],"store");
+		rd = mem && !wr;
+
+		for( p = in->operands ; *p && strchr("cs",*p) ; p++ )
+			;	/* suffixes are part of the name */
+		fprintf(fp,"\t/* %02x */ { 0x%02x, %d, %d, %2d, %d, "
+			"%d, %d, %d, %d, %d, %d, %d, \"%s\",\t\"%s\" },\n",
+			ir,code,a < 0 ? 0 : a,b < 0 ? 0 : modes[b].value,sub,
+			len,ops[in->op].class,rd,wr,b >= 0 ? (modes[b].value
+			& 1) : 0,c >= 0,c >= 0 && polls[c],len + rd + wr + 1,
+			name,*p ? p : "-");
+	}
+	fprintf(fp,"};\n");
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+int
+main(int argc, char *argv[])
+{
+	FILE	*fp;
+
+	if( argc != 4 ) {
+		fprintf(stderr,"usage: %s isa.def isa_gen.h isa_tab.c\n",
+			argv[0]);
+		return 1;
+	}
+	read_def(argv[1]);
+
+	if( (fp = fopen(argv[2],"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",argv[2]);
+		return 1;
+	}
+	emit_header(fp);
+	fclose(fp);
+
+	if( (fp = fopen(argv[3],"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",argv[3]);
+		return 1;
+	}
+	emit_table(fp);
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	loop.c
+ *	Descrioption:	infinite-loop detection by state hashing
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"loop.h"
+#include	"chan.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Board State Snapshot
+ *===========================================================================*/
+void
+snapshot_take(Snapshot *s, Cpub *cpub)
+{
+	s->pc = cpub->pc;
+	s->acc = cpub->acc;
+	s->ix = cpub->ix;
+	s->cf = cpub->cf;
+	s->vf = cpub->vf;
+	s->nf = cpub->nf;
+	s->zf = cpub->zf;
+	s->ibuf = *cpub->ibuf;
+	s->obuf = cpub->obuf;
+	memcpy(s->mem,TextOf(cpub),IMEMORY_SIZE);
+	memcpy(s->mem + IMEMORY_SIZE,cpub->mem + IMEMORY_SIZE,
+	       MEMORY_SIZE - IMEMORY_SIZE);
+}
+
+
+/*
+ *   The input buffer belongs to the other board, so it is restored
+ *   into the given one.  A shared text is left shared if it is the
+ *   same.
+ */
+void
+snapshot_restore(Cpub *cpub, IOBuf *ibuf, Snapshot *s)
+{
+	cpub->pc = s->pc;
+	cpub->acc = s->acc;
+	cpub->ix = s->ix;
+	cpub->cf = s->cf;
+	cpub->vf = s->vf;
+	cpub->nf = s->nf;
+	cpub->zf = s->zf;
+	*ibuf = s->ibuf;
+	cpub->ibuf = ibuf;
+	cpub->obuf = s->obuf;
+	if( memcmp(TextOf(cpub),s->mem,IMEMORY_SIZE) ) {
+		text_private(cpub);
+		memcpy(cpub->mem,s->mem,IMEMORY_SIZE);
+	}
+	memcpy(cpub->mem + IMEMORY_SIZE,s->mem + IMEMORY_SIZE,
+	       MEMORY_SIZE - IMEMORY_SIZE);
+}
+
+
+int
+snapshot_equal(Snapshot *s, Cpub *cpub)
+{
+	return s->pc == cpub->pc && s->acc == cpub->acc && s->ix == cpub->ix
+	    && s->cf == cpub->cf && s->vf == cpub->vf
+	    && s->nf == cpub->nf && s->zf == cpub->zf
+	    && s->ibuf.flag == cpub->ibuf->flag
+	    && s->ibuf.buf == cpub->ibuf->buf
+	    && s->obuf.flag == cpub->obuf.flag
+	    && s->obuf.buf == cpub->obuf.buf
+	    && !memcmp(s->mem + IMEMORY_SIZE,cpub->mem + IMEMORY_SIZE,
+			MEMORY_SIZE - IMEMORY_SIZE)
+	    && !memcmp(s->mem,TextOf(cpub),IMEMORY_SIZE);
+}
+
+
+/*=============================================================================
+ *   Loop Detection
+ *===========================================================================*/
+void
+loop_start(LoopDet *ld, Cpub *cpub)
+{
+	state_hash_init(cpub);
+	snapshot_take(&ld->start,cpub);
+	snapshot_take(&ld->check,cpub);
+	ld->hash = state_hash(cpub);
+	ld->count = ld->mark = 0;
+	ld->power = 1;
+	ld->drain = cpub->chan != NULL && cpub->chan->out >= 0;
+}
+
+
+/*
+ *   Called after every instruction.  Returns 1 when the state has
+ *   repeated, which proves that the board loops forever.
+ */
+int
+loop_check(LoopDet *ld, Cpub *cpub)
+{
+	return loop_check_n(ld,cpub,1);
+}
+
+
+/*
+ *   Called after n instructions (a superinstruction); the period found
+ *   may then be a multiple of the real one, which loop_find() reduces.
+ */
+int
+loop_check_n(LoopDet *ld, Cpub *cpub, int n)
+{
+	unsigned long long	h = state_hash(cpub);
+
+	ld->count += n;
+	if( h == ld->hash && snapshot_equal(&ld->check,cpub) ) {
+		ld->period = ld->count - ld->mark;
+		return 1;
+	}
+	if( ld->count - ld->mark >= ld->power ) {
+		ld->power <<= 1;
+		ld->mark = ld->count;
+		ld->hash = h;
+		snapshot_take(&ld->check,cpub);
+	}
+	return 0;
+}
+
+
+/*
+ *   An instruction of the replay, which has no channels: an output
+ *   channel would have taken the byte
+ */
+static void
+replay_step(LoopDet *ld, Cpub *cpub)
+{
+	step(cpub);
+	if( ld->drain && decrypt_instruction(cpub) == OUT )
+		cpub->obuf.flag = 0;
+}
+
+
+/*
+ *   Find where the loop is entered by replaying from the start state:
+ *   a second board runs one period ahead until both states meet.
+ */
+void
+loop_find(LoopDet *ld)
+{
+	static Cpub	a, b;
+	static IOBuf	ia, ib;
+	Snapshot	*sb;
+	unsigned long long	n, h;
+
+	mem_map(&a);
+	mem_map(&b);
+	a.trace = b.trace = NULL;
+	snapshot_restore(&a,&ia,&ld->start);
+	snapshot_restore(&b,&ib,&ld->start);
+	state_hash_init(&a);
+	state_hash_init(&b);
+	for( n = 0 ; n < ld->period ; n++ )
+		replay_step(ld,&b);
+
+	sb = &ld->check;	/* reused for the state of b */
+	for( ld->entry = 0 ; ; ld->entry++ ) {
+		if( state_hash(&a) == state_hash(&b) ) {
+			snapshot_take(sb,&b);
+			if( snapshot_equal(sb,&a) )
+				break;
+		}
+		replay_step(ld,&a);
+		replay_step(ld,&b);
+	}
+	ld->entry_pc = a.pc;
+
+	/*
+	 *   The shortest period: a is at the entry of the loop
+	 */
+	snapshot_take(sb,&a);
+	h = state_hash(&a);
+	for( n = 1 ; n < ld->period ; n++ ) {
+		replay_step(ld,&a);
+		if( state_hash(&a) == h && snapshot_equal(sb,&a) ) {
+			ld->period = n;
+			break;
+		}
+	}
+}
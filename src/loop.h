@@ -0,0 +1,48 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	loop.h
+ *	Descrioption:	infinite-loop detection by state hashing
+ */
+
+/*=============================================================================
+ *   Board State Snapshot
+ *===========================================================================*/
+typedef struct snapshot {
+	Uword	pc, acc, ix;
+	Bit	cf, vf, nf, zf;
+	IOBuf	ibuf, obuf;
+	Uword	mem[MEMORY_SIZE];
+} Snapshot;
+
+void	snapshot_take(Snapshot *, Cpub *);
+void	snapshot_restore(Cpub *, IOBuf *, Snapshot *);
+int	snapshot_equal(Snapshot *, Cpub *);
+
+
+/*=============================================================================
+ *   Loop Detector (Brent's cycle detection)
+ *
+ *	The state at a checkpoint is kept and compared with every later
+ *	state; the checkpoint moves forward whenever the distance from it
+ *	reaches the next power of two.
+ *===========================================================================*/
+typedef struct loopdet {
+	unsigned long long	count;		/* instructions executed */
+	unsigned long long	mark;		/* count at the checkpoint */
+	unsigned long long	power;
+	unsigned long long	hash;		/* hash at the checkpoint */
+	Snapshot		start;		/* state at loop_start() */
+	Snapshot		check;		/* state at the checkpoint */
+	int			drain;		/* OUT bytes are taken at once */
+
+	unsigned long long	period;		/* results of loop_find() */
+	unsigned long long	entry;
+	Uword			entry_pc;
+} LoopDet;
+
+void	loop_start(LoopDet *, Cpub *);
+int	loop_check(LoopDet *, Cpub *);
+int	loop_check_n(LoopDet *, Cpub *, int);
+void	loop_find(LoopDet *);
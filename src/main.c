@@ -9,19 +9,53 @@
 #include	<stdio.h>
 #include	<stdlib.h>
 #include	<string.h>
+#include	<signal.h>
+#include	<unistd.h>
+#include	<pthread.h>
+#include	<time.h>
+#include	<poll.h>
 #include	"cpuboard.h"
+#include	"trace.h"
+#include	"coverage.h"
+#include	"loop.h"
+#include	"aot.h"
+#include	"isa.h"
+#include	"dev.h"
+#include	"chan.h"
+#include	"fuse.h"
+#include	"feed.h"
+#include	"gdb.h"
+#include	"text.h"
 
 
 void	help(void);
 int	init_cpub(void);
+int	exit_cpub(void);
+int	ext_command(Cpub *, int, int, char *, char *, char *, char *);
+int	exec_step(Cpub *);
+void	cov_command(Cpub *, int, char *, char *);
+void	stats_command(Cpub *, int, char *, char *, char *);
+void	dev_command(Cpub *, int, char *, char *, char *);
+void	io_command(Cpub *, int, char *, char *);
+void	fuse_command(Cpub *, int, char *);
+void	feed_command(Cpub *, int, int, char *);
+void	feed_all(void);
+void	feed_idle(void);
+void	disassemble(Cpub *, int, char *, char *);
 void	cont(Cpub *, char *);
+int	cont_native(Cpub *, Addr);
+void	run_start(Cpub *, char *);
+void	run_wait(void);
+int	run_poll(Cpub *);
+int	run_done(void);
+Cpub	*run_snapshot(Cpub *);
+int	run_busy(char *);
 void	display_regs(Cpub *);
 void	set_reg(Cpub *, char *, char *);
 void	display_mem(Cpub *, char *);
 void	display_mem_line(Cpub *, Addr);
 void	display_mem_all(Cpub *);
 void	set_mem(Cpub *, char *, char *);
-void	read_mem_file(Cpub *, char *);
 void	cmd_syntax_error(void);
 void	unknown_command(void);
 
@@ -30,6 +64,33 @@ void	unknown_command(void);
  *   CPU Board States
  *===========================================================================*/
 Cpub	cpuboard[2];	/* CPU board state */
+Coverage	coverage[2];	/* coverage bitmaps of each board */
+
+
+/*=============================================================================
+ *   Background Execution
+ *
+ *	c runs cont() on a worker thread (and waits for it unless the
+ *	commands come from a terminal).  The worker looks at the flags
+ *	below once per block of RUN_BLOCK instructions: stop (set by the
+ *	stop command or Ctrl-C) and a snapshot request from d and m.
+ *===========================================================================*/
+#define	RUN_BLOCK	4096		/* power of 2 */
+
+struct runner {
+	pthread_t	thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	Cpub		*cpub;		/* board running (NULL: none) */
+	char		addr[16], *straddr;
+	int		stop;		/* atomic */
+	int		want;		/* atomic: snapshot requested */
+	int		done;		/* atomic */
+	Cpub		snap;
+} runner = { .lock = PTHREAD_MUTEX_INITIALIZER,
+	     .cond = PTHREAD_COND_INITIALIZER };
+
+volatile sig_atomic_t	caught;		/* Ctrl-C since the prompt */
 
 
 /*=============================================================================
@@ -42,17 +103,65 @@ help(void)
 					"(one step execution)\n");
 	fprintf(stderr,"   c [addr]\t--- continue(start) execution "
 					"[to address(hex)]\n");
+	fprintf(stderr,"   stop\t\t--- stop the execution (or Ctrl-C)\n");
 	fprintf(stderr,"   d\t\t--- display the contents of registers\n");
 	fprintf(stderr,"   s reg data\t--- set data(hex) to the register\n"
 					"\t\t\treg: pc,acc,ix,cf,vf,nf,zf,"
 					"ibuf,if,obuf,of\n");
 	fprintf(stderr,"   m [addr]\t--- dump memory or display data "
-					"at memory address(hex)\n");
+					"at memory address(hex)\n"
+					"\t\t\t(200-: the banks 1.. of the extended "
+					"memory of a bank device)\n");
 	fprintf(stderr,"   w addr data\t--- write data(hex) "
 					"at memory address(hex)\n");
 	fprintf(stderr,"   r file\t--- load a program into the main memory "
 					"from the file\n");
+	fprintf(stderr,"   asm file\t--- assemble the source file "
+					"into the main memory\n");
+	fprintf(stderr,"   dis [addr [n]]\t--- disassemble n(hex) instructions "
+					"[from address(hex)]\n");
 	fprintf(stderr,"   t\t\t--- toggle current computer(context)\n");
+	fprintf(stderr,"   trace file\t--- record an execution trace "
+					"into the file\n");
+	fprintf(stderr,"   trace off\t--- stop recording the trace\n");
+	fprintf(stderr,"   aot file\t--- run the program translated "
+					"by simaot natively\n");
+	fprintf(stderr,"   aot off\t--- interpret the program\n");
+	fprintf(stderr,"   cov [all]\t--- coverage summary "
+					"[with the missing items]\n");
+	fprintf(stderr,"   cov reset\t--- clear the coverage\n");
+	fprintf(stderr,"   cov save file\t--- save the coverage "
+					"into the file\n");
+	fprintf(stderr,"   cov merge file\t--- merge the coverage "
+					"saved in the file\n");
+	fprintf(stderr,"   stats\t--- display the performance counters\n");
+	fprintf(stderr,"   stats reset\t--- clear the performance counters\n");
+	fprintf(stderr,"   stats range lo hi\t--- count only at "
+					"lo <= pc <= hi(hex)\n");
+	fprintf(stderr,"   stats range all\t--- count at every pc\n");
+	fprintf(stderr,"   dev\t\t--- list the devices\n");
+	fprintf(stderr,"   dev type addr\t--- map a device at the data "
+					"address(hex)\n"
+					"\t\t\ttype: intc,timer,counter,bank\n");
+	fprintf(stderr,"   dev uart addr [file]\t--- map a uart "
+					"[receiving the file]\n");
+	fprintf(stderr,"   dev off\t--- remove the devices\n");
+	fprintf(stderr,"   io\t\t--- display the input/output channels\n");
+	fprintf(stderr,"   io in file\t--- take IN bytes from the file "
+					"(or pipe)\n");
+	fprintf(stderr,"   io out file\t--- write OUT bytes into the file "
+					"(-: stdout)\n");
+	fprintf(stderr,"   io off\t--- close the channels\n");
+	fprintf(stderr,"   fuse\t\t--- display the superinstruction counters\n");
+	fprintf(stderr,"   fuse on|off\t--- execute common instruction "
+					"sequences fused (default: on)\n");
+	fprintf(stderr,"   feed\t\t--- display the change feed\n");
+	fprintf(stderr,"   feed path\t--- publish the state changes "
+					"on the Unix socket\n");
+	fprintf(stderr,"   feed off\t--- close the change feed\n");
+	fprintf(stderr,"   gdb port|path\t--- serve a debugger (GDB remote "
+					"protocol) on the local\n"
+					"\t\t\tTCP port or the Unix socket\n");
 	fprintf(stderr,"   h\t\t--- help (this menu)\n");
 	fprintf(stderr,"   ?\t\t--- help (this menu)\n");
 	fprintf(stderr,"   q\t\t--- quit\n");
@@ -62,11 +171,62 @@ help(void)
 /*=============================================================================
  *   Initialization for the System Organization
  *===========================================================================*/
+static void	interrupt(int);
+
 int
 init_cpub(void)
 {
+	struct sigaction	sa;
+
+	mem_map(&cpuboard[0]);
+	mem_map(&cpuboard[1]);
 	cpuboard[0].ibuf = &(cpuboard[1].obuf);
 	cpuboard[1].ibuf = &(cpuboard[0].obuf);
+	cpuboard[0].cov = &coverage[0];
+	cpuboard[1].cov = &coverage[1];
+	pmu_range(&cpuboard[0],0x00,0xff);
+	pmu_range(&cpuboard[1],0x00,0xff);
+	fuse_on(&cpuboard[0]);
+	fuse_on(&cpuboard[1]);
+
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = interrupt;
+	sa.sa_flags = 0;		/* fgets() at the prompt returns */
+	sigaction(SIGINT,&sa,NULL);
+	return 0;
+}
+
+
+/*
+ *   Ctrl-C: stop the execution at the next block (or a wait for the
+ *   input channel); at an idle prompt, quit
+ */
+static void
+interrupt(int sig)
+{
+	caught = sig;
+	__atomic_store_n(&runner.stop,1,__ATOMIC_RELAXED);
+}
+
+
+/*=============================================================================
+ *   Termination: Flush the Outputs of Both Boards
+ *===========================================================================*/
+int
+exit_cpub(void)
+{
+	if( runner.cpub != NULL ) {
+		__atomic_store_n(&runner.stop,1,__ATOMIC_RELAXED);
+		run_wait();
+	}
+	trace_close(&cpuboard[0]);
+	trace_close(&cpuboard[1]);
+	dev_detach(&cpuboard[0]);
+	dev_detach(&cpuboard[1]);
+	chan_close(&cpuboard[0]);
+	chan_close(&cpuboard[1]);
+	feed_close(&cpuboard[0]);
+	feed_close(&cpuboard[1]);
 	return 0;
 }
 
@@ -79,8 +239,9 @@ main()
 {
 #define	CLSIZE	160
 	char	cmdline[CLSIZE];	/* command line buffer */
-	char	cmd[CLSIZE], arg1[CLSIZE], arg2[CLSIZE], dummy[CLSIZE];
+	char	cmd[CLSIZE], arg1[CLSIZE], arg2[CLSIZE], arg3[CLSIZE];
 	Cpub	*cpub;			/* current CPU board state */
+	Cpub	*view;			/* state displayed by d and m */
 	int	cpub_id;		/* current CPU board ID */
 	int	n;
 
@@ -97,59 +258,95 @@ main()
 		/*
 		 *   Prompt
 		 */
-		fprintf(stderr,"CPU%d,PC=0x%x> ",cpub_id,cpub->pc);
+		if( runner.cpub != NULL && run_done() )
+			run_wait();
+		if( runner.cpub == NULL )
+			runner.stop = 0;	/* for i and the channels */
+		caught = 0;
+		feed_all();
+		if( runner.cpub == cpub )
+			fprintf(stderr,"CPU%d,running> ",cpub_id);
+		else
+			fprintf(stderr,"CPU%d,PC=0x%x> ",cpub_id,cpub->pc);
 		fflush(stderr);
 
 		/*
 		 *   Input a command line
 		 */
-		if( fgets(cmdline,CLSIZE,stdin) == NULL )
-			return 0; /* exiting */
-		if( (n = sscanf(cmdline,"%s%s%s%s",cmd,arg1,arg2,dummy)) <= 0 )
+		feed_idle();
+		if( caught || fgets(cmdline,CLSIZE,stdin) == NULL ) {
+			if( !caught )
+				return exit_cpub(); /* exiting */
+			clearerr(stdin);
+			fputc('\n',stderr);
+			if( runner.cpub == NULL )
+				return exit_cpub(); /* Ctrl-C when idle */
+			continue; /* the execution stops */
+		}
+		if( (n = sscanf(cmdline,"%s%s%s%s",cmd,arg1,arg2,arg3)) <= 0 )
 			continue; /* empty input, so retry */
 
 		/*
 		 *   Interpet a command
 		 */
+		if( !strcmp(cmd,"stop") ) {
+			if( runner.cpub == NULL )
+				fprintf(stderr,"Not running.\n");
+			else
+				__atomic_store_n(&runner.stop,1,
+						 __ATOMIC_RELAXED);
+			continue;
+		}
+		if( run_busy(cmd) )
+			continue;
 		if( cmd[1] != '\0' ) {
-			unknown_command();
+			if( !ext_command(cpub,cpub_id,n,cmd,arg1,arg2,arg3) )
+				unknown_command();
 			continue;
 		}
 		switch( cmd[0] ) {
 		   case 'i':
-			if( step(cpub) == RUN_HALT ) {
+			chan_resume(cpub);
+			if( exec_step(cpub) == RUN_HALT ) {
 				fprintf(stderr,"Program Halted.\n");
 			}
 			break;
 		   case 'c':
 			switch( n ) {
-			   case 1:	cont(cpub,NULL); break;
-			   case 2:	cont(cpub,arg1); break;
+			   case 1:	run_start(cpub,NULL); break;
+			   case 2:	run_start(cpub,arg1); break;
 			   default:	goto syntaxerr;
 			}
 			break;
 		   case 'd':
 			if( n != 1 ) goto syntaxerr;
-			display_regs(cpub);
+			if( (view = run_snapshot(cpub)) != NULL )
+				display_regs(view);
 			break;
 		   case 's':
 			if( n != 3 ) goto syntaxerr;
 			set_reg(cpub,arg1,arg2);
+			trace_snapshot(cpub);
 			break;
 		   case 'm':
+			if( (view = run_snapshot(cpub)) == NULL )
+				break;
 			switch( n ) {
-			   case 1:	display_mem_all(cpub); break;
-			   case 2:	display_mem(cpub,arg1); break;
+			   case 1:	display_mem_all(view); break;
+			   case 2:	display_mem(view,arg1); break;
 			   default:	goto syntaxerr;
 			}
 			break;
 		   case 'w':
 			if( n != 3 ) goto syntaxerr;
 			set_mem(cpub,arg1,arg2);
+			trace_snapshot(cpub);
 			break;
 		   case 'r':
 			if( n != 2 ) goto syntaxerr;
 			read_mem_file(cpub,arg1);
+			fuse_scan(cpub);
+			trace_snapshot(cpub);
 			break;
 		   case 't':
 			cpub_id ^= 1;
@@ -163,7 +360,7 @@ main()
 			if( n != 1 )
 				goto syntaxerr;
 			else
-				return 0; /* exiting */
+				return exit_cpub(); /* exiting */
 			break; /* never reach here */
 		   default:
 			unknown_command();
@@ -177,16 +374,309 @@ main()
 }
 
 
+/*=============================================================================
+ *   Extended (Multi-Character) Commands
+ *
+ *	Returns 0 if the command is unknown.
+ *===========================================================================*/
+int
+ext_command(Cpub *cpub, int cpub_id, int n, char *cmd, char *arg1, char *arg2,
+	    char *arg3)
+{
+	if( !strcmp(cmd,"trace") ) {
+		if( n != 2 )
+			cmd_syntax_error();
+		else if( !strcmp(arg1,"off") )
+			trace_close(cpub);
+		else
+			trace_open(cpub,cpub_id,arg1);
+		return 1;
+	}
+	if( !strcmp(cmd,"aot") ) {
+		if( n != 2 )
+			cmd_syntax_error();
+		else if( !strcmp(arg1,"off") )
+			aot_unload(cpub);
+		else
+			aot_load(cpub,arg1);
+		return 1;
+	}
+	if( !strcmp(cmd,"cov") ) {
+		cov_command(cpub,n,arg1,arg2);
+		return 1;
+	}
+	if( !strcmp(cmd,"stats") ) {
+		stats_command(cpub,n,arg1,arg2,arg3);
+		return 1;
+	}
+	if( !strcmp(cmd,"dev") ) {
+		dev_command(cpub,n,arg1,arg2,arg3);
+		return 1;
+	}
+	if( !strcmp(cmd,"fuse") ) {
+		fuse_command(cpub,n,arg1);
+		return 1;
+	}
+	if( !strcmp(cmd,"feed") ) {
+		feed_command(cpub,cpub_id,n,arg1);
+		return 1;
+	}
+	if( !strcmp(cmd,"gdb") ) {
+		if( n != 2 )
+			cmd_syntax_error();
+		else
+			gdb_serve(cpuboard,cpub_id,arg1,&runner.stop);
+		return 1;
+	}
+	if( !strcmp(cmd,"io") ) {
+		io_command(cpub,n,arg1,arg2);
+		return 1;
+	}
+	if( !strcmp(cmd,"asm") ) {
+		if( n != 2 )
+			cmd_syntax_error();
+		else
+			asm_file(cpub,arg1);
+		fuse_scan(cpub);
+		trace_snapshot(cpub);
+		return 1;
+	}
+	if( !strcmp(cmd,"dis") ) {
+		disassemble(cpub,n,arg1,arg2);
+		return 1;
+	}
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Command: Disassemble
+ *===========================================================================*/
+void
+disassemble(Cpub *cpub, int n, char *straddr, char *strcount)
+{
+	unsigned int	addr = cpub->pc, count = 16;
+	char		buf[32];
+	int		len;
+
+	if( n > 3 || (n >= 2 && sscanf(straddr,"%x",&addr) != 1)
+		  || (n == 3 && sscanf(strcount,"%x",&count) != 1) ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( addr > 0xff ) {
+		fprintf(stderr,"Invalid address (out of range): 0x%x\n",addr);
+		return;
+	}
+
+	while( count-- > 0 ) {
+		len = disasm(TextOf(cpub),addr,buf);
+		if( len == 2 )
+			fprintf(stderr,"    %02x:  %02x %02x\t%s\n",addr,
+				TextOf(cpub)[addr],TextOf(cpub)[(addr + 1) & 0xff],
+				buf);
+		else
+			fprintf(stderr,"    %02x:  %02x\t\t%s\n",addr,
+				TextOf(cpub)[addr],buf);
+		addr = (addr + len) & 0xff;
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Performance Counters
+ *===========================================================================*/
+void
+stats_command(Cpub *cpub, int n, char *arg1, char *arg2, char *arg3)
+{
+	unsigned int	lo, hi;
+
+	if( n == 1 )
+		pmu_report(cpub);
+	else if( n == 2 && !strcmp(arg1,"reset") )
+		pmu_reset(cpub);
+	else if( n == 3 && !strcmp(arg1,"range") && !strcmp(arg2,"all") )
+		pmu_range(cpub,0x00,0xff);
+	else if( n == 4 && !strcmp(arg1,"range")
+		 && sscanf(arg2,"%x",&lo) == 1 && sscanf(arg3,"%x",&hi) == 1
+		 && lo <= hi && hi <= 0xff )
+		pmu_range(cpub,lo,hi);
+	else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Command: Memory-Mapped Devices
+ *===========================================================================*/
+void
+dev_command(Cpub *cpub, int n, char *arg1, char *arg2, char *arg3)
+{
+	unsigned int	addr;
+
+	if( n == 1 )
+		dev_list(cpub);
+	else if( n == 2 && !strcmp(arg1,"off") )
+		dev_detach(cpub);
+	else if( n >= 3 && sscanf(arg2,"%x",&addr) == 1 ) {
+		if( addr >= 0x100 && addr < 0x200 )
+			addr -= 0x100;	/* 1XX or XX: the data region */
+		if( addr > 0xff )
+			fprintf(stderr,"Invalid address (out of range): "
+				"0x%x\n",addr);
+		else if( n == 4 && strcmp(arg1,"uart") )
+			cmd_syntax_error();
+		else
+			dev_attach(cpub,arg1,addr,n == 4 ? arg3 : NULL);
+	} else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Command: Input/Output Channels
+ *===========================================================================*/
+void
+io_command(Cpub *cpub, int n, char *arg1, char *arg2)
+{
+	if( n == 1 )
+		chan_report(cpub);
+	else if( n == 2 && !strcmp(arg1,"off") )
+		chan_close(cpub);
+	else if( n == 3 && !strcmp(arg1,"in") )
+		chan_input(cpub,arg2,&runner.stop);
+	else if( n == 3 && !strcmp(arg1,"out") )
+		chan_output(cpub,arg2);
+	else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Command: Superinstructions
+ *===========================================================================*/
+void
+fuse_command(Cpub *cpub, int n, char *arg1)
+{
+	if( n == 1 )
+		fuse_report(cpub);
+	else if( n == 2 && !strcmp(arg1,"on") )
+		fuse_on(cpub);
+	else if( n == 2 && !strcmp(arg1,"off") )
+		fuse_off(cpub);
+	else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Command: Change Feed
+ *
+ *	Frames go out before each prompt (so after every i), between
+ *	blocks of c, and while a terminal waits for a command (taking new
+ *	clients and resync requests).
+ *===========================================================================*/
+void
+feed_command(Cpub *cpub, int cpub_id, int n, char *arg1)
+{
+	if( n == 1 )
+		feed_report(cpub);
+	else if( n == 2 && !strcmp(arg1,"off") )
+		feed_close(cpub);
+	else if( n == 2 )
+		feed_open(cpub,cpub_id,arg1);
+	else
+		cmd_syntax_error();
+}
+
+
+/*
+ *   The boards not running (a running board publishes by itself)
+ */
+void
+feed_all(void)
+{
+	int	i;
+
+	for( i = 0 ; i < 2 ; i++ )
+		if( cpuboard[i].feed != NULL && runner.cpub != &cpuboard[i] )
+			feed_publish(&cpuboard[i]);
+}
+
+
+/*
+ *   Until a command comes in on a terminal (the lines of a script are
+ *   buffered by stdio, so they are not waited for)
+ */
+void
+feed_idle(void)
+{
+#define	FEED_IDLE	50		/* ms */
+	struct pollfd	pfd;
+
+	if( (cpuboard[0].feed == NULL && cpuboard[1].feed == NULL)
+	    || !isatty(0) )
+		return;
+	pfd.fd = 0;
+	pfd.events = POLLIN;
+	while( poll(&pfd,1,FEED_IDLE) == 0 ) {
+		if( runner.cpub != NULL && run_done() )
+			run_wait();
+		feed_all();
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Coverage
+ *===========================================================================*/
+void
+cov_command(Cpub *cpub, int n, char *arg1, char *arg2)
+{
+	Coverage	saved;
+
+	if( n == 1 || (n == 2 && !strcmp(arg1,"all")) ) {
+		cov_report(cpub->cov,n == 2);
+		if( cpub->native > 0 )
+			fprintf(stderr,"   %llu instructions ran natively "
+				"and are not covered\n",cpub->native);
+	} else if( n == 2 && !strcmp(arg1,"reset") ) {
+		cov_reset(cpub->cov);
+		cpub->native = 0;
+	}
+	else if( n == 3 && !strcmp(arg1,"save") )
+		cov_save(cpub->cov,arg2);
+	else if( n == 3 && !strcmp(arg1,"merge") ) {
+		if( cov_load(&saved,arg2) == 0 )
+			cov_merge(cpub->cov,&saved);
+	} else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Execute an Instruction (with the Enabled Instrumentation)
+ *===========================================================================*/
+int
+exec_step(Cpub *cpub)
+{
+	if( cpub->trace != NULL )
+		return trace_step(cpub);
+	return step_full(cpub);
+}
+
+
 /*=============================================================================
  *   Command: Continue(Start) Execution
  *===========================================================================*/
 void
 cont(Cpub *cpub, char *straddr)
 {
-#define	MAX_EXEC_COUNT	100000
+	static LoopDet	ld;
 	int	addr;
 	Addr	breakp;
-	int	count;
+	unsigned long	count = 0, poll = RUN_BLOCK, base = 0;
+	int	fused, status, n, live = 0;
 
 	/*
 	 *   Check and set a break-point address
@@ -203,22 +693,237 @@ cont(Cpub *cpub, char *straddr)
 	}
 
 	/*
-	 *   Execute a program
+	 *   Run a translated program natively while it is valid; a loop
+	 *   found there is pinned down by interpretation below.
+	 *   Devices and channels are served only by step_full().  The
+	 *   native code counts the performance counters but not the
+	 *   coverage (cov tells how many instructions it missed).
 	 */
-	count = 1;
+	if( cpub->trace == NULL && cpub->dev == NULL && cpub->chan == NULL
+	    && aot_valid(cpub) ) {
+		if( cont_native(cpub,breakp) )
+			return;
+	}
+
+	/*
+	 *   Execute a program until it halts, reaches the break-point
+	 *   or is proved to loop forever (not with devices or a live input
+	 *   channel: their time and position are not part of the state;
+	 *   the detector starts again once the input has run out)
+	 */
+	loop_start(&ld,cpub);
+	fused = cpub->fuse != NULL && cpub->trace == NULL && cpub->dev == NULL;
 	do {
-		if( step(cpub) == RUN_HALT ) {
+		if( fused )
+			status = fuse_step(cpub,breakp,&n);
+		else {
+			status = exec_step(cpub);
+			n = 1;
+		}
+		if( status == RUN_HALT ) {
 			fprintf(stderr,"Program Halted.\n");
 			return;
 		}
-		if( count++ > MAX_EXEC_COUNT ) {
-			fprintf(stderr,"Too Many Instructions are Executed.\n");
+		if( (count += n) >= poll ) {
+			poll += RUN_BLOCK;
+			if( run_poll(cpub) ) {
+				fprintf(stderr,"Stopped at pc=0x%02x.\n",
+					cpub->pc);
+				return;
+			}
+		}
+		if( cpub->dev != NULL )
+			continue;
+		if( ChanLive(cpub) )
+			live = 1;
+		else if( live ) {
+			loop_start(&ld,cpub);
+			base = count;
+			live = 0;
+		} else if( loop_check_n(&ld,cpub,n) ) {
+			loop_find(&ld);
+			fprintf(stderr,"Infinite Loop Detected: period %llu "
+				"instructions, entered at pc=0x%02x "
+				"after %llu instructions.\n",
+				ld.period,ld.entry_pc,ld.entry + base);
 			return;
 		}
 	} while( cpub->pc != breakp );
 }
 
 
+/*
+ *   Native execution in chunks, comparing states only between chunks.
+ *   Returns 0 if the program seems to loop forever or the translation
+ *   became invalid (both are left to the interpreter).
+ */
+int
+cont_native(Cpub *cpub, Addr breakp)
+{
+#define	AOT_CHUNK	(1UL << 20)
+	static LoopDet	ld;
+	unsigned long	count;
+	int		status;
+
+	loop_start(&ld,cpub);
+	while( 1 ) {
+		count = AOT_CHUNK;
+		status = aot_exec(cpub,breakp,&count);
+		if( status == RUN_HALT ) {
+			fprintf(stderr,"Program Halted.\n");
+			return 1;
+		}
+		if( cpub->pc == breakp )
+			return 1;
+		if( run_poll(cpub) ) {
+			fprintf(stderr,"Stopped at pc=0x%02x.\n",cpub->pc);
+			return 1;
+		}
+		state_hash_init(cpub);	/* memory was written natively */
+		if( status == AOT_FALLBACK || loop_check(&ld,cpub) )
+			return 0;
+	}
+}
+
+
+/*=============================================================================
+ *   Worker Thread
+ *===========================================================================*/
+static void *
+run_worker(void *arg)
+{
+	Cpub	*cpub = arg;
+
+	chan_resume(cpub);
+	cont(cpub,runner.straddr);
+	chan_flush(cpub);
+	if( cpub->feed != NULL )
+		feed_publish(cpub);
+	pthread_mutex_lock(&runner.lock);
+	__atomic_store_n(&runner.done,1,__ATOMIC_RELEASE);
+	pthread_cond_broadcast(&runner.cond);
+	pthread_mutex_unlock(&runner.lock);
+	return NULL;
+}
+
+
+void
+run_start(Cpub *cpub, char *straddr)
+{
+	sigset_t	mask, old;
+	int		status;
+
+	runner.straddr = NULL;
+	if( straddr != NULL ) {
+		snprintf(runner.addr,sizeof(runner.addr),"%s",straddr);
+		runner.straddr = runner.addr;
+	}
+	runner.stop = 0;
+	runner.want = 0;
+	runner.done = 0;
+	runner.cpub = cpub;
+
+	/*
+	 *   Ctrl-C goes to this thread, to return from fgets()
+	 */
+	sigemptyset(&mask);
+	sigaddset(&mask,SIGINT);
+	pthread_sigmask(SIG_BLOCK,&mask,&old);
+	status = pthread_create(&runner.thread,NULL,run_worker,cpub);
+	pthread_sigmask(SIG_SETMASK,&old,NULL);
+	if( status != 0 ) {
+		fprintf(stderr,"Unable to start the execution thread\n");
+		runner.cpub = NULL;
+		return;
+	}
+	if( !isatty(0) )
+		run_wait();	/* scripts: one command after another */
+}
+
+
+void
+run_wait(void)
+{
+	pthread_join(runner.thread,NULL);
+	runner.cpub = NULL;
+}
+
+
+/*
+ *   Called by the worker between blocks; returns 1 to stop
+ */
+int
+run_poll(Cpub *cpub)
+{
+	if( __atomic_load_n(&runner.want,__ATOMIC_ACQUIRE) ) {
+		pthread_mutex_lock(&runner.lock);
+		cpub_copy(&runner.snap,cpub);
+		runner.want = 0;
+		pthread_cond_broadcast(&runner.cond);
+		pthread_mutex_unlock(&runner.lock);
+	}
+	if( cpub->feed != NULL )
+		feed_batch(cpub);
+	return __atomic_load_n(&runner.stop,__ATOMIC_RELAXED);
+}
+
+
+/*
+ *   The state to display: a copy taken between blocks if the board runs
+ *   (NULL if the worker does not answer, e.g. waiting for a pipe)
+ */
+Cpub *
+run_snapshot(Cpub *cpub)
+{
+	struct timespec	limit;
+	int		done;
+
+	if( runner.cpub != cpub )
+		return cpub;
+	pthread_mutex_lock(&runner.lock);
+	__atomic_store_n(&runner.want,1,__ATOMIC_RELEASE);
+	clock_gettime(CLOCK_REALTIME,&limit);
+	limit.tv_sec++;
+	while( runner.want && !runner.done )
+		if( pthread_cond_timedwait(&runner.cond,&runner.lock,
+					   &limit) != 0 )
+			break;
+	if( runner.want && !runner.done ) {
+		fprintf(stderr,"Busy. Try again.\n");
+		runner.want = 0;
+		pthread_mutex_unlock(&runner.lock);
+		return NULL;
+	}
+	done = runner.done;
+	pthread_mutex_unlock(&runner.lock);
+	return done ? cpub : &runner.snap;
+}
+
+
+/*
+ *   1 once the worker has finished (it is then joined by run_wait())
+ */
+int
+run_done(void)
+{
+	return __atomic_load_n(&runner.done,__ATOMIC_ACQUIRE);
+}
+
+
+/*
+ *   Commands other than d, m, stop, t, h and q wait for the execution
+ */
+int
+run_busy(char *cmd)
+{
+	if( runner.cpub == NULL || run_done()
+	    || (cmd[1] == '\0' && strchr("dmthq?",cmd[0]) != NULL) )
+		return 0;
+	fprintf(stderr,"Running. Type \'stop\' first.\n");
+	return 1;
+}
+
+
 /*=============================================================================
  *   Command: Display Registers and Flags
  *===========================================================================*/
@@ -305,7 +1010,7 @@ display_mem(Cpub *cpub, char *straddr)
 	unsigned int	addr;
 
 	sscanf(straddr,"%x",&addr);
-	if( addr > MEMORY_SIZE ) {
+	if( mem_word(cpub,addr) == NULL ) {
 		fprintf(stderr,"Invalid address (out of range): 0x%x\n",addr);
 		return;
 	}
@@ -322,7 +1027,7 @@ display_mem_line(Cpub *cpub, Addr addr)
 	for( j = 0 ; j < 2 ; j++ ) {
 		fprintf(stderr,"    | %03x: ",addr);
 		for( i = 0 ; i < 8 ; i++ ) {
-			fprintf(stderr," %02x",(Uword)cpub->mem[addr++]);
+			fprintf(stderr," %02x",*mem_word(cpub,addr++));
 		}
 	}
 	fprintf(stderr,"\n");
@@ -346,9 +1051,10 @@ void
 set_mem(Cpub *cpub, char *straddr, char *strval)
 {
 	unsigned int	addr, value;
+	Uword		*m;
 
 	sscanf(straddr,"%x",&addr);
-	if( addr > MEMORY_SIZE ) {
+	if( (m = mem_word(cpub,addr)) == NULL ) {
 		fprintf(stderr,"Invalid address (out of range): 0x%x\n",addr);
 		return;
 	}
@@ -359,66 +1065,12 @@ set_mem(Cpub *cpub, char *straddr, char *strval)
 		return;
 	}
 
-	cpub->mem[addr] = value;
-	display_mem_line(cpub,(Addr)MemLineBase(addr));
-}
-
-
-/*=============================================================================
- *   Command: Read a Program File
- *===========================================================================*/
-void
-read_mem_file(Cpub *cpub, char *file)
-{
-#define	TOKENSIZE	160
-	FILE		*fp;
-	unsigned int	addr, word;
-	Addr		area;
-	char		token[TOKENSIZE];
-
-	if( (fp = fopen(file,"r")) == NULL ) {
-		fprintf(stderr,"Unable to open %s\n",file);
-		return;
-	}
-
-	addr = 0;	/* default initial address */
-	while( fscanf(fp,"%s",token) == 1 ) {
-		if( token[0] == '.' ) {		/* directive */
-			/*
-			 *   Check the directive type
-			 */
-			if( !strcmp(token+1,"text") ) {
-				area = 0x000;
-			} else
-			if( !strcmp(token+1,"data") ) {
-				area = 0x100;
-			} else {
-				fprintf(stderr,"Unknown directive: %s\n",token);				goto error;
-			}
-
-			/*
-			 *   Change the current address
-			 */
-			fscanf(fp,"%x",&addr);
-			if( addr > 0xff ) {
-				fprintf(stderr,"Invalid address: %s %x\n",
-								token,addr);
-				goto error;
-			}
-			addr |= area;
-		} else {			/* instruction word or data */
-			sscanf(token,"%x",&word);
-			if( word > 0xff ) {
-				fprintf(stderr,"Invalid value at addr=0x%03x: "
-							"0x%x\n",addr,word);
-				goto error;
-			}
-			cpub->mem[addr++] = word;
-		}
+	if( addr < IMEMORY_SIZE ) {		/* copy-on-write */
+		text_private(cpub);
+		m = mem_word(cpub,addr);
 	}
-
-     error:
-	fclose(fp);
+	*m = value;
+	display_mem_line(cpub,(Addr)MemLineBase(addr));
 }
 
 
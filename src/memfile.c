@@ -0,0 +1,108 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	memfile.c
+ *	Descrioption:	program files (.text/.data memory images)
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Read a Program File into the Main Memory
+ *===========================================================================*/
+int
+read_mem_file(Cpub *cpub, char *file)
+{
+#define	TOKENSIZE	160
+	FILE		*fp;
+	unsigned int	addr, word;
+	Addr		area;
+	char		token[TOKENSIZE];
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	text_private(cpub);
+
+	addr = 0;	/* default initial address */
+	while( fscanf(fp,"%s",token) == 1 ) {
+		if( token[0] == '.' ) {		/* directive */
+			/*
+			 *   Check the directive type
+			 */
+			if( !strcmp(token+1,"text") ) {
+				area = 0x000;
+			} else
+			if( !strcmp(token+1,"data") ) {
+				area = 0x100;
+			} else {
+				fprintf(stderr,"Unknown directive: %s\n",token);				goto error;
+			}
+
+			/*
+			 *   Change the current address
+			 */
+			fscanf(fp,"%x",&addr);
+			if( addr > 0xff ) {
+				fprintf(stderr,"Invalid address: %s %x\n",
+								token,addr);
+				goto error;
+			}
+			addr |= area;
+		} else {			/* instruction word or data */
+			sscanf(token,"%x",&word);
+			if( word > 0xff ) {
+				fprintf(stderr,"Invalid value at addr=0x%03x: "
+							"0x%x\n",addr,word);
+				goto error;
+			}
+			cpub->mem[addr++] = word;
+		}
+	}
+	fclose(fp);
+	return 0;
+
+     error:
+	fclose(fp);
+	return -1;
+}
+
+
+/*=============================================================================
+ *   Write the Main Memory into a Program File
+ *
+ *	Only the 16-byte lines holding non-zero words are written, in the
+ *	format read_mem_file() reads back.
+ *===========================================================================*/
+int
+write_mem_file(Cpub *cpub, char *file)
+{
+	FILE	*fp;
+	Addr	addr;
+	int	i, used;
+
+	if( (fp = fopen(file,"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+
+	for( addr = 0 ; addr < MEMORY_SIZE ; addr += 16 ) {
+		for( used = i = 0 ; i < 16 ; i++ )
+			used |= *mem_word(cpub,addr + i);
+		if( !used )
+			continue;
+		fprintf(fp,".%s %02x\n",(addr & 0x100) ? "data" : "text",
+								addr & 0xff);
+		for( i = 0 ; i < 16 ; i++ )
+			fprintf(fp,"%02x%c",*mem_word(cpub,addr + i),
+						(i == 15) ? '\n' : ' ');
+	}
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	pipe.c
+ *	Descrioption:	timing model of a pipelined board (simpipe)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"pipe.h"
+
+
+char	*const pipe_stall_name[STALL_CAUSES] = {
+	"fill", "fetch", "port", "data", "addr", "mem", "st-ld", "taken",
+	"branch"
+};
+char	*const pipe_pred_name[4] = { "stall", "nt", "t", "btfn" };
+
+#define	R_ACC		0x1
+#define	R_IX		0x2
+#define	R_FLAGS		0x4
+
+static Count	port_take(Pipe *, int, Count);
+static int	sources(const Decode *);
+static int	results(const Decode *);
+
+static Uword	reads[256], writes[256];	/* R_ACC | R_IX | R_FLAGS */
+
+
+/*=============================================================================
+ *   Configuration: fwd=0|1,pred=stall|nt|t|btfn,ports=1|2,fetch=1|2,mem=n
+ *===========================================================================*/
+int
+pipe_config(PipeCfg *cfg, char *spec)
+{
+	char	buf[64], *item, *val;
+	int	i;
+
+	cfg->forward = 1;
+	cfg->pred = PRED_NT;
+	cfg->ports = 1;
+	cfg->fetch = 1;
+	cfg->mem = 1;
+	snprintf(buf,sizeof(buf),"%s",spec);
+	for( item = strtok(buf,",") ; item != NULL ; item = strtok(NULL,",") ) {
+		if( (val = strchr(item,'=')) == NULL )
+			goto bad;
+		*val++ = '\0';
+		if( !strcmp(item,"fwd") )
+			cfg->forward = atoi(val) != 0;
+		else if( !strcmp(item,"ports") )
+			cfg->ports = atoi(val);
+		else if( !strcmp(item,"fetch") )
+			cfg->fetch = atoi(val);
+		else if( !strcmp(item,"mem") )
+			cfg->mem = atoi(val);
+		else if( !strcmp(item,"pred") ) {
+			for( i = 0 ; i < 4 && strcmp(val,pipe_pred_name[i]) ; i++ )
+				;
+			if( i == 4 )
+				goto bad;
+			cfg->pred = i;
+		} else
+			goto bad;
+	}
+	if( cfg->ports < 1 || cfg->ports > 2 || cfg->fetch < 1
+	    || cfg->fetch > 2 || cfg->mem < 1 || cfg->mem > PORT_RING / 8 )
+		goto bad;
+	for( i = 0 ; i < 256 ; i++ ) {
+		reads[i] = sources(&isa_decode[i]);
+		writes[i] = results(&isa_decode[i]);
+	}
+	snprintf(cfg->name,sizeof(cfg->name),"fwd=%d,pred=%s,ports=%d,"
+		 "fetch=%d,mem=%d",cfg->forward,pipe_pred_name[cfg->pred],
+		 cfg->ports,cfg->fetch,cfg->mem);
+	return 0;
+   bad:
+	fprintf(stderr,"Invalid pipeline configuration: %s\n",spec);
+	return -1;
+}
+
+
+void
+pipe_reset(Pipe *p)
+{
+	PipeCfg	cfg = p->cfg;
+
+	memset(p,0,sizeof(Pipe));
+	p->cfg = cfg;
+}
+
+
+/*=============================================================================
+ *   One Retired Instruction
+ *
+ *	pc, the instruction word, the word after it and ix before the
+ *	instruction, and whether a Bbc was taken.
+ *
+ *	The cycles the constraints add on the way through the stages are
+ *	kept by cause.  The distance from the previous instruction at EX
+ *	is charged to them nearest to EX first: a delay earlier in the
+ *	pipe is the one hidden when both happen.
+ *===========================================================================*/
+static const int	charge_order[STALL_CAUSES - 1] = {
+	STALL_DATA, STALL_ADDR, STALL_STLD, STALL_MEM, STALL_PORT,
+	STALL_BRANCH, STALL_TAKEN, STALL_FETCH
+};
+
+/* no earlier than V; the cycles it adds are of cause C */
+#define	Later(T,V,C)	do { if( (V) > (T) ) { Add(C,(V) - (T)); (T) = (V); } \
+			} while( 0 )
+#define	Add(C,N)	do { v[C] += (N); if( v[C] > v[dom] ) dom = (C); } \
+			while( 0 )
+
+void
+pipe_insn(Pipe *p, Uword pc, Uword ir, Uword d, Uword ix, Bit taken)
+{
+	const Decode	*dc = &isa_decode[ir];
+	PipeCfg		*cfg = &p->cfg;
+	Count		t[STAGES], v[STALL_CAUSES], end, a, gap, n;
+	int		c[STAGES], src, dst, r, k, pred, port, dom;
+	int		mode = dc->b, text = dc->region == 0;
+	int		mem = (dc->rd || dc->wr) && mode >= ABS_ADDR_TEXT;
+	Addr		addr = 0;
+
+	if( mem ) {
+		addr = mode == ABS_ADDR_TEXT || mode == ABS_ADDR_DATA ? d
+			: mode == IX_MOD_ADDR_TEXT ? d + ix : (Uword)(d + ix);
+		addr |= text ? 0 : 0x100;
+	}
+	port = cfg->ports == 2 && !text;
+	src = reads[ir];
+	dst = writes[ir];
+	memset(v,0,sizeof(v));
+	dom = STALL_NONE;
+
+	/*
+	 *   IF: after the previous fetch or at the redirect, once the
+	 *   previous instruction has left; one port cycle per fetch
+	 */
+	t[ST_IF] = p->next;
+	Later(t[ST_IF],p->redirect,p->redirect_c);
+	Later(t[ST_IF],p->t[ST_ID],p->c[ST_ID]);
+	a = port_take(p,0,t[ST_IF]);
+	Later(t[ST_IF],a,STALL_PORT);
+	c[ST_IF] = dom;
+	end = a + 1;
+
+	/*
+	 *   ID: once the words are in
+	 */
+	for( k = 1 ; k < (dc->len + cfg->fetch - 1) / cfg->fetch ; k++ ) {
+		a = port_take(p,0,end);
+		Add(STALL_FETCH,1);
+		if( a > end )
+			Add(STALL_PORT,a - end);
+		end = a + 1;
+	}
+	t[ST_ID] = end;
+	Later(t[ST_ID],p->t[ST_OF],p->c[ST_OF]);
+	c[ST_ID] = dom;
+	p->next = end;
+	p->redirect = 0;
+
+	/*
+	 *   OF: the address needs ix, registers are read here without
+	 *   forwarding; a memory operand takes the port for mem cycles
+	 */
+	t[ST_OF] = t[ST_ID] + 1;
+	Later(t[ST_OF],p->t[ST_EX],p->c[ST_EX]);
+	if( mem && mode >= IX_MOD_ADDR_TEXT )
+		Later(t[ST_OF],p->ready[1],STALL_ADDR);
+	if( !cfg->forward )
+		for( r = 0 ; r < 3 ; r++ )
+			if( src & (1 << r) )
+				Later(t[ST_OF],p->ready[r],STALL_DATA);
+	end = t[ST_OF] + 1;
+	if( mem && dc->rd ) {
+		if( addr == p->st_addr && p->st_wb >= t[ST_OF] )
+			Later(t[ST_OF],p->st_wb + 1,STALL_STLD);
+		a = port_take(p,port,t[ST_OF]);
+		Later(t[ST_OF],a,STALL_PORT);
+		for( end = a + 1, k = 1 ; k < cfg->mem ; k++ ) {
+			a = port_take(p,port,end);
+			Add(STALL_MEM,1);
+			if( a > end )
+				Add(STALL_PORT,a - end);
+			end = a + 1;
+		}
+	}
+	c[ST_OF] = dom;
+
+	/*
+	 *   EX: after the operand and the previous instruction's write
+	 *   back; results are forwarded from here
+	 */
+	t[ST_EX] = end;
+	Later(t[ST_EX],p->t[ST_WB],p->c[ST_WB]);
+	if( cfg->forward )
+		for( r = 0 ; r < 3 ; r++ )
+			if( src & (1 << r) )
+				Later(t[ST_EX],p->ready[r],STALL_DATA);
+	c[ST_EX] = dom;
+
+	/*
+	 *   WB: ST writes the memory here
+	 */
+	t[ST_WB] = t[ST_EX] + 1;
+	if( mem && dc->wr ) {
+		a = port_take(p,port,t[ST_WB]);
+		Later(t[ST_WB],a,STALL_PORT);
+		p->st_addr = addr;
+		p->st_wb = t[ST_WB];
+	}
+	c[ST_WB] = dom;
+	for( r = 0 ; r < 3 ; r++ )
+		if( dst & (1 << r) )
+			p->ready[r] = cfg->forward ? t[ST_EX] + 1 : t[ST_WB];
+
+	/*
+	 *   Branches: the target is known at ID, the condition at EX
+	 */
+	if( dc->code == JAL || (dc->code == Bbc && dc->sub == 0) ) {
+		p->redirect = t[ST_ID] + 1;
+		p->redirect_c = STALL_TAKEN;
+	} else if( dc->code == JR ) {
+		p->redirect = t[ST_EX] + 1;
+		p->redirect_c = STALL_TAKEN;
+	} else if( dc->code == Bbc ) {
+		p->bcc++;
+		switch( cfg->pred ) {
+		   case PRED_NT:	pred = 0; break;
+		   case PRED_T:		pred = 1; break;
+		   case PRED_BTFN:	pred = d <= pc; break;
+		   default:		pred = -1; break;
+		}
+		if( pred != taken ) {
+			p->redirect = t[ST_EX] + 1;
+			p->redirect_c = STALL_BRANCH;
+			p->miss += pred >= 0;
+		} else if( taken ) {
+			p->redirect = t[ST_ID] + 1;
+			p->redirect_c = STALL_TAKEN;
+		}
+	}
+
+	/*
+	 *   Stall cycles: the distance from the previous instruction at EX
+	 */
+	gap = p->insns > 0 ? t[ST_EX] - p->t[ST_EX] - 1 : 0;
+	for( k = 0 ; gap > 0 && k < STALL_CAUSES - 1 ; k++ ) {
+		n = v[charge_order[k]] < gap ? v[charge_order[k]] : gap;
+		p->stall[charge_order[k]] += n;
+		gap -= n;
+	}
+	p->insns++;
+	memcpy(p->t,t,sizeof(t));
+	memcpy(p->c,c,sizeof(c));
+}
+
+
+/*
+ *   After the last instruction (the cycles before its EX are fill)
+ */
+void
+pipe_end(Pipe *p)
+{
+	int	i;
+
+	p->cycles = p->insns ? p->t[ST_WB] + 1 : 0;
+	p->stall[STALL_NONE] = p->cycles - p->insns;
+	for( i = 1 ; i < STALL_CAUSES ; i++ )
+		p->stall[STALL_NONE] -= p->stall[i];
+}
+
+
+/*=============================================================================
+ *   Memory Ports (0: text or the only one, 1: data)
+ *
+ *	The first cycle from t that is not booked is booked.
+ *===========================================================================*/
+static Count
+port_take(Pipe *p, int port, Count t)
+{
+	Count	*ring = p->port[port];
+
+	while( ring[t % PORT_RING] == t + 1 )
+		t++;
+	ring[t % PORT_RING] = t + 1;
+	return t;
+}
+
+
+/*=============================================================================
+ *   Registers Read and Written (R_ACC, R_IX, R_FLAGS)
+ *===========================================================================*/
+#define	RegA(D)		((D)->a ? R_IX : R_ACC)
+#define	RegB(D)		((D)->b == ACC ? R_ACC : (D)->b == IX ? R_IX : 0)
+
+static int
+sources(const Decode *d)
+{
+	switch( d->code ) {
+	   case LD:	return RegB(d);
+	   case ST:	return RegA(d);
+	   case OUT:
+	   case JR:	return R_ACC;
+	   case ADC:
+	   case SBC:	return RegA(d) | RegB(d) | R_FLAGS;
+	   case ADD: case SUB: case CMP: case AND: case OR: case EOR:
+		return RegA(d) | RegB(d);
+	   case Ssm:	return RegA(d);
+	   case Rsm:	/* RRA and RLA rotate through cf */
+		return RegA(d) | (d->sub <= 1 ? R_FLAGS : 0);
+	   case Bbc:	/* A, and NI and NO of the I/O flags: no ALU flag */
+		return d->sub == 0x0 || d->sub == 0x4 || d->sub == 0xc
+		       ? 0 : R_FLAGS;
+	   default:	return 0;
+	}
+}
+
+
+static int
+results(const Decode *d)
+{
+	switch( d->code ) {
+	   case LD:	return RegA(d);
+	   case IN:
+	   case JAL:	return R_ACC;
+	   case CMP:
+	   case RCF:
+	   case SCF:	return R_FLAGS;
+	   case ADD: case ADC: case SUB: case SBC: case AND: case OR:
+	   case EOR: case Ssm: case Rsm:
+		return RegA(d) | R_FLAGS;
+	   default:	return 0;
+	}
+}
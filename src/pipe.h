@@ -0,0 +1,83 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	pipe.h
+ *	Descrioption:	timing model of a pipelined board (simpipe)
+ */
+
+/*=============================================================================
+ *   Pipeline Model
+ *
+ *	An in-order pipeline of five stages (IF ID OF EX WB) with one
+ *	instruction per stage, driven by the instructions step() retires,
+ *	so the functional behaviour is the board's own.  For each
+ *	instruction the cycle it enters every stage is the latest of its
+ *	constraints: the previous stage, the previous instruction leaving
+ *	the stage, the memory ports, the registers it reads and the fetch
+ *	address.  The cycles each constraint adds are kept by cause and
+ *	give the stall cycles of the instruction at EX.
+ *
+ *	    IF	one cycle per fetch (a word, or two with fetch=2)
+ *	    OF	the memory operand, mem cycles (also [IX+d], (IX+d))
+ *	    EX	the ALU; branches are resolved here
+ *	    WB	registers and flags; ST writes the memory
+ *===========================================================================*/
+#define	ST_IF		0
+#define	ST_ID		1
+#define	ST_OF		2
+#define	ST_EX		3
+#define	ST_WB		4
+#define	STAGES		5
+
+#define	STALL_NONE	0	/* pipeline fill */
+#define	STALL_FETCH	1	/* the second word of an instruction */
+#define	STALL_PORT	2	/* memory port taken by another access */
+#define	STALL_DATA	3	/* acc, ix or flags not written yet */
+#define	STALL_ADDR	4	/* ix of an (IX+d) address not written yet */
+#define	STALL_MEM	5	/* memory operand latency */
+#define	STALL_STLD	6	/* operand stored by an ST in flight */
+#define	STALL_TAKEN	7	/* taken branch or jump (target at ID/EX) */
+#define	STALL_BRANCH	8	/* Bbc mispredicted (or not predicted) */
+#define	STALL_CAUSES	9
+
+#define	PRED_STALL	0	/* no prediction: wait for every branch */
+#define	PRED_NT		1	/* not taken */
+#define	PRED_T		2	/* taken */
+#define	PRED_BTFN	3	/* backward taken, forward not taken */
+
+typedef struct pipecfg {
+	int	forward;	/* 1: results forwarded from EX */
+	int	pred;		/* PRED_* */
+	int	ports;		/* 1: one memory, 2: text and data apart */
+	int	fetch;		/* words fetched per cycle (1, 2) */
+	int	mem;		/* cycles of a memory operand (1..) */
+	char	name[64];
+} PipeCfg;
+
+#define	PORT_RING	256	/* cycles a port is booked ahead */
+
+typedef struct pipe {
+	PipeCfg	cfg;
+	Count	insns, cycles;
+	Count	stall[STALL_CAUSES];
+	Count	bcc, miss;		/* conditional branches */
+
+	Count	t[STAGES];		/* entries of the last instruction */
+	int	c[STAGES];		/* and their main causes */
+	Count	next;			/* next fetch in sequence */
+	Count	redirect;		/* or at a branch target (0: none) */
+	int	redirect_c;
+	Count	ready[3];		/* acc, ix, flags: readable from */
+	Count	st_wb;			/* last ST: write cycle, address */
+	Addr	st_addr;
+	Count	port[2][PORT_RING];	/* booked cycles + 1 */
+} Pipe;
+
+extern char	*const pipe_stall_name[STALL_CAUSES];
+extern char	*const pipe_pred_name[4];
+
+int	pipe_config(PipeCfg *, char *);
+void	pipe_reset(Pipe *);
+void	pipe_insn(Pipe *, Uword, Uword, Uword, Uword, Bit);
+void	pipe_end(Pipe *);
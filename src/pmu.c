@@ -0,0 +1,75 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	pmu.c
+ *	Descrioption:	performance counters (reset, sampling range, report)
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+
+
+/*=============================================================================
+ *   Reset the Counters (the sampling range is kept)
+ *===========================================================================*/
+void
+pmu_reset(Cpub *cpub)
+{
+	Pmu	*p = &cpub->pmu;
+
+	p->insns = p->cycles = p->stalls = 0;
+	memset(p->cls,0,sizeof(p->cls));
+	memset(p->branch,0,sizeof(p->branch));
+	memset(p->reads,0,sizeof(p->reads));
+	memset(p->writes,0,sizeof(p->writes));
+}
+
+
+/*=============================================================================
+ *   Sample Only the Instructions at lo <= pc <= hi
+ *===========================================================================*/
+void
+pmu_range(Cpub *cpub, Uword lo, Uword hi)
+{
+	Pmu	*p = &cpub->pmu;
+	int	pc;
+
+	p->lo = lo;
+	p->hi = hi;
+	for( pc = 0 ; pc < IMEMORY_SIZE ; pc++ )
+		p->off[pc] = !(lo <= pc && pc <= hi);
+}
+
+
+/*=============================================================================
+ *   Report
+ *===========================================================================*/
+#define	Percent(N,T)	((T) ? (N) * 100.0 / (T) : 0.0)
+
+void
+pmu_report(Cpub *cpub)
+{
+	Pmu	*p = &cpub->pmu;
+	Count	bcc = p->branch[0] + p->branch[1];
+	int	i;
+
+	fprintf(stderr,"   instructions\t%12llu\tpc range %02x..%02x\n",
+		p->insns,p->lo,p->hi);
+	for( i = 0 ; i < PMU_CLASSES ; i++ )
+		fprintf(stderr,"     %-8s\t%12llu\t%5.1f%%\n",isa_class_name[i],
+			p->cls[i],Percent(p->cls[i],p->insns));
+	fprintf(stderr,"   branches\t%12llu\ttaken %llu (%.1f%%), "
+		"not taken %llu\n",bcc,p->branch[1],
+		Percent(p->branch[1],bcc),p->branch[0]);
+	fprintf(stderr,"   memory reads\t%12llu\ttext %llu, data %llu\n",
+		p->reads[0] + p->reads[1],p->reads[0],p->reads[1]);
+	fprintf(stderr,"   memory writes\t%12llu\ttext %llu, data %llu\n",
+		p->writes[0] + p->writes[1],p->writes[0],p->writes[1]);
+	fprintf(stderr,"   cycles\t%12llu\tCPI %.2f\n",p->cycles,
+		p->insns ? (double)p->cycles / p->insns : 0.0);
+	fprintf(stderr,"   stall cycles\t%12llu\t%.1f%% (polling NI/NO)\n",
+		p->stalls,Percent(p->stalls,p->cycles));
+}
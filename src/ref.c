@@ -0,0 +1,323 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	ref.c
+ *	Descrioption:	reference model of the instruction set (lockstep check)
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"ref.h"
+
+
+/*=============================================================================
+ *   Specification
+ *
+ *	Instruction words (the manual of the board):
+ *
+ *	0000 0---  NOP			0011 cccc  Bbc d
+ *	0000 1---  HLT			0100 A0ss  Ssm A
+ *	0000 1010  JAL d		0100 A1ss  Rsm A
+ *	0000 1011  JR			0101 ----  (invalid: halts)
+ *	0001 0---  OUT			0110 ABBB  LD A,B
+ *	0001 1---  IN			0111 ABBB  ST A,B (always 2 words)
+ *	0010 0---  RCF			1xxx ABBB  arithmetic and logic
+ *	0010 1---  SCF
+ *
+ *	A: 0 ACC, 1 IX.  B: 000 ACC, 001 IX, 01- d, 100 [d], 101 (d),
+ *	110 [IX+d], 111 (IX+d).  [IX+d] is the 9-bit sum, running on into
+ *	the data region as on the board; (IX+d) stays within the data
+ *	region (8 bits).
+ *===========================================================================*/
+
+/*
+ *   Arithmetic and logic (upper 4 bits 1xxx).  The result is A + B or
+ *   A - B (also - cf for SBC, + cf for ADC); cf and vf are set as the
+ *   board does: the carry and the overflow come from the 8-bit sum of A
+ *   and the operand named in the table, which is not always the one
+ *   of the result.
+ */
+#define	OP_B		0	/* B */
+#define	OP_NEG_B	1	/* -B */
+#define	OP_NEG_B_CF	2	/* -B - cf */
+#define	OP_NONE		3	/* flag cleared (vf) or kept (cf) */
+
+#define	V_OVF		0	/* vf: signed overflow */
+#define	V_OVF_OR_C	1	/* vf: signed overflow or the carry */
+#define	V_CLEAR		2
+
+static const struct alu_spec {
+	char	*name;
+	int	logic;		/* 0 arithmetic, '&', '|', '^' */
+	int	sign;		/* result: A + sign * B */
+	int	with_cf;	/* result: + sign * cf */
+	int	carry;		/* OP_: the cf operand */
+	int	over;		/* OP_: the vf operand */
+	int	vf;		/* V_ */
+	int	write;		/* 1: the result goes to A */
+} alu_spec[8] = {
+	{ "SBC", 0,  -1, 1, OP_NEG_B_CF, OP_B,     V_OVF,      1 },
+	{ "ADC", 0,  +1, 1, OP_B,        OP_B,     V_OVF,      1 },
+	{ "SUB", 0,  -1, 0, OP_NEG_B,    OP_B,     V_OVF,      1 },
+	{ "ADD", 0,  +1, 0, OP_B,        OP_B,     V_OVF_OR_C, 1 },
+	{ "EOR", '^', 0, 0, OP_NONE,     OP_NONE,  V_CLEAR,    1 },
+	{ "OR",  '|', 0, 0, OP_NONE,     OP_NONE,  V_CLEAR,    1 },
+	{ "AND", '&', 0, 0, OP_NONE,     OP_NONE,  V_CLEAR,    1 },
+	{ "CMP", 0,  -1, 0, OP_NONE,     OP_NEG_B, V_OVF,      0 },
+};
+
+/*
+ *   Shifts and rotations (0100 Arss): cf gets the bit shifted out; the
+ *   bit shifted in is below.  vf is set by a left arithmetic shift or
+ *   rotation that changes the sign, and cleared by the others.
+ */
+#define	IN_ZERO		0
+#define	IN_SIGN		1	/* the old bit 7 (SRA) */
+#define	IN_CF		2	/* the old cf */
+#define	IN_OUT		3	/* the bit shifted out */
+
+static const struct shift_spec {
+	char	*name;
+	int	left;
+	int	in;		/* IN_ */
+	int	vf;		/* 1: sign changed */
+} shift_spec[2][4] = {
+	{ { "SRA", 0, IN_SIGN, 0 }, { "SLA", 1, IN_ZERO, 1 },
+	  { "SRL", 0, IN_ZERO, 0 }, { "SLL", 1, IN_ZERO, 0 } },
+	{ { "RRA", 0, IN_CF,   0 }, { "RLA", 1, IN_CF,   1 },
+	  { "RRL", 0, IN_OUT,  0 }, { "RLL", 1, IN_OUT,  0 } },
+};
+
+/*
+ *   Branch conditions (0011 cccc), taken when
+ *
+ *	0 always	4 ibuf flag=0	8 vf=1		c obuf flag=1
+ *	1 zf=0		5 cf=0		9 zf=1		d cf=1
+ *	2 nf=0		6 vf=nf		a nf=1		e vf!=nf
+ *	3 nf=0, zf=0	7 vf=nf, zf=0	b nf=1 or zf=1	f vf!=nf or zf=1
+ */
+
+static int	cond(Ref *, int);
+static void	write_mem(Ref *, int, Uword);
+
+
+/*=============================================================================
+ *   State
+ *===========================================================================*/
+void
+ref_load(Ref *r, Cpub *cpub)
+{
+	int	i;
+
+	r->pc = cpub->pc;
+	r->acc = cpub->acc;
+	r->ix = cpub->ix;
+	r->cf = cpub->cf;
+	r->vf = cpub->vf;
+	r->nf = cpub->nf;
+	r->zf = cpub->zf;
+	r->ibuf = *cpub->ibuf;
+	r->obuf = cpub->obuf;
+	memcpy(r->mem,cpub->mem,MEMORY_SIZE);
+	r->hash = 0;
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		r->hash += (r->mem[i] + 1) * mem_key[i];
+}
+
+
+/*
+ *   1 if the board is in the same state (field by field)
+ */
+int
+ref_same(Ref *r, Cpub *cpub)
+{
+	return RegsWord(r,&r->ibuf) == RegsWord(cpub,cpub->ibuf)
+	       && !memcmp(r->mem,cpub->mem,MEMORY_SIZE);
+}
+
+
+void
+ref_report(Ref *r, Cpub *cpub)
+{
+	int	i, n = 0;
+
+	fprintf(stderr,"            pc acc ix  cf vf nf zf  ibuf  obuf\n");
+	fprintf(stderr,"   board    %02x %02x  %02x  %d  %d  %d  %d  %d:%02x  %d:%02x\n",
+		cpub->pc,cpub->acc,cpub->ix,cpub->cf,cpub->vf,cpub->nf,
+		cpub->zf,cpub->ibuf->flag,cpub->ibuf->buf,
+		cpub->obuf.flag,cpub->obuf.buf);
+	fprintf(stderr,"   ref      %02x %02x  %02x  %d  %d  %d  %d  %d:%02x  %d:%02x\n",
+		r->pc,r->acc,r->ix,r->cf,r->vf,r->nf,r->zf,
+		r->ibuf.flag,r->ibuf.buf,r->obuf.flag,r->obuf.buf);
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		if( r->mem[i] != cpub->mem[i] && n++ < 8 )
+			fprintf(stderr,"   mem[%03x] board %02x, ref %02x\n",
+				i,cpub->mem[i],r->mem[i]);
+	if( n > 8 )
+		fprintf(stderr,"   (%d more memory differences)\n",n - 8);
+}
+
+
+static void
+write_mem(Ref *r, int a, Uword v)
+{
+	r->hash += ((unsigned long long)v - r->mem[a]) * mem_key[a];
+	r->mem[a] = v;
+}
+
+
+/*=============================================================================
+ *   One Instruction
+ *===========================================================================*/
+int
+ref_step(Ref *r)
+{
+	Uword	w = r->mem[r->pc];
+	Uword	d = r->mem[(r->pc + 1) & 0xff];
+	int	mode = w & 7, opa = w >> 3 & 1, addr = -1;
+	Uword	*dst = opa ? &r->ix : &r->acc;
+	Uword	a = *dst, b = 0, res;
+	int	y, v, sum;
+	const struct alu_spec	*s;
+	const struct shift_spec	*h;
+
+	/*
+	 *   Operand B (of LD, ST and the arithmetic and logic words)
+	 */
+	if( w >= 0x60 ) {
+		switch( mode ) {
+		   case 0:	b = r->acc; break;
+		   case 1:	b = r->ix; break;
+		   case 2:
+		   case 3:	b = d; break;
+		   case 4:	addr = d; break;
+		   case 5:	addr = 0x100 | d; break;
+		   case 6:	addr = d + r->ix; break;
+		   case 7:	addr = 0x100 | ((d + r->ix) & 0xff); break;
+		}
+		if( addr >= 0 )
+			b = r->mem[addr];
+	}
+
+	switch( w >> 4 ) {
+	   case 0x0:
+		if( w == 0x0a ) {		/* JAL */
+			r->acc = r->pc + 2;
+			r->pc = d;
+			return RUN_STEP;
+		}
+		if( w == 0x0b ) {		/* JR */
+			r->pc = r->acc;
+			return RUN_STEP;
+		}
+		r->pc++;
+		return (w & 0x08) ? RUN_HALT : RUN_STEP;
+	   case 0x1:
+		if( w & 0x08 ) {		/* IN */
+			r->acc = r->ibuf.buf;
+			r->ibuf.flag = 0;
+		} else {			/* OUT */
+			r->obuf.buf = r->acc;
+			r->obuf.flag = 1;
+		}
+		r->pc++;
+		return RUN_STEP;
+	   case 0x2:
+		r->cf = (w & 0x08) ? 1 : 0;	/* SCF, RCF */
+		r->pc++;
+		return RUN_STEP;
+	   case 0x3:
+		r->pc = cond(r,w & 0x0f) ? d : r->pc + 2;
+		return RUN_STEP;
+	   case 0x4:
+		h = &shift_spec[w >> 2 & 1][w & 3];
+		if( h->left ) {
+			y = a >> 7;
+			res = a << 1;
+			res |= h->in == IN_CF ? r->cf : h->in == IN_OUT ? y : 0;
+		} else {
+			y = a & 1;
+			res = a >> 1;
+			res |= h->in == IN_SIGN ? a & 0x80
+			       : h->in == IN_CF ? r->cf << 7
+			       : h->in == IN_OUT ? y << 7 : 0;
+		}
+		r->cf = y;
+		r->vf = h->vf && (res ^ a) >> 7;
+		r->nf = res >> 7;
+		r->zf = res == 0;
+		*dst = res;
+		r->pc++;
+		return RUN_STEP;
+	   case 0x5:
+		r->pc++;
+		return RUN_HALT;
+	   case 0x6:			/* LD */
+		*dst = b;
+		r->pc += mode < 2 ? 1 : 2;
+		return RUN_STEP;
+	   case 0x7:			/* ST */
+		r->pc += 2;
+		if( addr < 0 )
+			return RUN_HALT;	/* not a memory operand */
+		write_mem(r,addr,a);
+		return RUN_STEP;
+	}
+
+	/*
+	 *   Arithmetic and logic
+	 */
+	s = &alu_spec[w >> 4 & 7];
+	if( s->logic ) {
+		res = s->logic == '&' ? a & b : s->logic == '|' ? a | b : a ^ b;
+	} else {
+		res = a + s->sign * b + (s->with_cf ? s->sign * r->cf : 0);
+		y = s->over == OP_NEG_B ? -b : b;	/* vf operand */
+		sum = (Sword)a + (Sword)(Uword)y;
+		v = sum < -128 || sum > 127;
+		if( s->carry != OP_NONE ) {
+			y = s->carry == OP_B ? b
+			    : s->carry == OP_NEG_B ? -b : -b - r->cf;
+			r->cf = (a + (Uword)y) > 0xff;
+		}
+		if( s->vf == V_OVF_OR_C )
+			v |= r->cf;
+		r->vf = v;
+	}
+	if( s->vf == V_CLEAR )
+		r->vf = 0;
+	r->nf = res >> 7;
+	r->zf = res == 0;
+	if( s->write )
+		*dst = res;
+	r->pc += mode < 2 ? 1 : 2;
+	return RUN_STEP;
+}
+
+
+static int
+cond(Ref *r, int c)
+{
+	int	lt = r->vf != r->nf;
+
+	switch( c ) {
+	   case 0x0:	return 1;
+	   case 0x1:	return !r->zf;
+	   case 0x2:	return !r->nf;
+	   case 0x3:	return !r->nf && !r->zf;
+	   case 0x4:	return !r->ibuf.flag;
+	   case 0x5:	return !r->cf;
+	   case 0x6:	return !lt;
+	   case 0x7:	return !lt && !r->zf;
+	   case 0x8:	return r->vf;
+	   case 0x9:	return r->zf;
+	   case 0xa:	return r->nf;
+	   case 0xb:	return r->nf || r->zf;
+	   case 0xc:	return r->obuf.flag;
+	   case 0xd:	return r->cf;
+	   case 0xe:	return lt;
+	}
+	return lt || r->zf;		/* 0xf */
+}
@@ -0,0 +1,41 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	ref.h
+ *	Descrioption:	reference model of the instruction set (lockstep check)
+ */
+
+/*=============================================================================
+ *   Reference Model
+ *
+ *	A second implementation of the instruction set, written from the
+ *	specification tables in ref.c alone: it decodes the bits itself
+ *	and uses neither isa_decode[], the ALU table nor the formulas of
+ *	alu.c, so a change of the engine cannot change it as well.  It
+ *	keeps the memory part of the state hash like Cpub::hash (with the
+ *	same mem_key[]), so two states are compared by the hash and one
+ *	packed register word.
+ *===========================================================================*/
+typedef struct ref {
+	Uword	pc, acc, ix;
+	Bit	cf, vf, nf, zf;
+	IOBuf	ibuf, obuf;
+	unsigned long long	hash;
+	Uword	mem[MEMORY_SIZE];
+} Ref;
+
+/* pc, acc, ix, flags and the buffers of a Cpub or a Ref in one word */
+#define	RegsWord(C,IB)	((unsigned long long)(C)->pc \
+			 | (unsigned long long)(C)->acc << 8 \
+			 | (unsigned long long)(C)->ix << 16 \
+			 | (unsigned long long)PackedFlags(C) << 24 \
+			 | (unsigned long long)(IB)->flag << 28 \
+			 | (unsigned long long)(IB)->buf << 32 \
+			 | (unsigned long long)(C)->obuf.flag << 40 \
+			 | (unsigned long long)(C)->obuf.buf << 48)
+
+void	ref_load(Ref *, Cpub *);
+int	ref_step(Ref *);
+int	ref_same(Ref *, Cpub *);
+void	ref_report(Ref *, Cpub *);
@@ -0,0 +1,99 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	sample.c
+ *	Descrioption:	sampled simulation (schedule of windows, estimates)
+ */
+
+#include	<stdio.h>
+#include	<math.h>
+#include	"sample.h"
+
+
+/*=============================================================================
+ *   Schedule
+ *===========================================================================*/
+int
+sample_init(Sampler *s, long period, long window, long warm, int random,
+	    unsigned long long seed)
+{
+	if( window <= 0 || warm < 0 || period < window + warm ) {
+		fprintf(stderr,"Invalid sampling: period %ld, window %ld, "
+			"warm-up %ld\n",period,window,warm);
+		return -1;
+	}
+	s->period = period;
+	s->window = window;
+	s->warm = warm;
+	s->random = random;
+	s->seed = seed ? seed : 1;
+	s->rest = 0;
+	s->windows = 0;
+	return 0;
+}
+
+
+/*
+ *   Instructions to fast-forward before the next warm-up (the rest of
+ *   the last period and the offset in the next one)
+ */
+long
+sample_skip(Sampler *s)
+{
+	long	room = s->period - s->window - s->warm, at = 0, skip;
+
+	if( s->random && room > 0 ) {
+		s->seed ^= s->seed << 13;	/* xorshift64 */
+		s->seed ^= s->seed >> 7;
+		s->seed ^= s->seed << 17;
+		at = s->seed % (room + 1);
+	}
+	skip = s->rest + at;
+	s->rest = room - at;
+	return skip;
+}
+
+
+/*=============================================================================
+ *   Estimates
+ *===========================================================================*/
+void
+est_add(Estimate *e, double x)
+{
+	e->n++;
+	e->sum += x;
+	e->sumsq += x * x;
+}
+
+
+double
+est_mean(Estimate *e)
+{
+	return e->n ? e->sum / e->n : 0.0;
+}
+
+
+/*
+ *   Half the width of the 95% confidence interval of the mean
+ *   (-1 with fewer than two windows)
+ */
+double
+est_half(Estimate *e)
+{
+	static const double	t95[30] = {		/* by n - 1 */
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+		2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+		2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+		2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+	double	mean, var;
+
+	if( e->n < 2 )
+		return -1.0;
+	mean = e->sum / e->n;
+	var = (e->sumsq - e->n * mean * mean) / (e->n - 1);
+	if( var < 0 )
+		var = 0;		/* rounding */
+	return (e->n - 1 <= 30 ? t95[e->n - 2] : 1.960) * sqrt(var / e->n);
+}
@@ -0,0 +1,45 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	sample.h
+ *	Descrioption:	sampled simulation (schedule of windows, estimates)
+ */
+
+/*=============================================================================
+ *   Sampling Schedule
+ *
+ *	The run is cut into periods of period instructions.  In each
+ *	period a window of warm + window instructions is simulated in
+ *	detail and the rest is fast-forwarded with step() alone.  The
+ *	window starts at the beginning of the period, or at a random
+ *	offset in it (random = 1) so that a program whose loops have the
+ *	length of the period is not always seen in the same phase.  The
+ *	warm-up instructions refill the model's state and are not measured.
+ *===========================================================================*/
+typedef struct sampler {
+	long	period, window, warm;
+	int	random;
+	unsigned long long	seed;
+	long	rest;			/* of the period after the window */
+	long	windows;		/* measured */
+} Sampler;
+
+int	sample_init(Sampler *, long, long, long, int, unsigned long long);
+long	sample_skip(Sampler *);
+
+
+/*=============================================================================
+ *   Estimate of a Mean over the Windows
+ *
+ *	The confidence interval takes Student's t for the windows seen.
+ *===========================================================================*/
+typedef struct estimate {
+	long	n;
+	double	sum, sumsq;
+} Estimate;
+
+void	est_add(Estimate *, double);
+double	est_mean(Estimate *);
+double	est_half(Estimate *);		/* 95% interval: mean +- half */
+					/* (-1: fewer than 2 windows) */
@@ -0,0 +1,467 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simaot.c
+ *	Descrioption:	ahead-of-time translator of programs into C
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+
+
+Cpub	cpub;
+Uword	reach[IMEMORY_SIZE];	/* reachable from the entry points */
+Uword	label[IMEMORY_SIZE];	/* jumped to by the translated code */
+int	dispatch;		/* 1: the dispatch switch is used */
+
+void	find_reachable(void);
+int	stores_into_text(Uword);
+void	find_labels(void);
+void	emit_prologue(void);
+void	emit_insn(Uword);
+void	emit_count(Uword, Uword);
+void	emit_epilogue(void);
+char	*operand_b(Uword, Uword);
+char	*dest(Uword);
+
+
+/*=============================================================================
+ *   Instruction Shape
+ *===========================================================================*/
+int
+stores_into_text(Uword ir)
+{
+	Uword	b;
+
+	cpub.ir = ir;
+	b = decrypt_operandB(&cpub);
+	return decrypt_instruction(&cpub) == ST
+		&& (b == ABS_ADDR_TEXT || b == IX_MOD_ADDR_TEXT);
+}
+
+
+/*=============================================================================
+ *   Reachable Instructions
+ *
+ *	Entry points are address 0 and the return addresses of JAL (the
+ *	usual targets of JR).  Other JR targets are interpreted.
+ *===========================================================================*/
+void
+find_reachable(void)
+{
+	Uword	work[IMEMORY_SIZE * 2];
+	int	n = 0;
+	Uword	a, ir, opr, next, code;
+
+#define	Visit(A)	do { if( !reach[(Uword)(A)] ) { \
+				reach[(Uword)(A)] = 1; \
+				work[n++] = (A); } } while(0)
+
+	Visit(0x00);
+	while( n > 0 ) {
+		a = work[--n];
+		ir = cpub.mem[a];
+		opr = cpub.mem[(Uword)(a + 1)];
+		next = a + isa_decode[ir].len;
+		cpub.ir = ir;
+		code = decrypt_instruction(&cpub);
+		switch( code ) {
+		   case HLT:		/* HLT */
+		   case JR:		/* JR */
+			break;
+		   case Bbc:		/* Bbc */
+			Visit(opr);
+			if( isa_decode[ir].sub != 0x00 )	/* not BA */
+				Visit(next);
+			break;
+		   case JAL:		/* JAL */
+			Visit(opr);
+			Visit(next);
+			break;
+		   case ST:		/* ST */
+			if( decrypt_operandB(&cpub) >= ABS_ADDR_TEXT )
+				Visit(next);
+			break;
+		   case NOP: case OUT: case IN: case RCF: case SCF:
+		   case Ssm: case Rsm: case LD: case SBC: case ADC:
+		   case SUB: case ADD: case EOR: case OR: case AND:
+		   case CMP:
+			Visit(next);
+			break;
+		   default:		/* invalid: halts */
+			break;
+		}
+	}
+}
+
+
+/*
+ *   The labels the translated code jumps to: the branch targets, the
+ *   next instruction of one running on, and all of them if anything
+ *   goes to the dispatch switch (a JR, or running on into an address
+ *   that was not translated).  The others would be unused.
+ */
+void
+find_labels(void)
+{
+	int	a;
+	Uword	ir, opr, next;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !reach[a] )
+			continue;
+		ir = cpub.mem[a];
+		opr = cpub.mem[(Uword)(a + 1)];
+		next = a + isa_decode[ir].len;
+		cpub.ir = ir;
+		switch( decrypt_instruction(&cpub) ) {
+		   case JR:		/* JR */
+			dispatch = 1;
+			continue;
+		   case Bbc:		/* Bbc */
+			label[opr] = 1;
+			if( isa_decode[ir].sub == 0x00 )	/* BA */
+				continue;
+			break;
+		   case JAL:		/* JAL */
+			label[opr] = 1;
+			continue;
+		   case ST:		/* ST */
+			if( decrypt_operandB(&cpub) < ABS_ADDR_TEXT )
+				continue;
+			break;
+		   case NOP: case OUT: case IN: case RCF: case SCF:
+		   case Ssm: case Rsm: case LD: case SBC: case ADC:
+		   case SUB: case ADD: case EOR: case OR: case AND:
+		   case CMP:
+			break;
+		   default:		/* HLT, invalid */
+			continue;
+		}
+		if( reach[next] )
+			label[next] = 1;
+		else
+			dispatch = 1;
+	}
+	if( dispatch )
+		memcpy(label,reach,sizeof(label));
+}
+
+
+/*=============================================================================
+ *   Code Generation
+ *
+ *	The code mirrors the reference formulas (alu.c) and cpuboard.c
+ *	expression by expression, so both give the same results.  A
+ *	translated program never runs with devices, so the data region is
+ *	not banked (MemAt() is mem[]); the text is read through the text
+ *	pages, which may be shared.  Each instruction counts itself into
+ *	the performance counters as PmuCount() does, with the constants of
+ *	its decode entry; the coverage is left to the interpreter.
+ *===========================================================================*/
+char *
+operand_b(Uword ir, Uword opr)
+{
+	static char	buf[64];
+
+	cpub.ir = ir;
+	switch( decrypt_operandB(&cpub) ) {
+	   case ACC:	return "acc";
+	   case IX:	return "ix";
+	   case IMMEDIATE_ADDR:	sprintf(buf,"0x%02x",opr); break;
+	   case ABS_ADDR_TEXT:	sprintf(buf,"TextOf(cpub)[0x%02x]",opr); break;
+	   case ABS_ADDR_DATA:	sprintf(buf,"cpub->mem[0x100 + 0x%02x]",opr); break;
+	   case IX_MOD_ADDR_TEXT:	sprintf(buf,"MemAt(cpub,0x%02x + ix)",opr); break;
+	   case IX_MOD_ADDR_DATA:	sprintf(buf,"cpub->mem[0x100 + (Uword)(0x%02x + ix)]",opr); break;
+	}
+	return buf;
+}
+
+
+char *
+dest(Uword ir)
+{
+	cpub.ir = ir;
+	return decrypt_operandA(&cpub) ? "ix" : "acc";
+}
+
+
+void
+emit_prologue(void)
+{
+	int	a;
+
+	printf("/* generated by simaot: do not edit */\n"
+		"#include <stdio.h>\n"
+		"#include \"cpuboard.h\"\n"
+		"#include \"aot.h\"\n\n");
+
+	printf("Uword aot_text[%d] = {",IMEMORY_SIZE);
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		printf("%s0x%02x,",(a % 12) ? " " : "\n\t",cpub.mem[a]);
+	printf("\n};\n\n");
+
+	printf("static inline Bit cy(Uword a, Uword b) {\n"
+		"\tUword ma = a >> 7, mb = b >> 7;\n"
+		"\tUword c = ((a & 0x7f) + (b & 0x7f)) >> 7;\n"
+		"\treturn ((ma & mb) | (ma & c) | (mb & c)) ? 1 : 0;\n}\n\n"
+		"static inline Bit ov(Uword a, Uword b) {\n"
+		"\tUword ma = a >> 7, mb = b >> 7;\n"
+		"\tUword c = ((a & 0x7f) + (b & 0x7f)) >> 7;\n"
+		"\treturn ((ma & mb & !c) | (!ma & !mb & c)) ? 1 : 0;\n}\n\n"
+		"#define NZ(R) (nf = ((R) & 0x80) ? 1 : 0, "
+		"zf = ((R) & 0xff) ? 0 : 1)\n\n");
+
+	printf("int\naot_run(Cpub *cpub, int bp, unsigned long *count)\n{\n"
+		"\tUword pc = cpub->pc, acc = cpub->acc, ix = cpub->ix;\n"
+		"\tBit cf = cpub->cf, vf = cpub->vf, "
+		"nf = cpub->nf, zf = cpub->zf;\n"
+		"\tUword a, b, r, ir = cpub->ir, mar = cpub->mar;\n"
+		"\tPmu *pmu = &cpub->pmu;\n"
+		"\tCount e;\n"
+		"\tBit t;\n"
+		"\tunsigned long n = *count;\n"
+		"\tint status = RUN_STEP;\n\n"
+		"\t(void)a; (void)b; (void)r; (void)t;\t/* maybe unused */\n\n");
+
+	printf("\tswitch( pc ) {\n");
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( reach[a] )
+			printf("\t   case 0x%02x: goto B_%02x;\n",a,a);
+	printf("\t   default: status = AOT_FALLBACK; goto suspend;\n\t}\n");
+	if( !dispatch ) {		/* the label would be unused */
+		printf("\n");
+		return;
+	}
+	printf("    dispatch:\n\tswitch( pc ) {\n");
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( reach[a] )
+			printf("\t   case 0x%02x: goto L_%02x;\n",a,a);
+	printf("\t}\n"
+		"\tif( pc == bp || n == 0 ) goto suspend;\n"
+		"\tstatus = AOT_FALLBACK;\n\tgoto suspend;\n\n");
+}
+
+
+void
+emit_insn(Uword a)
+{
+	Uword	ir = cpub.mem[a];
+	Uword	opr = cpub.mem[(Uword)(a + 1)];
+	Uword	next = a + isa_decode[ir].len;
+	Uword	code, b;
+	char	*d = dest(ir), *src = operand_b(ir,opr);
+	static char	*cond[16] = {
+		"1", "zf == 0", "nf == 0", "(nf | zf) == 0",
+		"cpub->ibuf->flag == 0", "cf == 0", "(vf ^ nf) == 0",
+		"((vf ^ nf) | (zf)) == 0",
+		"vf == 1", "zf == 1", "nf == 1", "(nf | zf) == 1",
+		"cpub->obuf.flag == 1", "cf == 1", "(vf ^ nf) == 1",
+		"((vf ^ nf) | (zf)) == 1"
+	};
+
+	if( label[a] )
+		printf("    L_%02x:\tif( bp == 0x%02x || n == 0 ) "
+			"{ pc = 0x%02x; goto suspend; }\n",a,a,a);
+	printf("    B_%02x:\tn--; ir = 0x%02x; mar = 0x%02x;\t/* %s */\n",
+		a,ir,isa_decode[ir].len == 2 ? (Uword)(a + 1) : a,mnemonic(ir));
+
+	emit_count(a,ir);
+
+	cpub.ir = ir;
+	code = decrypt_instruction(&cpub);
+	switch( code ) {
+	   case NOP:	/* NOP */
+		break;
+	   case HLT:	/* HLT */
+		printf("\tpc = 0x%02x; status = RUN_HALT; goto suspend;\n",
+			(Uword)(a + 1));
+		return;
+	   case OUT:	/* OUT */
+		printf("\tcpub->obuf.buf = acc; cpub->obuf.flag = 1;\n");
+		break;
+	   case IN:	/* IN */
+		printf("\tacc = cpub->ibuf->buf; cpub->ibuf->flag = 0;\n");
+		break;
+	   case RCF:	printf("\tcf = 0;\n"); break;	/* RCF */
+	   case SCF:	printf("\tcf = 1;\n"); break;	/* SCF */
+	   case LD:	/* LD */
+		printf("\t%s = %s;\n",d,src);
+		break;
+	   case ST:	/* ST */
+		b = decrypt_operandB(&cpub);
+		if( b < ABS_ADDR_TEXT ) {
+			printf("\tfprintf(stderr,\"error: %s is not defined "
+				"in the ST instruction.\\n\");\n",
+				b == ACC ? "ACC" : b == IX ? "IX"
+							: "Immediate Address");
+			printf("\tpc = 0x%02x; status = RUN_HALT; "
+				"goto suspend;\n",next);
+			return;
+		}
+		printf("\t%s = %s;\n",src,decrypt_operandA(&cpub) ? "ix"
+								   : "acc");
+		break;
+	   case ADD:	/* ADD */
+		printf("\ta = %s; b = %s; r = a + b;\n"
+			"\tcf = cy(a, b); vf = (cf | ov(a, b)); NZ(r); "
+			"%s = r;\n",d,src,d);
+		break;
+	   case ADC:	/* ADC */
+		printf("\ta = %s; b = %s; r = a + b + cf;\n"
+			"\tcf = cy(a, b); vf = ov(a, b); NZ(r); %s = r;\n",
+			d,src,d);
+		break;
+	   case SUB:	/* SUB */
+		printf("\ta = %s; b = %s; r = a + (~b + 0x01);\n"
+			"\tcf = cy(a, ((~b) + 0x01)); vf = ov(a, b); NZ(r); "
+			"%s = r;\n",d,src,d);
+		break;
+	   case SBC:	/* SBC */
+		printf("\ta = %s; b = %s; "
+			"r = a + (~b + 0x01) + (~cf + 0x01);\n"
+			"\tcf = cy(a, ((~b + 0x01) + (~cf + 0x01))); "
+			"vf = ov(a, b); NZ(r); %s = r;\n",d,src,d);
+		break;
+	   case CMP:	/* CMP */
+		printf("\ta = %s; b = %s; r = a + (~b + 1);\n"
+			"\tvf = ov(a, (~b + 1)); NZ(r);\n",d,src);
+		break;
+	   case AND:
+	   case OR:
+	   case EOR:	/* AND, OR, EOR */
+		printf("\tr = %s %s %s; vf = 0; NZ(r); %s = r;\n",d,
+			code == AND ? "&" : code == OR ? "|" : "^",src,d);
+		break;
+	   case Ssm:	/* Ssm */
+		printf("\ta = %s;\n",d);
+		switch( isa_decode[ir].sub ) {
+		   case RA: printf("\tr = (a >> 1) | (a & 0x80); "
+				"cf = a & 0x01; vf = 0;\n"); break;
+		   case LA: printf("\tr = a << 1; cf = (a & 0x80) >> 7; "
+				"vf = ((a ^ r) & 0x80) >> 7;\n"); break;
+		   case RL: printf("\tr = a >> 1; cf = a & 0x01; "
+				"vf = 0;\n"); break;
+		   case LL: printf("\tr = a << 1; cf = (a & 0x80) >> 7; "
+				"vf = 0;\n"); break;
+		}
+		printf("\tNZ(r); %s = r;\n",d);
+		break;
+	   case Rsm:	/* Rsm */
+		printf("\ta = %s;\n",d);
+		switch( isa_decode[ir].sub ) {
+		   case RA: printf("\tr = a >> 1; r = r | (cf << 7); "
+				"cf = a & 0x01; vf = 0;\n"); break;
+		   case LA: printf("\tr = a << 1; r = r | cf; "
+				"cf = (a & 0x80) >> 7; "
+				"vf = ((a ^ r) & 0x80) >> 7;\n");
+				break;
+		   case RL: printf("\tr = (a >> 1) | ((a & 0x01) << 7); "
+				"cf = a & 0x01; vf = 0;\n"); break;
+		   case LL: printf("\tr = (a << 1) | ((a & 0x80) >> 7); "
+				"cf = (a & 0x80) >> 7; vf = 0;\n"); break;
+		}
+		printf("\tNZ(r); %s = r;\n",d);
+		break;
+	   case Bbc:	/* Bbc */
+		printf("\tt = %s; pmu->branch[t] += e;\n",
+			cond[isa_decode[ir].sub]);
+		if( isa_decode[ir].poll )
+			printf("\tpmu->stalls += (e & t) * %d;\n",
+				isa_decode[ir].cycles);
+		printf("\tif( t ) goto L_%02x;\n",opr);
+		if( isa_decode[ir].sub == 0x00 )
+			return;
+		break;
+	   case JAL:	/* JAL */
+		printf("\tacc = 0x%02x; goto L_%02x;\n",next,opr);
+		return;
+	   case JR:	/* JR */
+		printf("\tpc = acc; goto dispatch;\n");
+		return;
+	   default:	/* invalid instruction */
+		printf("\tpc = 0x%02x; status = RUN_HALT; goto suspend;\n",
+			(Uword)(a + 1));
+		return;
+	}
+
+	if( reach[next] )
+		printf("\tgoto L_%02x;\n",next);
+	else
+		printf("\tpc = 0x%02x; goto dispatch;\n",next);
+}
+
+
+/*
+ *   The counts of PmuCount() and the modeled cycles; e is 0 at a pc
+ *   outside the sampled range (Bbc counts its outcome itself)
+ */
+void
+emit_count(Uword a, Uword ir)
+{
+	const Decode	*d = &isa_decode[ir];
+
+	printf("\te = pmu->off[0x%02x] ^ 1; pmu->insns += e; "
+		"pmu->cls[%d] += e;\n",a,d->cls);
+	if( d->rd )
+		printf("\tpmu->reads[%d] += e;\n",d->region);
+	if( d->wr )
+		printf("\tpmu->writes[%d] += e;\n",d->region);
+	printf("\tpmu->cycles += e * %d; cpub->cycle += %d;\n",
+		d->cycles,d->cycles);
+}
+
+
+void
+emit_epilogue(void)
+{
+	printf("\n    suspend:\n"
+		"\tcpub->pc = pc; cpub->acc = acc; cpub->ix = ix;\n"
+		"\tcpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;\n"
+		"\tcpub->ir = ir; cpub->mar = mar;\n"
+		"\t*count = n;\n"
+		"\treturn status;\n}\n");
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+int
+main(int argc, char *argv[])
+{
+	int	a;
+
+	if( argc != 2 ) {
+		fprintf(stderr,"usage: %s program-file > program.aot.c\n",
+			argv[0]);
+		return 1;
+	}
+	if( read_mem_file(&cpub,argv[1]) != 0 )
+		return 1;
+
+	/*
+	 *   A program storing into its own text area cannot be translated
+	 */
+	find_reachable();
+	find_labels();
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( reach[a] && stores_into_text(cpub.mem[a]) ) {
+			fprintf(stderr,"%s: ST into the text area at 0x%02x; "
+				"not translated (interpret it instead)\n",
+				argv[1],a);
+			return 1;
+		}
+	}
+
+	emit_prologue();
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( reach[a] )
+			emit_insn(a);
+	emit_epilogue();
+	return 0;
+}
@@ -0,0 +1,545 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simbench.c
+ *	Descrioption:	benchmark harness of the simulator (make bench)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	<sys/resource.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"alu.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Benchmarks
+ *
+ *	A benchmark is a program file (.s is assembled, anything else is
+ *	read as a memory image) or two of them joined by '+', which run on
+ *	the two boards connected to each other.  Lines ";! acc=xx ix=xx" in
+ *	a source give the expected registers at the halt.
+ *===========================================================================*/
+#define	RUN_LIMIT	100000000L	/* instructions per run */
+#define	LOAD_REPEAT	20
+#define	NAMESIZE	64
+
+typedef struct bench {
+	char		name[NAMESIZE];
+	int		nboard;
+	char		*file[2];
+	Uword		image[2][MEMORY_SIZE];
+	int		expect[2][2];	/* acc, ix (-1: none) */
+	double		load_time;	/* seconds */
+	long		per_run;	/* instructions of a run */
+	double		rate;		/* instructions per second */
+} Bench;
+
+typedef struct kernel {
+	char	*class;
+	char	*insn;		/* repeated 32 times in a loop (%d: 0..31) */
+	char	*tail;		/* after the loop */
+} Kernel;
+
+typedef struct metric {
+	char	name[NAMESIZE];
+	char	metric[NAMESIZE];
+	double	value;
+} Metric;
+
+void	usage(char *);
+int	load_bench(Bench *, char *);
+int	load_file(Cpub *, char *);
+void	read_expect(Bench *, int);
+void	reset_boards(Bench *);
+long	run_once(Bench *);
+int	check_expect(Bench *);
+int	time_bench(Bench *);
+double	time_kernel(Kernel *);
+void	add_metric(char *, char *, double);
+int	write_results(char *);
+int	compare_baseline(char *, double);
+double	now(void);
+
+
+/*=============================================================================
+ *   State
+ *===========================================================================*/
+Cpub		board[2];
+
+double		min_time = 0.5;		/* seconds per benchmark */
+
+Kernel	kernels[] = {
+	{ "alu",	"ADD ACC,1",		NULL },
+	{ "logic",	"EOR ACC,IX",		NULL },
+	{ "shift",	"RLA ACC",		NULL },
+	{ "load",	"LD ACC,(IX+10)",	NULL },
+	{ "store",	"ST ACC,(IX+10)",	NULL },
+	{ "branch",	"BA l%d\nl%d:",		NULL },
+	{ "jump",	"JAL sub",		"sub: JR" },
+	{ "io",		"OUT\n\tIN",		NULL },
+};
+#define	NKERNEL	(sizeof(kernels) / sizeof(Kernel))
+
+Metric	*metrics;
+int	nmetric, metric_size;
+
+
+/*=============================================================================
+ *   Loading
+ *===========================================================================*/
+int
+load_file(Cpub *cpub, char *file)
+{
+	char	*ext = strrchr(file,'.');
+
+	text_private(cpub);
+	memset(cpub->mem,0,MEMORY_SIZE);
+	if( ext != NULL && !strcmp(ext,".s") )
+		return asm_file(cpub,file);
+	return read_mem_file(cpub,file);
+}
+
+
+int
+load_bench(Bench *b, char *arg)
+{
+	char	*s, *p;
+	double	t, best = 1e9;
+	int	i, k;
+
+	s = strdup(arg);
+	b->file[0] = s;
+	b->nboard = 1;
+	if( (p = strchr(s,'+')) != NULL ) {
+		*p = '\0';
+		b->file[1] = p + 1;
+		b->nboard = 2;
+	}
+	for( i = 0 ; i < b->nboard ; i++ ) {
+		p = strrchr(b->file[i],'/');
+		snprintf(b->name + strlen(b->name),NAMESIZE - strlen(b->name),
+			"%s%s",i ? "+" : "",p ? p + 1 : b->file[i]);
+	}
+
+	for( k = 0 ; k < LOAD_REPEAT ; k++ ) {
+		t = now();
+		for( i = 0 ; i < b->nboard ; i++ )
+			if( load_file(&board[i],b->file[i]) != 0 )
+				return -1;
+		t = now() - t;
+		if( t < best ) best = t;
+	}
+	b->load_time = best;
+	for( i = 0 ; i < b->nboard ; i++ ) {
+		memcpy(b->image[i],board[i].mem,MEMORY_SIZE);
+		text_share(&board[i]);
+		read_expect(b,i);
+	}
+	return 0;
+}
+
+
+void
+read_expect(Bench *b, int i)
+{
+	FILE		*fp;
+	char		line[256], *p;
+	unsigned int	v;
+
+	b->expect[i][0] = b->expect[i][1] = -1;
+	if( (fp = fopen(b->file[i],"r")) == NULL )
+		return;
+	while( fgets(line,sizeof(line),fp) != NULL ) {
+		if( strncmp(line,";!",2) != 0 )
+			continue;
+		if( (p = strstr(line,"acc=")) && sscanf(p + 4,"%x",&v) == 1 )
+			b->expect[i][0] = v;
+		if( (p = strstr(line,"ix=")) && sscanf(p + 3,"%x",&v) == 1 )
+			b->expect[i][1] = v;
+	}
+	fclose(fp);
+}
+
+
+/*=============================================================================
+ *   Running
+ *
+ *	A board keeps the shared text of its program between the runs and
+ *	only its data is reset, unless the program stored into its text.
+ *===========================================================================*/
+void
+reset_boards(Bench *b)
+{
+	Cpub	*cpub;
+	int	i;
+
+	for( i = 0 ; i < 2 ; i++ ) {
+		cpub = &board[i];
+		if( i < b->nboard && cpub->text != NULL )
+			memcpy(cpub->mem + IMEMORY_SIZE,b->image[i] + IMEMORY_SIZE,
+			       MEMORY_SIZE - IMEMORY_SIZE);
+		else if( i < b->nboard ) {
+			memcpy(cpub->mem,b->image[i],MEMORY_SIZE);
+			text_share(cpub);
+		}
+		cpub->pc = cpub->acc = cpub->ix = 0;
+		cpub->cf = cpub->vf = cpub->nf = cpub->zf = 0;
+		cpub->obuf.flag = cpub->obuf.buf = 0;
+	}
+}
+
+
+/*
+ *   Returns the instructions executed, -1 if a board did not halt
+ */
+long
+run_once(Bench *b)
+{
+	Cpub	*c0 = &board[0], *c1 = &board[1];
+	long	n = 0;
+	int	live0 = 1, live1;
+
+	reset_boards(b);
+	if( b->nboard == 1 ) {
+		while( step(c0) == RUN_STEP )
+			if( ++n >= RUN_LIMIT )
+				return -1;
+		return n + 1;
+	}
+
+	live1 = 1;
+	while( live0 | live1 ) {	/* one instruction of each in turn */
+		if( live0 ) {
+			live0 = step(c0);
+			n++;
+		}
+		if( live1 ) {
+			live1 = step(c1);
+			n++;
+		}
+		if( n >= RUN_LIMIT )
+			return -1;
+	}
+	return n;
+}
+
+
+int
+check_expect(Bench *b)
+{
+	Cpub	*cpub;
+	int	i, ok = 1;
+
+	for( i = 0 ; i < b->nboard ; i++ ) {
+		cpub = &board[i];
+		if( decrypt_instruction(cpub) != HLT ) {
+			fprintf(stderr,"%s: board %d halted on an invalid "
+				"instruction at pc=0x%02x\n",b->name,i,
+				cpub->mar);
+			ok = 0;
+		}
+		if( (b->expect[i][0] >= 0 && cpub->acc != b->expect[i][0])
+		    || (b->expect[i][1] >= 0 && cpub->ix != b->expect[i][1]) ) {
+			fprintf(stderr,"%s: board %d halted with acc=%02x "
+				"ix=%02x, expected",b->name,i,cpub->acc,
+				cpub->ix);
+			if( b->expect[i][0] >= 0 )
+				fprintf(stderr," acc=%02x",b->expect[i][0]);
+			if( b->expect[i][1] >= 0 )
+				fprintf(stderr," ix=%02x",b->expect[i][1]);
+			fprintf(stderr,"\n");
+			ok = 0;
+		}
+	}
+	return ok;
+}
+
+
+/*
+ *   Repeats the benchmark for min_time seconds at least.  The time is
+ *   measured in SLICES slices and the fastest one is reported, which is
+ *   less sensitive to the other load of the machine than the mean.
+ */
+#define	SLICES	10
+
+int
+time_bench(Bench *b)
+{
+	double		start, elapsed, rate;
+	long		runs;
+	int		i;
+
+	if( (b->per_run = run_once(b)) < 0 ) {
+		fprintf(stderr,"%s: did not halt within %ld instructions\n",
+							b->name,RUN_LIMIT);
+		return -1;
+	}
+	if( !check_expect(b) )
+		return -1;
+
+	b->rate = 0.0;
+	for( i = 0 ; i < SLICES ; i++ ) {
+		start = now();
+		runs = 0;
+		do {
+			run_once(b);
+			runs++;
+		} while( (elapsed = now() - start) < min_time / SLICES );
+		rate = b->per_run * runs / elapsed;
+		if( rate > b->rate )
+			b->rate = rate;
+	}
+	return 0;
+}
+
+
+/*
+ *   Nanoseconds per instruction of a loop of 32 instructions of a class
+ *   (the closing BA is 1 of 33 instructions), fastest of SLICES slices
+ */
+double
+time_kernel(Kernel *k)
+{
+	char	src[1024], *p = src;
+	Cpub	*cpub = &board[0];
+	double	start, elapsed, best = 1e9;
+	long	n, total;
+	int	i;
+
+	p += sprintf(p,"loop:\n");
+	for( i = 0 ; i < 32 ; i++ ) {
+		*p++ = '\t';
+		p += sprintf(p,k->insn,i,i);
+		*p++ = '\n';
+	}
+	sprintf(p,"\tBA loop\n%s\n",k->tail ? k->tail : "");
+
+	text_private(cpub);
+	memset(cpub->mem,0,MEMORY_SIZE);
+	if( asm_source(cpub,src) != 0 )
+		return -1.0;
+	cpub->pc = cpub->acc = cpub->ix = 0;
+
+	for( i = 0 ; i < SLICES ; i++ ) {
+		start = now();
+		total = 0;
+		do {
+			for( n = 0 ; n < 100000 ; n++ )
+				step(cpub);
+			total += n;
+		} while( (elapsed = now() - start) < min_time / 4 / SLICES );
+		if( elapsed * 1e9 / total < best )
+			best = elapsed * 1e9 / total;
+	}
+	return best;
+}
+
+
+/*=============================================================================
+ *   Results and the Baseline
+ *
+ *	A results file has a line "<name> <metric> <value>" per metric.
+ *	insn_per_sec is better when higher, ns_per_insn when lower; the
+ *	other metrics are reported only.
+ *===========================================================================*/
+void
+add_metric(char *name, char *metric, double value)
+{
+	if( nmetric == metric_size ) {
+		metric_size = metric_size ? metric_size * 2 : 64;
+		metrics = realloc(metrics,sizeof(Metric) * metric_size);
+		if( metrics == NULL ) {
+			fprintf(stderr,"Unable to allocate the metrics\n");
+			exit(1);
+		}
+	}
+	snprintf(metrics[nmetric].name,NAMESIZE,"%s",name);
+	snprintf(metrics[nmetric].metric,NAMESIZE,"%s",metric);
+	metrics[nmetric++].value = value;
+}
+
+
+int
+write_results(char *file)
+{
+	FILE	*fp;
+	int	i;
+
+	if( (fp = fopen(file,"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	fprintf(fp,"# simbench results: name metric value\n");
+	for( i = 0 ; i < nmetric ; i++ )
+		fprintf(fp,"%s %s %.6g\n",metrics[i].name,metrics[i].metric,
+							metrics[i].value);
+	fclose(fp);
+	return 0;
+}
+
+
+/*
+ *   Returns the number of regressions beyond the threshold (percent)
+ */
+int
+compare_baseline(char *file, double threshold)
+{
+	FILE	*fp;
+	char	line[256], name[NAMESIZE], metric[NAMESIZE];
+	double	base, change;
+	int	i, worse, regressions = 0;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	printf("\ncompared with %s (threshold %.0f%%)\n",file,threshold);
+	while( fgets(line,sizeof(line),fp) != NULL ) {
+		if( line[0] == '#'
+		    || sscanf(line,"%63s %63s %lf",name,metric,&base) != 3 )
+			continue;
+		if( strcmp(metric,"insn_per_sec") && strcmp(metric,"ns_per_insn") )
+			continue;
+		for( i = 0 ; i < nmetric ; i++ )
+			if( !strcmp(metrics[i].name,name)
+			    && !strcmp(metrics[i].metric,metric) )
+				break;
+		if( i == nmetric || base <= 0 )
+			continue;
+		change = (metrics[i].value - base) * 100.0 / base;
+		worse = metric[0] == 'i' ? -change > threshold
+					 : change > threshold;
+		printf("   %-20s %-14s %12.4g -> %12.4g  %+6.1f%%%s\n",name,
+			metric,base,metrics[i].value,change,
+			worse ? "  REGRESSION" : "");
+		regressions += worse;
+	}
+	fclose(fp);
+	return regressions;
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+/*
+ *   Process CPU time: the time the harness is descheduled is not counted
+ */
+double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program[+program] ...\n"
+		"   -t seconds\t--- minimum time per benchmark (default: 0.5)\n"
+		"   -o file\t--- write the results into the file\n"
+		"   -b file\t--- compare with the baseline results file\n"
+		"   -r percent\t--- regression threshold (default: 10)\n",
+		prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	Bench		b;
+	struct rusage	ru;
+	char		*out = NULL, *baseline = NULL;
+	double		threshold = 10.0, ns;
+	unsigned long long	total = 0;
+	double		total_time = 0.0;
+	int		opt, i, failed = 0, regressions;
+
+	while( (opt = getopt(argc,argv,"t:o:b:r:")) != -1 ) {
+		switch( opt ) {
+		   case 't':	min_time = atof(optarg); break;
+		   case 'o':	out = optarg; break;
+		   case 'b':	baseline = optarg; break;
+		   case 'r':	threshold = atof(optarg); break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind >= argc || min_time <= 0 ) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	mem_map(&board[0]);
+	mem_map(&board[1]);
+	board[0].ibuf = &(board[1].obuf);
+	board[1].ibuf = &(board[0].obuf);
+	err_mesg_off = 1;
+
+	/*
+	 *   Programs
+	 */
+	printf("%-20s %12s %10s %10s %10s\n","program","insns/run",
+					"Minsn/s","ns/insn","load(us)");
+	for( ; optind < argc ; optind++ ) {
+		memset(&b,0,sizeof(b));
+		if( load_bench(&b,argv[optind]) != 0 || time_bench(&b) != 0 ) {
+			failed++;
+			continue;
+		}
+		printf("%-20s %12ld %10.2f %10.2f %10.1f\n",b.name,b.per_run,
+			b.rate / 1e6,1e9 / b.rate,b.load_time * 1e6);
+		add_metric(b.name,"insn_per_sec",b.rate);
+		add_metric(b.name,"insns_per_run",b.per_run);
+		add_metric(b.name,"load_us",b.load_time * 1e6);
+		total += b.per_run;
+		total_time += b.per_run / b.rate;
+	}
+	if( total > 0 ) {
+		printf("%-20s %12llu %10.2f %10.2f\n","(all)",total,
+			total / total_time / 1e6,total_time * 1e9 / total);
+		add_metric("all","insn_per_sec",total / total_time);
+	}
+
+	/*
+	 *   Instruction classes
+	 */
+	printf("\n%-20s %10s\n","class","ns/insn");
+	for( i = 0 ; i < NKERNEL ; i++ ) {
+		if( (ns = time_kernel(&kernels[i])) < 0 ) {
+			failed++;
+			continue;
+		}
+		printf("%-20s %10.2f\n",kernels[i].class,ns);
+		add_metric(kernels[i].class,"ns_per_insn",ns);
+	}
+
+	/*
+	 *   Memory
+	 */
+	getrusage(RUSAGE_SELF,&ru);
+	printf("\nmemory: max rss %ld KB, board %zu bytes, "
+		"decode table %zu bytes, ALU table %zu bytes\n",ru.ru_maxrss,
+		sizeof(Cpub),sizeof(isa_decode),sizeof(alu_tab));
+	add_metric("memory","max_rss_kb",ru.ru_maxrss);
+	add_metric("memory","board_bytes",sizeof(Cpub));
+	add_metric("memory","table_bytes",sizeof(isa_decode) + sizeof(alu_tab));
+
+	if( out != NULL && write_results(out) != 0 )
+		failed++;
+	if( baseline != NULL ) {
+		regressions = compare_baseline(baseline,threshold);
+		if( regressions != 0 )
+			failed++;
+	}
+	return failed ? 1 : 0;
+}
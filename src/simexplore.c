@@ -0,0 +1,576 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simexplore.c
+ *	Descrioption:	exhaustive exploration of 8-bit input spaces
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"loop.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Input Dimensions (each one is an 8-bit value)
+ *
+ *	With -i n the input streams of every length up to n are tried.
+ *	The cases are numbered by the length first (first[l] is the first
+ *	case of the streams of l bytes), then by the values of the dims
+ *	taking part, the first of them in the lowest byte.
+ *===========================================================================*/
+#define	DIM_MAX		4
+#define	DIM_ACC		0
+#define	DIM_IX		1
+#define	DIM_MEM		2
+#define	DIM_IBUF	3	/* the n-th byte of the input stream */
+
+typedef struct dim {
+	int	kind;
+	Addr	addr;		/* DIM_MEM: address */
+} Dim;
+
+Dim		dims[DIM_MAX];
+int		ndims, ninput;
+unsigned long long	ncases, first[DIM_MAX + 2];
+
+
+/*=============================================================================
+ *   Outcomes
+ *===========================================================================*/
+#define	OUT_MAX		32
+
+#define	END_HALT	0
+#define	END_INVALID	1
+#define	END_LOOP	2
+#define	END_BUDGET	3
+#define	END_INPUT	4	/* waits for more input than it had */
+
+static char	*end_name[] = { "halt", "invalid", "loop", "budget",
+				"end of input" };
+
+typedef struct outcome {
+	Uword	end, acc, ix, flags;
+	Uword	pc;
+	int	nout;			/* bytes written by OUT */
+	Uword	out[OUT_MAX];
+} Outcome;
+
+typedef struct range {
+	unsigned long long	lo, hi;	/* cases lo..hi */
+} Range;
+
+typedef struct class {
+	Outcome		o;
+	unsigned long long	cases;
+	unsigned long long	min_count, max_count;
+	Range		*ranges;
+	int		nranges, size;
+} Class;
+
+typedef struct table {
+	Class		*cls;
+	int		n, size;
+} Table;
+
+
+/*=============================================================================
+ *   Worker State
+ *===========================================================================*/
+#define	CHUNK		1024
+
+typedef struct worker {
+	pthread_t	thread;
+	Cpub		board;
+	IOBuf		input;
+	LoopDet		ld;
+	Table		table;
+} Worker;
+
+Cpub		base;			/* the loaded program */
+long		budget = 100000;	/* instructions per case */
+pthread_mutex_t	next_lock = PTHREAD_MUTEX_INITIALIZER;
+unsigned long long	next_case;
+
+void	usage(char *);
+void	*explore(void *);
+int	case_values(unsigned long long, Uword *);
+void	run_case(Worker *, unsigned long long);
+int	waiting(Cpub *, unsigned long long);
+unsigned long	outcome_hash(Outcome *);
+Class	*table_find(Table *, Outcome *);
+void	class_add(Class *, unsigned long long, unsigned long long,
+		  unsigned long long);
+int	range_cmp(const void *, const void *);
+void	class_sort(Class *);
+int	class_cmp(const void *, const void *);
+void	print_case(unsigned long long);
+void	report(Table *, int);
+
+
+/*=============================================================================
+ *   Case Numbers
+ *
+ *	The values of the dims of case c (those of the missing input bytes
+ *	are not set); returns the length of its input stream.
+ *===========================================================================*/
+int
+case_values(unsigned long long c, Uword *value)
+{
+	int	d, k, len;
+
+	for( len = ninput ; c < first[len] ; len-- )
+		;
+	c -= first[len];
+	for( d = k = 0 ; d < ndims ; d++ )
+		if( dims[d].kind != DIM_IBUF || dims[d].addr < len )
+			value[d] = c >> (8 * k++);
+	return len;
+}
+
+
+/*=============================================================================
+ *   Run One Case
+ *
+ *	Every board shares the text of the loaded program, so a case only
+ *	resets the data region; a case storing into the text (or varying
+ *	a text word) runs on a private clone until the next case.
+ *===========================================================================*/
+void
+run_case(Worker *w, unsigned long long c)
+{
+	Cpub		*cpub = &w->board;
+	Uword		input[DIM_MAX], value[DIM_MAX];
+	Outcome		o;
+	unsigned long long	n;
+	int		d, next = 0, len, checking;
+
+	text_attach(cpub,base.text);		/* the data is the case's own */
+	memcpy(cpub->mem + IMEMORY_SIZE,base.mem + IMEMORY_SIZE,
+	       MEMORY_SIZE - IMEMORY_SIZE);
+	cpub->pc = base.pc;
+	cpub->acc = base.acc;
+	cpub->ix = base.ix;
+	cpub->cf = base.cf;
+	cpub->vf = base.vf;
+	cpub->nf = base.nf;
+	cpub->zf = base.zf;
+	cpub->obuf.flag = cpub->obuf.buf = 0;
+	w->input.flag = w->input.buf = 0;
+
+	len = case_values(c,value);
+	for( d = 0 ; d < ndims ; d++ ) {
+		Uword	v = value[d];
+		if( dims[d].kind == DIM_IBUF && dims[d].addr >= len )
+			continue;
+		switch( dims[d].kind ) {
+		   case DIM_ACC:	cpub->acc = v; break;
+		   case DIM_IX:		cpub->ix = v; break;
+		   case DIM_MEM:	if( dims[d].addr < IMEMORY_SIZE )
+						text_private(cpub);
+					cpub->mem[dims[d].addr] = v;
+					break;
+		   case DIM_IBUF:	input[dims[d].addr] = v; break;
+		}
+	}
+
+	/*
+	 *   The board is a closed system only once the input stream has
+	 *   been consumed, so loop detection starts from there.  A loop
+	 *   then waiting on BNI ends with the input.
+	 */
+	memset(&o,0,sizeof(o));
+	o.end = END_BUDGET;
+	checking = 0;
+	for( n = 0 ; n < budget ; ) {
+		if( !w->input.flag && next < len ) {
+			w->input.buf = input[next++];
+			w->input.flag = 1;
+		}
+		if( !checking && next == len ) {
+			loop_start(&w->ld,cpub);
+			checking = 1;
+		}
+		n++;
+		if( step(cpub) == RUN_HALT ) {
+			o.end = decrypt_instruction(cpub) == HLT ? END_HALT
+								  : END_INVALID;
+			break;
+		}
+		if( cpub->obuf.flag ) {		/* consume the output */
+			if( o.nout < OUT_MAX )
+				o.out[o.nout] = cpub->obuf.buf;
+			o.nout++;
+			cpub->obuf.flag = 0;
+		}
+		if( checking && loop_check(&w->ld,cpub) ) {
+			o.end = waiting(cpub,w->ld.period) ? END_INPUT
+							   : END_LOOP;
+			break;
+		}
+	}
+	o.acc = cpub->acc;
+	o.ix = cpub->ix;
+	o.flags = PackedFlags(cpub);
+	o.pc = o.end <= END_INVALID ? cpub->mar : 0;
+
+	class_add(table_find(&w->table,&o),c,c,n);
+}
+
+
+/*
+ *   1 if a BNI is taken within one period of the loop (a BNO is not:
+ *   the output is consumed).  The period brings the board back to the
+ *   same state.
+ */
+int
+waiting(Cpub *cpub, unsigned long long period)
+{
+	int	poll = 0;
+
+	for( ; period > 0 ; period-- ) {
+		step(cpub);
+		if( isa_decode[cpub->ir].poll && cpub->bt )
+			poll = 1;
+		cpub->obuf.flag = 0;
+	}
+	return poll;
+}
+
+
+void *
+explore(void *arg)
+{
+	Worker			*w = arg;
+	unsigned long long	c, end;
+
+	mem_map(&w->board);
+	w->board.ibuf = &w->input;
+	while( 1 ) {
+		pthread_mutex_lock(&next_lock);
+		c = next_case;
+		next_case += CHUNK;
+		pthread_mutex_unlock(&next_lock);
+		if( c >= ncases )
+			break;
+		end = (c + CHUNK < ncases) ? c + CHUNK : ncases;
+		for( ; c < end ; c++ )
+			run_case(w,c);
+	}
+	return NULL;
+}
+
+
+/*=============================================================================
+ *   Outcome Table (open addressing)
+ *===========================================================================*/
+unsigned long
+outcome_hash(Outcome *o)
+{
+	unsigned long	h = 14695981039346656037UL;
+	unsigned char	*p = (unsigned char *)o;
+	int		i;
+
+	for( i = 0 ; i < sizeof(Outcome) ; i++ )
+		h = (h ^ p[i]) * 1099511628211UL;	/* FNV-1a */
+	return h;
+}
+
+
+Class *
+table_find(Table *t, Outcome *o)
+{
+	Class	*old;
+	int	i, j, n;
+
+	if( 2 * (t->n + 1) > t->size ) {		/* grow */
+		old = t->cls;
+		n = t->size;
+		t->size = n ? 2 * n : 64;
+		if( (t->cls = calloc(t->size,sizeof(Class))) == NULL ) {
+			fprintf(stderr,"Unable to allocate the classes\n");
+			exit(1);
+		}
+		t->n = 0;
+		for( i = 0 ; i < n ; i++ ) {
+			if( !old[i].cases ) continue;
+			for( j = outcome_hash(&old[i].o) & (t->size - 1) ;
+			     t->cls[j].cases ; j = (j + 1) & (t->size - 1) )
+				;
+			t->cls[j] = old[i];
+			t->n++;
+		}
+		free(old);
+	}
+
+	for( i = outcome_hash(o) & (t->size - 1) ; t->cls[i].cases ;
+	     i = (i + 1) & (t->size - 1) )
+		if( !memcmp(&t->cls[i].o,o,sizeof(Outcome)) )
+			return &t->cls[i];
+	memcpy(&t->cls[i].o,o,sizeof(Outcome));	/* with the padding */
+	t->n++;
+	return &t->cls[i];
+}
+
+
+void
+class_add(Class *cls, unsigned long long lo, unsigned long long hi,
+	  unsigned long long count)
+{
+	Range	*r;
+
+	if( cls->cases == 0 || count < cls->min_count )
+		cls->min_count = count;
+	if( cls->cases == 0 || count > cls->max_count )
+		cls->max_count = count;
+	cls->cases += hi - lo + 1;
+
+	r = cls->nranges ? &cls->ranges[cls->nranges - 1] : NULL;
+	if( r != NULL && r->hi + 1 == lo ) {
+		r->hi = hi;
+		return;
+	}
+	if( cls->nranges == cls->size ) {
+		cls->size = cls->size ? 2 * cls->size : 4;
+		cls->ranges = realloc(cls->ranges,sizeof(Range) * cls->size);
+		if( cls->ranges == NULL ) {
+			fprintf(stderr,"Unable to allocate the ranges\n");
+			exit(1);
+		}
+	}
+	cls->ranges[cls->nranges].lo = lo;
+	cls->ranges[cls->nranges++].hi = hi;
+}
+
+
+int
+range_cmp(const void *a, const void *b)
+{
+	const Range	*x = a, *y = b;
+
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+
+/*
+ *   Workers take chunks in any order, so ranges are sorted and the
+ *   adjacent ones joined before reporting.
+ */
+void
+class_sort(Class *cls)
+{
+	int	i, n;
+
+	qsort(cls->ranges,cls->nranges,sizeof(Range),range_cmp);
+	for( n = 0, i = 1 ; i < cls->nranges ; i++ ) {
+		if( cls->ranges[n].hi + 1 == cls->ranges[i].lo )
+			cls->ranges[n].hi = cls->ranges[i].hi;
+		else
+			cls->ranges[++n] = cls->ranges[i];
+	}
+	if( cls->nranges )
+		cls->nranges = n + 1;
+}
+
+
+/*=============================================================================
+ *   Report
+ *===========================================================================*/
+void
+print_case(unsigned long long c)
+{
+	Uword	value[DIM_MAX];
+	char	*sep = "";
+	int	d, len;
+
+	len = case_values(c,value);
+	for( d = 0 ; d < ndims ; d++ ) {
+		if( dims[d].kind == DIM_IBUF && dims[d].addr >= len )
+			continue;
+		printf("%s",sep);
+		sep = ",";
+		switch( dims[d].kind ) {
+		   case DIM_ACC:	printf("acc="); break;
+		   case DIM_IX:		printf("ix="); break;
+		   case DIM_MEM:	printf("m%03x=",dims[d].addr); break;
+		   case DIM_IBUF:	printf("in%d=",dims[d].addr); break;
+		}
+		printf("%02x",value[d]);
+	}
+	if( ninput > 0 && len == 0 )
+		printf("%sno input",sep);
+}
+
+
+int
+class_cmp(const void *a, const void *b)
+{
+	const Class	*x = *(Class **)a, *y = *(Class **)b;
+
+	return (x->cases < y->cases) - (x->cases > y->cases);
+}
+
+
+/*
+ *   The most common outcomes first
+ */
+void
+report(Table *t, int max_ranges)
+{
+	Class	*cls, **sorted;
+	int	i, j, n;
+
+	sorted = malloc(sizeof(Class *) * (t->n + 1));
+	for( n = i = 0 ; i < t->size ; i++ )
+		if( t->cls[i].cases )
+			sorted[n++] = &t->cls[i];
+	qsort(sorted,n,sizeof(Class *),class_cmp);
+
+	for( i = 0 ; i < n ; i++ ) {
+		cls = sorted[i];
+
+		printf("%s",end_name[cls->o.end]);
+		if( cls->o.end == END_HALT || cls->o.end == END_INVALID )
+			printf(" at pc=%02x",cls->o.pc);
+		printf(": acc=%02x ix=%02x cf=%d vf=%d nf=%d zf=%d out=[",
+			cls->o.acc,cls->o.ix,(cls->o.flags >> 3) & 1,
+			(cls->o.flags >> 2) & 1,(cls->o.flags >> 1) & 1,
+			cls->o.flags & 1);
+		for( j = 0 ; j < cls->o.nout && j < OUT_MAX ; j++ )
+			printf("%s%02x",j ? " " : "",cls->o.out[j]);
+		if( cls->o.nout > OUT_MAX )
+			printf(" ... (%d bytes)",cls->o.nout);
+		printf("]\n\t%llu cases, %llu..%llu instructions\n",
+			cls->cases,cls->min_count,cls->max_count);
+
+		class_sort(cls);
+		for( j = 0 ; j < cls->nranges && j < max_ranges ; j++ ) {
+			printf("\t");
+			print_case(cls->ranges[j].lo);
+			if( cls->ranges[j].hi != cls->ranges[j].lo ) {
+				printf(" .. ");
+				print_case(cls->ranges[j].hi);
+			}
+			printf("\n");
+		}
+		if( cls->nranges > max_ranges )
+			printf("\t... %d more ranges\n",
+				cls->nranges - max_ranges);
+	}
+	free(sorted);
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program-file\n"
+		"   -a\t\t--- every initial value of acc\n"
+		"   -x\t\t--- every initial value of ix\n"
+		"   -m addr\t--- every initial value of a memory word(hex)\n"
+		"   -i length\t--- every ibuf input sequence up to the length\n"
+		"   -b count\t--- instructions per case (default: 100000)\n"
+		"   -j threads\t--- number of threads (default: all cores)\n"
+		"   -r count\t--- input ranges shown per outcome "
+		"(default: 8)\n"
+		"   at most %d of -a, -x, -m and input bytes\n",prog,DIM_MAX);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	Worker		*workers;
+	Table		all;
+	Class		*cls, *dst;
+	int		nthreads, max_ranges = 8;
+	int		opt, i, j, k;
+	unsigned int	addr;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	while( (opt = getopt(argc,argv,"axm:i:b:j:r:")) != -1 ) {
+		if( ndims == DIM_MAX && strchr("axmi",opt) ) {
+			usage(argv[0]);
+			return 1;
+		}
+		switch( opt ) {
+		   case 'a':	dims[ndims++].kind = DIM_ACC; break;
+		   case 'x':	dims[ndims++].kind = DIM_IX; break;
+		   case 'm':
+			sscanf(optarg,"%x",&addr);
+			if( addr >= MEMORY_SIZE ) {
+				fprintf(stderr,"Invalid address: 0x%x\n",addr);
+				return 1;
+			}
+			dims[ndims].kind = DIM_MEM;
+			dims[ndims++].addr = addr;
+			break;
+		   case 'i':
+			for( k = atoi(optarg) ; k > 0 ; k-- ) {
+				if( ndims == DIM_MAX ) {
+					usage(argv[0]);
+					return 1;
+				}
+				dims[ndims].kind = DIM_IBUF;
+				dims[ndims++].addr = ninput++;
+			}
+			break;
+		   case 'b':	budget = atol(optarg); break;
+		   case 'j':	nthreads = atoi(optarg); break;
+		   case 'r':	max_ranges = atoi(optarg); break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind != argc - 1 || nthreads < 1 ) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	err_mesg_off = 1;
+	if( read_mem_file(&base,argv[optind]) != 0 || text_share(&base) != 0 )
+		return 1;
+	for( k = 0 ; k <= ninput ; k++ )
+		first[k + 1] = first[k] + (1ULL << (8 * (ndims - ninput + k)));
+	ncases = first[ninput + 1];
+
+	/*
+	 *   Explore in parallel
+	 */
+	workers = calloc(nthreads,sizeof(Worker));
+	for( i = 0 ; i < nthreads ; i++ )
+		pthread_create(&workers[i].thread,NULL,explore,&workers[i]);
+	for( i = 0 ; i < nthreads ; i++ )
+		pthread_join(workers[i].thread,NULL);
+
+	/*
+	 *   Merge the outcomes of the workers
+	 */
+	memset(&all,0,sizeof(all));
+	for( i = 0 ; i < nthreads ; i++ ) {
+		for( j = 0 ; j < workers[i].table.size ; j++ ) {
+			cls = &workers[i].table.cls[j];
+			if( !cls->cases ) continue;
+			dst = table_find(&all,&cls->o);
+			for( k = 0 ; k < cls->nranges ; k++ )
+				class_add(dst,cls->ranges[k].lo,
+					  cls->ranges[k].hi,cls->min_count);
+			if( cls->max_count > dst->max_count )
+				dst->max_count = cls->max_count;
+			free(cls->ranges);
+		}
+		free(workers[i].table.cls);
+	}
+
+	printf("%llu cases, %d distinct outcomes\n",ncases,all.n);
+	report(&all,max_ranges);
+	return 0;
+}
@@ -0,0 +1,433 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simfuzz.c
+ *	Descrioption:	coverage-guided fuzzer of programs and input streams
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"coverage.h"
+#include	"text.h"
+#include	"loop.h"
+
+
+/*=============================================================================
+ *   Candidates
+ *===========================================================================*/
+#define	INPUT_MAX	64
+
+typedef struct sample {
+	Uword	mem[MEMORY_SIZE];	/* memory image */
+	Uword	diff[MEMORY_SIZE / 8];	/* 1: the word may not be the seed's */
+	int	own_text;		/* 1: the text is not the seed's */
+	int	ninput;
+	Uword	input[INPUT_MAX];	/* bytes fed through ibuf */
+} Sample;
+
+#define	FUZZ_HALT	0	/* HLT */
+#define	FUZZ_INVALID	1	/* halted on an invalid instruction */
+#define	FUZZ_BUDGET	2	/* instruction budget exhausted */
+#define	FUZZ_LOOP	3	/* state repeated between input bytes */
+
+#define	LOOP_EVERY	64	/* instructions between loop checks */
+
+void	usage(char *);
+int	fuzz_run(Sample *);
+void	fuzz_reset(Sample *);
+int	fuzz_new_coverage(void);
+void	mutate(Sample *);
+void	save_sample(char *, char *, int, Sample *);
+unsigned long long	rnd(void);
+double	now(void);
+
+
+/*=============================================================================
+ *   Fuzzing State
+ *===========================================================================*/
+Cpub		board;
+Text		*seed_text;	/* shared by the candidates which keep it */
+
+Uword		dirty[MEMORY_SIZE / 8];	/* 1: the board's word may not be */
+					/* the seed's */
+IOBuf		input;		/* ibuf of the board */
+LoopDet		ld;
+Coverage	total_cov;	/* coverage of the whole campaign */
+Uword		seen_text[256 / 8];	/* text and branch coverage */
+Uword		seen_branch[32 / 8];	/* before the run */
+
+Sample		*corpus;
+int		ncorpus, corpus_size;
+
+long		budget = 2000;	/* instructions per run */
+int		input_len = 16;	/* maximum input stream length */
+int		mut_text = 1, mut_data = 1, mut_input = 1;
+unsigned long long	seed = 1;
+
+
+/*=============================================================================
+ *   Run a Candidate
+ *
+ *	The board is reset from the candidate alone, so no file is read
+ *	between runs.  Only step() runs, with the coverage marked here
+ *	straight into the campaign's bitmaps.  Between two bytes taken from
+ *	the input the board is a closed system, so a repeated state ends
+ *	the run early: the rest of the budget would cover nothing new.  The
+ *	detector starts again whenever a byte is fed.
+ *===========================================================================*/
+int
+fuzz_run(Sample *s)
+{
+	Cpub	*cpub = &board;
+	long	n, m = -1;
+	int	next = 0, status;
+	Uword	ia, flags;
+
+	fuzz_reset(s);
+	cpub->pc = cpub->acc = cpub->ix = 0;
+	cpub->cf = cpub->vf = cpub->nf = cpub->zf = 0;
+	cpub->obuf.flag = cpub->obuf.buf = 0;
+	input.flag = input.buf = 0;
+	memcpy(seen_text,total_cov.text,sizeof(seen_text));
+	memcpy(seen_branch,total_cov.branch,sizeof(seen_branch));
+
+	for( n = 0 ; n < budget ; n++ ) {
+		if( !input.flag && next < s->ninput ) {
+			input.buf = s->input[next++];
+			input.flag = 1;
+			m = -1;
+		}
+		if( m < 0 ) {
+			loop_start(&ld,cpub);
+			m = 0;
+		}
+		ia = cpub->pc;
+		flags = PackedFlags(cpub);
+		status = step(cpub);
+		CovStep(&total_cov,cpub,ia,flags);
+		if( cpub->wf ) {
+			CovMark(dirty,cpub->wa);
+			cpub->wf = 0;
+		}
+		if( status == RUN_HALT ) {
+			if( decrypt_instruction(cpub) == HLT )
+				return FUZZ_HALT;
+			return FUZZ_INVALID;
+		}
+		if( m >= 0 && ++m % LOOP_EVERY == 0
+		    && loop_check_n(&ld,cpub,LOOP_EVERY) )
+			return FUZZ_LOOP;
+	}
+	return FUZZ_BUDGET;
+}
+
+
+/*
+ *   Only the words which may differ from the seed, on the board (the
+ *   mutations of the last candidate and the stores of its run) or in
+ *   the candidate, are copied.  A text shared with the seed is the
+ *   seed's; one made private starts as the seed's.
+ */
+void
+fuzz_reset(Sample *s)
+{
+	Cpub	*cpub = &board;
+	Uword	d;
+	int	i, b;
+
+	if( !s->own_text ) {
+		text_attach(cpub,seed_text);
+		memset(dirty,0,IMEMORY_SIZE / 8);
+	} else if( cpub->text != NULL ) {
+		text_private(cpub);
+		memset(dirty,0,IMEMORY_SIZE / 8);
+	}
+	for( i = 0 ; i < MEMORY_SIZE / 8 ; i++ ) {
+		if( (d = dirty[i] | s->diff[i]) == 0 )
+			continue;
+		for( b = 0 ; b < 8 ; b++ )
+			if( (d >> b) & 1 )
+				cpub->mem[i * 8 + b] = s->mem[i * 8 + b];
+		dirty[i] = s->diff[i];
+	}
+}
+
+
+/*
+ *   Text addresses and branch outcomes not seen in the campaign before
+ *   the run
+ */
+int
+fuzz_new_coverage(void)
+{
+	return memcmp(seen_text,total_cov.text,sizeof(seen_text))
+	    || memcmp(seen_branch,total_cov.branch,sizeof(seen_branch));
+}
+
+
+/*=============================================================================
+ *   Mutations
+ *===========================================================================*/
+unsigned long long
+rnd(void)
+{
+	seed ^= seed << 13;	/* xorshift64 */
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+
+void
+mutate(Sample *s)
+{
+	static Uword	special[] = { 0x00, 0x01, 0x7f, 0x80, 0xff };
+	Addr	addr;
+	int	n, i, k;
+	Sample	*other;
+
+	for( n = 1 + rnd() % 4 ; n > 0 ; n-- ) {
+		/*
+		 *   Pick a target among the enabled ones
+		 */
+		k = rnd() % 3;
+		if( (k == 0 && !mut_text) || (k == 1 && !mut_data) )
+			k = 2;
+		if( k == 2 && !mut_input )
+			k = mut_text ? 0 : 1;
+
+		if( k == 2 ) {				/* input stream */
+			i = s->ninput ? rnd() % s->ninput : 0;
+			switch( rnd() % 4 ) {
+			   case 0:	/* overwrite */
+				if( s->ninput ) {
+					s->input[i] = rnd();
+					break;
+				}
+				/* fall through */
+			   case 1:	/* insert */
+				if( s->ninput < input_len ) {
+					memmove(s->input + i + 1,s->input + i,
+							s->ninput - i);
+					s->input[i] = rnd();
+					s->ninput++;
+				}
+				break;
+			   case 2:	/* delete */
+				if( s->ninput ) {
+					memmove(s->input + i,s->input + i + 1,
+							s->ninput - i - 1);
+					s->ninput--;
+				}
+				break;
+			   case 3:	/* special value */
+				if( s->ninput )
+					s->input[i] = special[rnd() % 5];
+				break;
+			}
+			continue;
+		}
+
+		addr = (k == 0 ? 0x000 : 0x100) | (rnd() & 0xff);
+		s->own_text |= k == 0;
+		CovMark(s->diff,addr);
+		switch( rnd() % 4 ) {
+		   case 0:	/* flip a bit */
+			s->mem[addr] ^= 1 << (rnd() % 8);
+			break;
+		   case 1:	/* random word */
+			s->mem[addr] = rnd();
+			break;
+		   case 2:	/* special value */
+			s->mem[addr] = special[rnd() % 5];
+			break;
+		   case 3:	/* splice a line from another candidate */
+			other = &corpus[rnd() % ncorpus];
+			addr &= ~0xf;
+			memcpy(s->mem + addr,other->mem + addr,16);
+			memcpy(s->diff + addr / 8,other->diff + addr / 8,2);
+			s->own_text |= k == 0 && other->own_text;
+			break;
+		}
+	}
+}
+
+
+/*=============================================================================
+ *   Save a Candidate (program file and input bytes)
+ *===========================================================================*/
+void
+save_sample(char *dir, char *kind, int id, Sample *s)
+{
+	char	file[1024];
+	FILE	*fp;
+	int	i;
+
+	if( dir == NULL )
+		return;
+
+	text_private(&board);
+	memcpy(board.mem,s->mem,MEMORY_SIZE);
+	snprintf(file,sizeof(file),"%s/%s-%06d.txt",dir,kind,id);
+	write_mem_file(&board,file);
+
+	snprintf(file,sizeof(file),"%s/%s-%06d.in",dir,kind,id);
+	if( (fp = fopen(file,"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return;
+	}
+	for( i = 0 ; i < s->ninput ; i++ )
+		fprintf(fp,"%02x\n",s->input[i]);
+	fclose(fp);
+}
+
+
+double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program-file\n"
+		"   -n count\t--- number of runs (default: 1000000)\n"
+		"   -b count\t--- instructions per run (default: 2000)\n"
+		"\t\t    most runs use it all: runs/sec is about\n"
+		"\t\t    60 M / count per core\n"
+		"   -l length\t--- maximum input stream length (default: 16)\n"
+		"   -m areas\t--- areas to mutate: t(ext), d(ata), i(nput) "
+		"(default: tdi)\n"
+		"   -s seed\t--- random seed\n"
+		"   -o dir\t--- save new candidates and invalid halts "
+		"into the directory\n",prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	long		runs = 1000000, r;
+	long		halts = 0, invalids = 0, timeouts = 0, loops = 0;
+	char		*dir = NULL;
+	Sample		cand;
+	Uword		crash_pc[256 / 8];
+	double		start, elapsed;
+	int		opt, result;
+
+	while( (opt = getopt(argc,argv,"n:b:l:m:s:o:")) != -1 ) {
+		switch( opt ) {
+		   case 'n':	runs = atol(optarg); break;
+		   case 'b':	budget = atol(optarg); break;
+		   case 'l':	input_len = atoi(optarg); break;
+		   case 'm':	mut_text = strchr(optarg,'t') != NULL;
+				mut_data = strchr(optarg,'d') != NULL;
+				mut_input = strchr(optarg,'i') != NULL;
+				break;
+		   case 's':	seed = strtoull(optarg,NULL,0); break;
+		   case 'o':	dir = optarg; break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind != argc - 1 || input_len < 0 || input_len > INPUT_MAX
+	    || !(mut_text || mut_data || mut_input) ) {
+		usage(argv[0]);
+		return 1;
+	}
+	if( seed == 0 )
+		seed = 1;
+
+	/*
+	 *   Initialize the board and the seed candidate
+	 */
+	mem_map(&board);
+	board.ibuf = &input;
+	err_mesg_off = 1;
+	if( read_mem_file(&board,argv[optind]) != 0 || text_share(&board) != 0 )
+		return 1;
+	seed_text = board.text;
+
+	corpus_size = 256;
+	if( (corpus = malloc(sizeof(Sample) * corpus_size)) == NULL ) {
+		fprintf(stderr,"Unable to allocate the corpus\n");
+		return 1;
+	}
+	memcpy(corpus[0].mem,TextOf(&board),IMEMORY_SIZE);
+	memcpy(corpus[0].mem + IMEMORY_SIZE,board.mem + IMEMORY_SIZE,
+	       MEMORY_SIZE - IMEMORY_SIZE);
+	memset(corpus[0].diff,0,sizeof(corpus[0].diff));
+	corpus[0].own_text = 0;
+	corpus[0].ninput = 0;
+	ncorpus = 1;
+	fuzz_run(&corpus[0]);
+	memset(crash_pc,0,sizeof(crash_pc));
+
+	/*
+	 *   Fuzzing loop
+	 */
+	start = now();
+	for( r = 0 ; r < runs ; r++ ) {
+		cand = corpus[rnd() % ncorpus];
+		mutate(&cand);
+		result = fuzz_run(&cand);
+
+		switch( result ) {
+		   case FUZZ_HALT:	halts++; break;
+		   case FUZZ_BUDGET:	timeouts++; break;
+		   case FUZZ_LOOP:	loops++; break;
+		   case FUZZ_INVALID:
+			invalids++;
+			if( !CovTest(crash_pc,board.mar) ) {
+				CovMark(crash_pc,board.mar);
+				fprintf(stderr,"invalid halt: ir=0x%02x "
+					"at pc=0x%02x\n",board.ir,
+					board.mar);
+				save_sample(dir,"invalid",r,&cand);
+			}
+			break;
+		}
+
+		if( fuzz_new_coverage() ) {
+			if( ncorpus == corpus_size ) {
+				corpus_size *= 2;
+				corpus = realloc(corpus,
+						sizeof(Sample) * corpus_size);
+				if( corpus == NULL ) {
+					fprintf(stderr,"Unable to allocate "
+						"the corpus\n");
+					return 1;
+				}
+			}
+			corpus[ncorpus++] = cand;
+			save_sample(dir,"queue",r,&cand);
+		}
+	}
+	elapsed = now() - start;
+
+	/*
+	 *   Summary
+	 */
+	fprintf(stderr,"%ld runs in %.2f sec (%.0f runs/sec)\n",
+		runs,elapsed,elapsed > 0 ? runs / elapsed : 0.0);
+	fprintf(stderr,"   halted %ld, invalid %ld, looping %ld, "
+		"budget exhausted %ld\n",halts,invalids,loops,timeouts);
+	fprintf(stderr,"   corpus %d candidates\n",ncorpus);
+	cov_report(&total_cov,0);
+
+	free(corpus);
+	return 0;
+}
@@ -0,0 +1,389 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simpipe.c
+ *	Descrioption:	CPI of programs on pipeline configurations
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	<math.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"pipe.h"
+#include	"sample.h"
+
+
+/*=============================================================================
+ *   Configurations
+ *
+ *	Every configuration given by -c is driven by the same run of a
+ *	program, so a sweep costs one functional simulation per program.
+ *===========================================================================*/
+#define	CONFIG_MAX	32
+#define	INPUT_MAX	4096
+#define	NAMESIZE	24
+
+void	usage(char *);
+int	load_file(Cpub *, char *);
+void	run(char *);
+void	feed(void);
+long	fast(long);
+long	detail(long);
+void	sampled(long *, double *);
+void	print_row(char *, Pipe *, int, double);
+void	print_header(void);
+double	now(void);
+
+Cpub		board;
+IOBuf		input;		/* ibuf of the board */
+Pipe		pipes[CONFIG_MAX], total[CONFIG_MAX];
+double		total_var[CONFIG_MAX];	/* of the estimated cycles */
+int		total_est[CONFIG_MAX];	/* programs with an interval */
+int		npipes;
+int		next;			/* next input byte */
+int		halted;
+
+long		budget = 10000000;	/* instructions per program */
+int		quiet;			/* totals only */
+Uword		file_input[INPUT_MAX];
+int		file_ninput;
+unsigned long long	insns;		/* instructions run */
+unsigned long long	detailed;	/* of them through the models */
+
+Sampler		sampler;
+long		period;			/* 0: no sampling */
+long		window = 1000, warm = 200;
+int		random_start;
+unsigned long long	seed = 1;
+
+
+/*=============================================================================
+ *   Run a Program
+ *
+ *	The board runs alone: the input bytes (-i) are fed through ibuf
+ *	and the output is taken at once.  Without sampling every
+ *	instruction goes through the models.
+ *===========================================================================*/
+void
+run(char *file)
+{
+	long	n;
+	int	i, k;
+	double	half[CONFIG_MAX];
+	char	*p;
+
+	for( k = 0 ; k < npipes ; k++ ) {
+		pipe_reset(&pipes[k]);
+		half[k] = -1;
+	}
+	board.pc = board.acc = board.ix = 0;
+	board.cf = board.vf = board.nf = board.zf = 0;
+	board.obuf.flag = board.obuf.buf = 0;
+	input.flag = input.buf = 0;
+	next = 0;
+	halted = 0;
+
+	if( period == 0 ) {
+		n = detail(budget);
+		for( k = 0 ; k < npipes ; k++ )
+			pipe_end(&pipes[k]);
+	} else {
+		sampled(&n,half);
+		if( sampler.windows == 0 )
+			fprintf(stderr,"%s: no window in %ld instructions\n",
+				file,n);
+	}
+	insns += n;
+
+	p = strrchr(file,'/');
+	p = p ? p + 1 : file;
+	for( k = 0 ; k < npipes ; k++ ) {
+		if( !quiet )
+			print_row(p,&pipes[k],k,half[k]);
+		total[k].insns += pipes[k].insns;
+		total[k].cycles += pipes[k].cycles;
+		total[k].bcc += pipes[k].bcc;
+		total[k].miss += pipes[k].miss;
+		for( i = 0 ; i < STALL_CAUSES ; i++ )
+			total[k].stall[i] += pipes[k].stall[i];
+		if( half[k] >= 0 ) {
+			total_var[k] += half[k] * n * half[k] * n;
+			total_est[k]++;
+		}
+	}
+}
+
+
+void
+feed(void)
+{
+	if( !input.flag && next < file_ninput ) {
+		input.buf = file_input[next++];
+		input.flag = 1;
+	}
+}
+
+
+/*=============================================================================
+ *   Sampled Run
+ *
+ *	The CPI of each configuration is the mean of the CPIs of the
+ *	windows, measured at EX from the first instruction to the last;
+ *	the cycles and the stalls of the whole run are extrapolated from
+ *	the windows.  half[] gets the 95% interval of the CPI.
+ *===========================================================================*/
+void
+sampled(long *run_insns, double *half)
+{
+	Estimate	cpi[CONFIG_MAX];
+	Count		t0[CONFIG_MAX], s0[CONFIG_MAX][STALL_CAUSES];
+	Count		stall[CONFIG_MAX][STALL_CAUSES], measured = 0;
+	long		n = 0, w;
+	int		i, k;
+
+	sample_init(&sampler,period,window,warm,random_start,seed);
+	memset(cpi,0,sizeof(cpi));
+	memset(stall,0,sizeof(stall));
+	while( n < budget && !halted ) {
+		w = sample_skip(&sampler);
+		n += fast(w < budget - n ? w : budget - n);
+		n += detail(warm < budget - n ? warm : budget - n);
+		for( k = 0 ; k < npipes ; k++ ) {
+			t0[k] = pipes[k].t[ST_EX];
+			memcpy(s0[k],pipes[k].stall,sizeof(s0[k]));
+		}
+		n += w = detail(window < budget - n ? window : budget - n);
+		if( w == 0 )
+			break;
+		for( k = 0 ; k < npipes ; k++ ) {
+			est_add(&cpi[k],(double)(pipes[k].t[ST_EX] - t0[k]) / w);
+			for( i = 0 ; i < STALL_CAUSES ; i++ )
+				stall[k][i] += pipes[k].stall[i] - s0[k][i];
+		}
+		measured += w;
+		sampler.windows++;
+	}
+
+	*run_insns = n;
+	for( k = 0 ; k < npipes ; k++ ) {
+		pipes[k].insns = n;
+		pipes[k].cycles = est_mean(&cpi[k]) * n + 0.5;
+		for( i = 1 ; i < STALL_CAUSES ; i++ )
+			pipes[k].stall[i] = measured ? (double)stall[k][i]
+						       * n / measured + 0.5 : 0;
+		pipes[k].stall[STALL_NONE] = 0;
+		half[k] = est_half(&cpi[k]);
+	}
+}
+
+
+/*
+ *   Fast-forward: step() alone
+ */
+long
+fast(long count)
+{
+	long	n;
+
+	for( n = 0 ; n < count && !halted ; n++ ) {
+		feed();
+		halted = step(&board) == RUN_HALT;
+		board.obuf.flag = 0;		/* taken */
+	}
+	return n;
+}
+
+
+/*
+ *   Through the models
+ */
+long
+detail(long count)
+{
+	Uword	pc, ir, d, ix;
+	long	n;
+	int	k;
+
+	for( n = 0 ; n < count && !halted ; n++ ) {
+		feed();
+		pc = board.pc;
+		ir = board.mem[pc];
+		d = board.mem[(Uword)(pc + 1)];
+		ix = board.ix;
+		halted = step(&board) == RUN_HALT;
+		board.obuf.flag = 0;
+		for( k = 0 ; k < npipes ; k++ )
+			pipe_insn(&pipes[k],pc,ir,d,ix,board.bt);
+	}
+	detailed += n;
+	return n;
+}
+
+
+/*=============================================================================
+ *   Report: CPI and the Stall Cycles per Instruction by Cause
+ *===========================================================================*/
+void
+print_header(void)
+{
+	int	i;
+
+	printf("%-*s cfg %10s %10s  CPI  ",NAMESIZE,"program","insns","cycles");
+	if( period != 0 )
+		printf(" +-95%% ");
+	for( i = 0 ; i < STALL_CAUSES ; i++ )
+		printf(" %6s",pipe_stall_name[i]);
+	printf("  mispred\n");
+}
+
+
+/*
+ *   half: of the interval of the CPI (sampled runs)
+ */
+void
+print_row(char *name, Pipe *p, int k, double half)
+{
+	double	n = p->insns ? p->insns : 1;
+	int	i;
+
+	printf("%-*.*s %3d %10llu %10llu %5.2f ",NAMESIZE,NAMESIZE,name,k,
+	       p->insns,p->cycles,p->cycles / n);
+	if( period != 0 && half >= 0 )
+		printf(" %5.3f",half);
+	else if( period != 0 )
+		printf("     -");
+	for( i = 0 ; i < STALL_CAUSES ; i++ )
+		printf(" %6.3f",p->stall[i] / n);
+	printf("  %5.1f%%\n",p->bcc ? p->miss * 100.0 / p->bcc : 0.0);
+}
+
+
+/*=============================================================================
+ *   Programs
+ *===========================================================================*/
+int
+load_file(Cpub *cpub, char *file)
+{
+	char	*ext = strrchr(file,'.');
+
+	memset(cpub->mem,0,MEMORY_SIZE);
+	if( ext != NULL && !strcmp(ext,".s") )
+		return asm_file(cpub,file);
+	return read_mem_file(cpub,file);
+}
+
+
+double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program-file ...\n"
+		"   -c config\t--- a pipeline configuration (repeatable)\n"
+		"\t\t\tfwd=0|1,pred=stall|nt|t|btfn,ports=1|2,"
+		"fetch=1|2,mem=n\n"
+		"\t\t\t(default: fwd=1,pred=nt,ports=1,fetch=1,mem=1)\n"
+		"   -b count\t--- instructions per program "
+		"(default: 10000000)\n"
+		"   -i file\t--- input bytes of the programs\n"
+		"   -p count\t--- sample: a window every count instructions\n"
+		"   -w count\t--- instructions measured per window "
+		"(default: 1000)\n"
+		"   -u count\t--- warm-up instructions before a window "
+		"(default: 200)\n"
+		"   -r\t\t--- windows at random offsets in the periods\n"
+		"   -s seed\t--- random seed\n"
+		"   -q\t\t--- totals only\n",prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	FILE		*fp;
+	int		opt, i, k, loaded = 0;
+	double		start, elapsed;
+
+	while( (opt = getopt(argc,argv,"c:b:i:p:w:u:rs:q")) != -1 ) {
+		switch( opt ) {
+		   case 'c':
+			if( npipes == CONFIG_MAX ) {
+				fprintf(stderr,"Too many configurations\n");
+				return 1;
+			}
+			if( pipe_config(&pipes[npipes].cfg,optarg) != 0 )
+				return 1;
+			npipes++;
+			break;
+		   case 'b':	budget = atol(optarg); break;
+		   case 'i':
+			if( (fp = fopen(optarg,"rb")) == NULL ) {
+				fprintf(stderr,"Unable to open %s\n",optarg);
+				return 1;
+			}
+			file_ninput = fread(file_input,1,INPUT_MAX,fp);
+			fclose(fp);
+			break;
+		   case 'p':	period = atol(optarg); break;
+		   case 'w':	window = atol(optarg); break;
+		   case 'u':	warm = atol(optarg); break;
+		   case 'r':	random_start = 1; break;
+		   case 's':	seed = strtoull(optarg,NULL,0); break;
+		   case 'q':	quiet = 1; break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind == argc ) {
+		usage(argv[0]);
+		return 1;
+	}
+	if( npipes == 0 && pipe_config(&pipes[npipes++].cfg,"") != 0 )
+		return 1;
+	if( period != 0
+	    && sample_init(&sampler,period,window,warm,random_start,seed) != 0 )
+		return 1;
+
+	mem_map(&board);
+	board.ibuf = &input;
+	err_mesg_off = 1;
+	for( k = 0 ; k < npipes ; k++ )
+		printf("cfg %d: %s\n",k,pipes[k].cfg.name);
+	print_header();
+
+	start = now();
+	for( i = optind ; i < argc ; i++ ) {
+		if( load_file(&board,argv[i]) != 0 )
+			continue;
+		state_hash_init(&board);
+		run(argv[i]);
+		loaded++;
+	}
+	elapsed = now() - start;
+
+	for( k = 0 ; k < npipes ; k++ )
+		print_row("total",&total[k],k,
+			  !total_est[k] ? -1 : sqrt(total_var[k])
+				/ (total[k].insns ? total[k].insns : 1));
+	fflush(stdout);
+	fprintf(stderr,"%d programs, %d configurations, %llu instructions "
+		"(%.1f%% in detail) in %.2f s (%.1f M/s)\n",loaded,npipes,
+		insns,insns ? detailed * 100.0 / insns : 0.0,elapsed,
+		insns / elapsed / 1e6);
+	return loaded == argc - optind ? 0 : 1;
+}
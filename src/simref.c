@@ -0,0 +1,311 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simref.c
+ *	Descrioption:	lockstep check of step() against the reference model
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"ref.h"
+
+
+/*=============================================================================
+ *   Runs
+ *===========================================================================*/
+#define	INPUT_MAX	4096
+#define	NAMESIZE	64
+
+typedef struct run {
+	char	name[NAMESIZE];
+	Uword	mem[MEMORY_SIZE];	/* memory image */
+	int	ninput;
+	Uword	*input;			/* bytes fed through ibuf */
+	long	budget;			/* instructions */
+} Run;
+
+void	usage(char *);
+int	load_file(Cpub *, char *);
+void	reset(Run *);
+void	feed(Run *);
+long	lockstep(Run *, long *);
+void	locate(Run *, long);
+int	check(Run *);
+unsigned long long	rnd(void);
+double	now(void);
+
+Cpub		board;
+IOBuf		input;		/* ibuf of the board */
+Ref		ref;
+int		next;		/* next input byte */
+
+long		interval = 1024;	/* instructions between comparisons */
+long		budget = 10000000;	/* instructions per program */
+long		rbudget = 10000;	/* instructions per random program */
+Uword		file_input[INPUT_MAX];
+int		file_ninput;
+unsigned long long	seed = 1;
+unsigned long long	total;		/* instructions checked */
+
+
+/*=============================================================================
+ *   Lockstep
+ *
+ *	step() and ref_step() run side by side.  Every interval
+ *	instructions (and at a halt) the memory hashes and the register
+ *	words are compared, which costs next to nothing; only a run that
+ *	differs is replayed instruction by instruction from its start to
+ *	find the first divergent instruction.
+ *===========================================================================*/
+void
+reset(Run *r)
+{
+	memcpy(board.mem,r->mem,MEMORY_SIZE);
+	board.pc = board.acc = board.ix = 0;
+	board.cf = board.vf = board.nf = board.zf = 0;
+	board.obuf.flag = board.obuf.buf = 0;
+	input.flag = input.buf = 0;
+	next = 0;
+	state_hash_init(&board);
+	ref_load(&ref,&board);
+}
+
+
+/*
+ *   The next input byte once the board took the last one
+ */
+void
+feed(Run *r)
+{
+	if( !input.flag && next < r->ninput ) {
+		input.buf = r->input[next++];
+		input.flag = 1;
+		ref.ibuf = input;
+	}
+}
+
+
+/*
+ *   -1 if both agree to the end (*n gets the instructions), otherwise
+ *   the number of instructions at the last comparison that agreed
+ */
+long
+lockstep(Run *r, long *n)
+{
+	long	i, mark = 0, due = interval;
+	int	s0, s1;
+
+	reset(r);
+	for( i = 0 ; i < r->budget ; ) {
+		feed(r);
+		s0 = step(&board);
+		s1 = ref_step(&ref);
+		i++;
+		if( i == due || s0 != s1 || s0 == RUN_HALT ) {
+			if( s0 != s1 || board.hash != ref.hash
+			    || RegsWord(&board,board.ibuf)
+			       != RegsWord(&ref,&ref.ibuf) )
+				return mark;
+			mark = i;
+			due = i + interval;
+			if( s0 == RUN_HALT )
+				break;
+		}
+	}
+	*n = i;
+	if( board.hash != ref.hash
+	    || RegsWord(&board,board.ibuf) != RegsWord(&ref,&ref.ibuf) )
+		return mark;
+	return -1;
+}
+
+
+/*
+ *   Replay from the start and report the first divergent instruction
+ */
+void
+locate(Run *r, long mark)
+{
+	char	buf[32];
+	long	i;
+	Uword	pc;
+	int	s0, s1;
+
+	reset(r);
+	s0 = s1 = RUN_STEP;
+	pc = 0;
+	buf[0] = '\0';
+	for( i = 0 ; i < mark ; i++ ) {
+		feed(r);
+		step(&board);
+		ref_step(&ref);
+	}
+	for( ; i < r->budget ; i++ ) {
+		feed(r);
+		pc = board.pc;
+		disasm(board.mem,pc,buf);
+		s0 = step(&board);
+		s1 = ref_step(&ref);
+		if( s0 != s1 || !ref_same(&ref,&board) )
+			break;
+	}
+	fprintf(stderr,"%s: differs at instruction %ld, pc=0x%02x: %s%s\n",
+		r->name,i + 1,pc,buf,
+		s0 != s1 ? (s0 == RUN_HALT ? " (board halted)"
+				: " (reference halted)") : "");
+	ref_report(&ref,&board);
+}
+
+
+int
+check(Run *r)
+{
+	long	mark, n;
+
+	if( (mark = lockstep(r,&n)) < 0 ) {
+		total += n;
+		return 0;
+	}
+	locate(r,mark);
+	return 1;
+}
+
+
+/*=============================================================================
+ *   Programs
+ *===========================================================================*/
+int
+load_file(Cpub *cpub, char *file)
+{
+	char	*ext = strrchr(file,'.');
+
+	memset(cpub->mem,0,MEMORY_SIZE);
+	if( ext != NULL && !strcmp(ext,".s") )
+		return asm_file(cpub,file);
+	return read_mem_file(cpub,file);
+}
+
+
+unsigned long long
+rnd(void)
+{
+	seed ^= seed << 13;	/* xorshift64 */
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+
+double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] [program-file ...]\n"
+		"   -n count\t--- instructions between comparisons "
+		"(default: 1024)\n"
+		"   -b count\t--- instructions per program "
+		"(default: 10000000)\n"
+		"   -i file\t--- input bytes of the programs\n"
+		"   -r count\t--- also check random programs\n"
+		"   -l count\t--- instructions per random program "
+		"(default: 10000)\n"
+		"   -s seed\t--- random seed\n",prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	Run		run;
+	Uword		rinput[64];
+	FILE		*fp;
+	char		*p;
+	long		randoms = 0, k;
+	int		opt, i, checked = 0, differ = 0;
+	double		start, elapsed;
+
+	while( (opt = getopt(argc,argv,"n:b:i:r:l:s:")) != -1 ) {
+		switch( opt ) {
+		   case 'n':	interval = atol(optarg); break;
+		   case 'b':	budget = atol(optarg); break;
+		   case 'i':
+			if( (fp = fopen(optarg,"rb")) == NULL ) {
+				fprintf(stderr,"Unable to open %s\n",optarg);
+				return 1;
+			}
+			file_ninput = fread(file_input,1,INPUT_MAX,fp);
+			fclose(fp);
+			break;
+		   case 'r':	randoms = atol(optarg); break;
+		   case 'l':	rbudget = atol(optarg); break;
+		   case 's':	seed = strtoull(optarg,NULL,0); break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( interval <= 0 || (optind == argc && randoms == 0) ) {
+		usage(argv[0]);
+		return 1;
+	}
+	if( seed == 0 )
+		seed = 1;
+
+	mem_map(&board);
+	board.ibuf = &input;
+	err_mesg_off = 1;
+	start = now();
+
+	/*
+	 *   The program files
+	 */
+	for( i = optind ; i < argc ; i++ ) {
+		if( load_file(&board,argv[i]) != 0 )
+			return 1;
+		p = strrchr(argv[i],'/');
+		snprintf(run.name,NAMESIZE,"%s",p ? p + 1 : argv[i]);
+		memcpy(run.mem,board.mem,MEMORY_SIZE);
+		run.input = file_input;
+		run.ninput = file_ninput;
+		run.budget = budget;
+		differ += check(&run);
+		checked++;
+	}
+
+	/*
+	 *   Random programs (text, data and input)
+	 */
+	for( k = 0 ; k < randoms ; k++ ) {
+		snprintf(run.name,NAMESIZE,"random %ld",k);
+		for( i = 0 ; i < MEMORY_SIZE ; i++ )
+			run.mem[i] = rnd();
+		for( i = 0 ; i < sizeof(rinput) ; i++ )
+			rinput[i] = rnd();
+		run.input = rinput;
+		run.ninput = sizeof(rinput);
+		run.budget = rbudget;
+		differ += check(&run);
+	}
+
+	elapsed = now() - start;
+	fprintf(stderr,"%d programs, %ld random, %llu instructions "
+		"in %.2f s (%.1f M/s), %d differ\n",checked,randoms,total,
+		elapsed,total / elapsed / 1e6,differ);
+	return differ ? 1 : 0;
+}
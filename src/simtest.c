@@ -0,0 +1,517 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simtest.c
+ *	Descrioption:	regression runner of program corpora (golden files)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<stdarg.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<dirent.h>
+#include	<time.h>
+#include	<pthread.h>
+#include	<sys/stat.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+#include	"loop.h"
+#include	"text.h"
+
+
+/*=============================================================================
+ *   Golden Files
+ *
+ *	The golden file of a program is the program file name with
+ *	".gold" appended.  Every item is optional; only the items present
+ *	are checked:
+ *
+ *	    ; comment
+ *	    end=halt pc=26		(halt, invalid, loop or limit; pc of
+ *					 the halting instruction)
+ *	    acc=74 ix=64 cf=0 vf=0 nf=0 zf=1
+ *	    ibuf=0:00 obuf=0:00		(flag:buffer)
+ *	    insns=1508 cycles=5321
+ *	    mem 180: 01 02 03 ...	(up to 16 words from the address)
+ *	    memhash=...			(of the whole memory)
+ *
+ *	simtest -w writes them from the current results: the non-zero
+ *	16-word lines of the memory and the hash of the rest.
+ *===========================================================================*/
+#define	END_HALT	0
+#define	END_INVALID	1
+#define	END_LOOP	2
+#define	END_LIMIT	3
+
+char	*end_name[] = { "halt", "invalid", "loop", "limit" };
+
+#define	PASS		0
+#define	FAIL		1
+#define	NO_GOLD		2
+#define	ERROR		3
+
+#define	DIFFSIZE	1024
+#define	LOOP_EVERY	64	/* instructions between loop checks */
+
+typedef struct result {
+	char		*file;
+	int		status;
+	int		end;
+	Uword		pc, acc, ix, flags;
+	IOBuf		ibuf, obuf;
+	Count		insns, cycles;
+	unsigned long long	memhash;
+	Uword		mem[MEMORY_SIZE];
+	char		diff[DIFFSIZE];		/* report of a failure */
+} Result;
+
+typedef struct worker {
+	pthread_t	thread;
+	Cpub		cpub;
+	IOBuf		input;
+	LoopDet		ld;
+} Worker;
+
+void	usage(char *);
+void	add_path(char *);
+void	add_file(char *);
+int	is_program(char *);
+void	*work(void *);
+int	run_program(Worker *, Result *);
+unsigned long long	mem_hash(Uword *);
+void	check_gold(Result *);
+void	diff_add(Result *, char *, ...);
+int	write_gold(Result *);
+double	now(void);
+
+Result		*results;
+int		nresults, results_size;
+long		budget = 10000000;	/* instructions per program */
+int		record;			/* -w */
+int		next_program;
+pthread_mutex_t	next_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t	asm_lock = PTHREAD_MUTEX_INITIALIZER;	/* asm_source() */
+
+
+/*=============================================================================
+ *   Corpus (program files, and directories searched recursively)
+ *===========================================================================*/
+void
+add_path(char *path)
+{
+	struct stat	st;
+	struct dirent	**names;
+	char		*p;
+	int		n, i;
+
+	if( stat(path,&st) != 0 ) {
+		fprintf(stderr,"Unable to open %s\n",path);
+		return;
+	}
+	if( !S_ISDIR(st.st_mode) ) {
+		add_file(path);
+		return;
+	}
+	if( (n = scandir(path,&names,NULL,alphasort)) < 0 )
+		return;
+	for( i = 0 ; i < n ; i++ ) {
+		if( names[i]->d_name[0] != '.' ) {
+			p = malloc(strlen(path) + strlen(names[i]->d_name) + 2);
+			sprintf(p,"%s/%s",path,names[i]->d_name);
+			if( stat(p,&st) == 0 && (S_ISDIR(st.st_mode)
+						 || is_program(p)) )
+				add_path(p);
+			else
+				free(p);
+		}
+		free(names[i]);
+	}
+	free(names);
+}
+
+
+void
+add_file(char *file)
+{
+	if( nresults == results_size ) {
+		results_size = results_size ? results_size * 2 : 256;
+		results = realloc(results,sizeof(Result) * results_size);
+		if( results == NULL ) {
+			fprintf(stderr,"Unable to allocate the results\n");
+			exit(1);
+		}
+	}
+	memset(&results[nresults],0,sizeof(Result));
+	results[nresults++].file = file;
+}
+
+
+/*
+ *   Files of a directory taken as programs: not the golden files nor
+ *   the by-products of the tools
+ */
+int
+is_program(char *file)
+{
+	static char	*skip[] = { ".gold", ".c", ".h", ".so", ".md", NULL };
+	char		*ext = strrchr(file,'.');
+	int		i;
+
+	for( i = 0 ; ext != NULL && skip[i] != NULL ; i++ )
+		if( !strcmp(ext,skip[i]) )
+			return 0;
+	return 1;
+}
+
+
+/*=============================================================================
+ *   Running (one program after another on each worker)
+ *===========================================================================*/
+void *
+work(void *arg)
+{
+	Worker	*w = arg;
+	Result	*r;
+	int	i;
+
+	mem_map(&w->cpub);
+	w->cpub.ibuf = &w->input;
+	while( 1 ) {
+		pthread_mutex_lock(&next_lock);
+		i = next_program++;
+		pthread_mutex_unlock(&next_lock);
+		if( i >= nresults )
+			break;
+		r = &results[i];
+		if( run_program(w,r) != 0 )
+			r->status = ERROR;
+		else if( record )
+			r->status = write_gold(r) == 0 ? PASS : ERROR;
+		else
+			check_gold(r);
+	}
+	return NULL;
+}
+
+
+int
+run_program(Worker *w, Result *r)
+{
+	Cpub	*cpub = &w->cpub;
+	char	*ext = strrchr(r->file,'.');
+	Count	n;
+	int	status;
+
+	text_private(cpub);
+	memset(cpub->mem,0,MEMORY_SIZE);
+	if( ext != NULL && !strcmp(ext,".s") ) {
+		pthread_mutex_lock(&asm_lock);
+		status = asm_file(cpub,r->file);
+		pthread_mutex_unlock(&asm_lock);
+	} else
+		status = read_mem_file(cpub,r->file);
+	if( status != 0 ) {
+		snprintf(r->diff,DIFFSIZE,"   unable to load the program\n");
+		return -1;
+	}
+	text_share(cpub);		/* with the workers on the same program */
+	cpub->pc = cpub->acc = cpub->ix = 0;
+	cpub->cf = cpub->vf = cpub->nf = cpub->zf = 0;
+	cpub->obuf.flag = cpub->obuf.buf = 0;
+	w->input.flag = w->input.buf = 0;
+	cpub->cycle = 0;
+
+	/*
+	 *   Nothing comes in from outside, so a repeated state is an
+	 *   infinite loop.  The states are looked at every LOOP_EVERY
+	 *   instructions, which still repeat.
+	 */
+	loop_start(&w->ld,cpub);
+	r->end = END_LIMIT;
+	for( n = 0 ; n < budget ; ) {
+		n++;
+		if( step_full(cpub) == RUN_HALT ) {
+			r->end = decrypt_instruction(cpub) == HLT ? END_HALT
+								  : END_INVALID;
+			break;
+		}
+		if( n % LOOP_EVERY == 0
+		    && loop_check_n(&w->ld,cpub,LOOP_EVERY) ) {
+			r->end = END_LOOP;
+			break;
+		}
+	}
+	r->pc = r->end <= END_INVALID ? cpub->mar : cpub->pc;
+	r->acc = cpub->acc;
+	r->ix = cpub->ix;
+	r->flags = PackedFlags(cpub);
+	r->ibuf = *cpub->ibuf;
+	r->obuf = cpub->obuf;
+	r->insns = n;
+	r->cycles = cpub->cycle;
+	memcpy(r->mem,TextOf(cpub),IMEMORY_SIZE);
+	memcpy(r->mem + IMEMORY_SIZE,cpub->mem + IMEMORY_SIZE,
+	       MEMORY_SIZE - IMEMORY_SIZE);
+	r->memhash = mem_hash(r->mem);
+	return 0;
+}
+
+
+unsigned long long
+mem_hash(Uword *mem)
+{
+	unsigned long long	h = 0xcbf29ce484222325ULL;	/* FNV-1a */
+	int			i;
+
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		h = (h ^ mem[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+
+/*=============================================================================
+ *   Compare with the Golden File
+ *
+ *	The loop and limit ends depend on when they are found, so the pc
+ *	and the counts are only compared for halts.
+ *===========================================================================*/
+#define	Expect(R,NAME,GOT,WANT,FMT)	\
+	do { if( (GOT) != (WANT) ) \
+		diff_add(R,"   %s: " FMT ", expected " FMT "\n",NAME,GOT,WANT); \
+	} while( 0 )
+
+void
+check_gold(Result *r)
+{
+	FILE		*fp;
+	char		gold[1024], line[256], key[32], *p;
+	unsigned int	v, f, a, words[16];
+	unsigned long long	h, count;
+	int		i, n, k, halted = r->end <= END_INVALID;
+
+	snprintf(gold,sizeof(gold),"%s.gold",r->file);
+	if( (fp = fopen(gold,"r")) == NULL ) {
+		r->status = NO_GOLD;
+		return;
+	}
+	while( fgets(line,sizeof(line),fp) != NULL ) {
+		if( line[0] == ';' )
+			continue;
+		if( sscanf(line,"mem %x:%n",&a,&n) == 1 ) {
+			for( p = line + n, k = 0 ; k < 16
+			     && sscanf(p,"%x%n",&words[k],&n) == 1 ; k++ )
+				p += n;
+			for( i = 0 ; i < k && a + i < MEMORY_SIZE ; i++ )
+				if( r->mem[a + i] != words[i] )
+					break;
+			if( i == k )
+				continue;
+			diff_add(r,"   mem %03x:",a);
+			for( i = 0 ; i < k ; i++ )
+				diff_add(r," %02x",a + i < MEMORY_SIZE
+						   ? r->mem[a + i] : 0);
+			diff_add(r,", expected");
+			for( i = 0 ; i < k ; i++ )
+				diff_add(r," %02x",words[i]);
+			diff_add(r,"\n");
+			continue;
+		}
+		for( p = line ; sscanf(p," %31[a-z]=%n",key,&n) == 1 ; ) {
+			p += n;
+			if( !strcmp(key,"end") ) {
+				for( k = 0 ; k < 4 ; k++ )
+					if( !strncmp(p,end_name[k],
+						     strlen(end_name[k])) )
+						break;
+				if( k != r->end )
+					diff_add(r,"   end: %s, expected %.*s\n",
+						 end_name[r->end],
+						 (int)strcspn(p," \n"),p);
+			} else if( !strcmp(key,"memhash") ) {
+				if( sscanf(p,"%llx",&h) == 1 && h != r->memhash )
+					diff_add(r,"   memory differs "
+						 "(memhash %016llx)\n",
+						 r->memhash);
+			} else if( !strcmp(key,"insns") || !strcmp(key,"cycles") ) {
+				if( halted && sscanf(p,"%llu",&count) == 1 ) {
+					if( key[0] == 'i' )
+						Expect(r,"insns",r->insns,count,"%llu");
+					else
+						Expect(r,"cycles",r->cycles,count,"%llu");
+				}
+			} else if( !strcmp(key,"ibuf") || !strcmp(key,"obuf") ) {
+				IOBuf	*b = key[0] == 'i' ? &r->ibuf : &r->obuf;
+
+				if( sscanf(p,"%u:%x",&f,&v) == 2
+				    && (b->flag != f || b->buf != v) )
+					diff_add(r,"   %s: %d:%02x, expected "
+						 "%u:%02x\n",key,b->flag,
+						 b->buf,f,v);
+			} else if( sscanf(p,"%x",&v) == 1 ) {
+				if( !strcmp(key,"pc") && halted )
+					Expect(r,"pc",r->pc,v,"%02x");
+				else if( !strcmp(key,"acc") )
+					Expect(r,"acc",r->acc,v,"%02x");
+				else if( !strcmp(key,"ix") )
+					Expect(r,"ix",r->ix,v,"%02x");
+				else if( !strcmp(key,"cf") )
+					Expect(r,"cf",r->flags >> 3 & 1,v,"%d");
+				else if( !strcmp(key,"vf") )
+					Expect(r,"vf",r->flags >> 2 & 1,v,"%d");
+				else if( !strcmp(key,"nf") )
+					Expect(r,"nf",r->flags >> 1 & 1,v,"%d");
+				else if( !strcmp(key,"zf") )
+					Expect(r,"zf",r->flags & 1,v,"%d");
+			}
+			p += strcspn(p," \n");
+		}
+	}
+	fclose(fp);
+	r->status = r->diff[0] ? FAIL : PASS;
+}
+
+
+void
+diff_add(Result *r, char *fmt, ...)
+{
+	va_list	ap;
+	size_t	n = strlen(r->diff);
+
+	va_start(ap,fmt);
+	vsnprintf(r->diff + n,DIFFSIZE - n,fmt,ap);
+	va_end(ap);
+}
+
+
+int
+write_gold(Result *r)
+{
+	FILE	*fp;
+	char	gold[1024], *p;
+	int	a, i;
+
+	snprintf(gold,sizeof(gold),"%s.gold",r->file);
+	if( (fp = fopen(gold,"w")) == NULL ) {
+		snprintf(r->diff,DIFFSIZE,"   unable to write the golden file\n");
+		return -1;
+	}
+	p = strrchr(r->file,'/');
+	fprintf(fp,"; golden output of %s (simtest -w)\n",p ? p + 1 : r->file);
+	fprintf(fp,"end=%s",end_name[r->end]);
+	if( r->end <= END_INVALID )
+		fprintf(fp," pc=%02x",r->pc);
+	fprintf(fp,"\nacc=%02x ix=%02x cf=%d vf=%d nf=%d zf=%d\n",
+		r->acc,r->ix,r->flags >> 3 & 1,r->flags >> 2 & 1,
+		r->flags >> 1 & 1,r->flags & 1);
+	fprintf(fp,"ibuf=%d:%02x obuf=%d:%02x\n",r->ibuf.flag,r->ibuf.buf,
+		r->obuf.flag,r->obuf.buf);
+	if( r->end <= END_INVALID )
+		fprintf(fp,"insns=%llu cycles=%llu\n",r->insns,r->cycles);
+	for( a = 0 ; a < MEMORY_SIZE ; a += 16 ) {
+		for( i = 0 ; i < 16 && r->mem[a + i] == 0 ; i++ )
+			;
+		if( i == 16 )
+			continue;
+		fprintf(fp,"mem %03x:",a);
+		for( i = 0 ; i < 16 ; i++ )
+			fprintf(fp," %02x",r->mem[a + i]);
+		fprintf(fp,"\n");
+	}
+	fprintf(fp,"memhash=%016llx\n",r->memhash);
+	fclose(fp);
+	return 0;
+}
+
+
+double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program-file|directory ...\n"
+		"   -w\t\t--- write the golden files from the results\n"
+		"   -b count\t--- instructions per program (default: 10000000)\n"
+		"   -j threads\t--- number of threads (default: all cores)\n"
+		"   -v\t\t--- also list the programs passed\n",prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	Worker		*workers;
+	Result		*r;
+	Cpub		dummy;
+	int		nthreads, verbose = 0, opt, i;
+	int		count[4] = { 0, 0, 0, 0 };
+	double		start;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	while( (opt = getopt(argc,argv,"wb:j:v")) != -1 ) {
+		switch( opt ) {
+		   case 'w':	record = 1; break;
+		   case 'b':	budget = atol(optarg); break;
+		   case 'j':	nthreads = atoi(optarg); break;
+		   case 'v':	verbose = 1; break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind == argc || nthreads < 1 ) {
+		usage(argv[0]);
+		return 1;
+	}
+	for( i = optind ; i < argc ; i++ )
+		add_path(argv[i]);
+	if( nthreads > nresults )
+		nthreads = nresults ? nresults : 1;
+
+	start = now();
+	err_mesg_off = 1;
+	memset(&dummy,0,sizeof(dummy));
+	mem_map(&dummy);
+	state_hash_init(&dummy);		/* the keys, before the threads */
+	workers = calloc(nthreads,sizeof(Worker));
+	for( i = 0 ; i < nthreads ; i++ )
+		pthread_create(&workers[i].thread,NULL,work,&workers[i]);
+	for( i = 0 ; i < nthreads ; i++ )
+		pthread_join(workers[i].thread,NULL);
+
+	for( i = 0 ; i < nresults ; i++ ) {
+		r = &results[i];
+		count[r->status]++;
+		switch( r->status ) {
+		   case PASS:
+			if( verbose )
+				printf("ok    %s\n",r->file);
+			break;
+		   case FAIL:
+			printf("FAIL  %s\n%s",r->file,r->diff);
+			break;
+		   case NO_GOLD:
+			if( verbose )
+				printf("--    %s (no golden file)\n",r->file);
+			break;
+		   case ERROR:
+			printf("ERROR %s\n%s",r->file,r->diff);
+			break;
+		}
+	}
+	printf("%d programs%s: %d passed, %d failed, %d without golden file, "
+	       "%d errors in %.2f s (%d threads)\n",nresults,
+	       record ? " recorded" : "",count[PASS],count[FAIL],
+	       count[NO_GOLD],count[ERROR],now() - start,nthreads);
+	return count[FAIL] || count[ERROR] ? 1 : 0;
+}
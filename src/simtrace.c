@@ -0,0 +1,254 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simtrace.c
+ *	Descrioption:	trace decoder (binary trace to text or Chrome JSON)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+
+
+/*=============================================================================
+ *   Decoded Record
+ *===========================================================================*/
+typedef struct record {
+	unsigned char	mask;
+	Uword	pc, ir, opr;
+	Uword	acc, ix, flags, io, obuf;
+	Addr	wa;
+	Uword	wv;
+	Uword	ibuf;			/* state records only */
+	Uword	mem[MEMORY_SIZE];
+} Record;
+
+int	read_record(FILE *, Record *);
+void	print_text(unsigned long long, Record *);
+void	print_state(Record *);
+void	print_json(unsigned long long, Record *, int, int);
+void	print_json_state(unsigned long long, Record *, int, int);
+void	usage(char *);
+
+
+/*=============================================================================
+ *   Read a Record
+ *===========================================================================*/
+#define	GetByte(FP,V)	do { int c_ = getc(FP); \
+			     if( c_ == EOF ) \
+				return 0; \
+			     (V) = c_; } while(0)
+
+int
+read_record(FILE *fp, Record *r)
+{
+	int	c;
+
+	if( (c = getc(fp)) == EOF )
+		return 0;
+	r->mask = c;
+	if( r->mask == TR_SNAP ) {
+		GetByte(fp,r->pc);
+		GetByte(fp,r->acc);
+		GetByte(fp,r->ix);
+		GetByte(fp,r->flags);
+		GetByte(fp,r->io);
+		GetByte(fp,r->obuf);
+		GetByte(fp,r->ibuf);
+		if( fread(r->mem,1,MEMORY_SIZE,fp) != MEMORY_SIZE )
+			return 0;
+		return 1;
+	}
+	if( r->mask & TR_PC )	GetByte(fp,r->pc);
+	GetByte(fp,r->ir);
+	if( r->mask & TR_OPR )	GetByte(fp,r->opr);
+	if( r->mask & TR_ACC )	GetByte(fp,r->acc);
+	if( r->mask & TR_IX )	GetByte(fp,r->ix);
+	if( r->mask & TR_FLAGS )	GetByte(fp,r->flags);
+	if( r->mask & TR_IO ) {
+		GetByte(fp,r->io);
+		GetByte(fp,r->obuf);
+	}
+	if( r->mask & TR_MEM ) {
+		Uword	lo, hi;
+		GetByte(fp,lo);
+		GetByte(fp,hi);
+		GetByte(fp,r->wv);
+		r->wa = lo | hi << 8;
+	}
+	return 1;
+}
+
+
+/*=============================================================================
+ *   Output Formats
+ *===========================================================================*/
+void
+print_text(unsigned long long n, Record *r)
+{
+	printf("%llu\tpc=%02x ir=%02x",n,r->pc,r->ir);
+	if( r->mask & TR_OPR )
+		printf(" %02x",r->opr);
+	else
+		printf("   ");
+	printf("  %-4s",mnemonic(r->ir));
+	if( r->mask & TR_ACC )	printf(" acc=%02x",r->acc);
+	if( r->mask & TR_IX )	printf(" ix=%02x",r->ix);
+	if( r->mask & TR_FLAGS )
+		printf(" cf=%d vf=%d nf=%d zf=%d",(r->flags >> 3) & 1,
+			(r->flags >> 2) & 1,(r->flags >> 1) & 1,r->flags & 1);
+	if( r->mask & TR_IO )
+		printf(" of=%d if=%d obuf=%02x",r->io & 1,(r->io >> 1) & 1,
+			r->obuf);
+	if( r->mask & TR_MEM )
+		printf(" mem[%03x]=%02x",r->wa,r->wv);
+	if( r->mask & TR_HALT )
+		printf(" halt");
+	printf("\n");
+}
+
+
+void
+print_state(Record *r)
+{
+	int	a;
+
+	printf("state\tpc=%02x acc=%02x ix=%02x cf=%d vf=%d nf=%d zf=%d "
+		"of=%d if=%d obuf=%02x ibuf=%02x\n",r->pc,r->acc,r->ix,
+		(r->flags >> 3) & 1,(r->flags >> 2) & 1,(r->flags >> 1) & 1,
+		r->flags & 1,r->io & 1,(r->io >> 1) & 1,r->obuf,r->ibuf);
+	for( a = 0 ; a < MEMORY_SIZE ; a++ ) {
+		if( a % 16 == 0 )
+			printf("\t%03x:",a);
+		printf(" %02x%s",r->mem[a],(a % 16) == 15 ? "\n" : "");
+	}
+}
+
+
+/*
+ *   Chrome/Perfetto trace event format: one complete ("X") event per
+ *   instruction with the instruction count as the time stamp, and
+ *   counter ("C") events for the registers.
+ */
+void
+print_json(unsigned long long n, Record *r, int board, int first)
+{
+	printf("%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":1,"
+		"\"pid\":0,\"tid\":%d,\"args\":{\"pc\":%d,\"ir\":%d",
+		first ? "" : ",\n",mnemonic(r->ir),n,board,r->pc,r->ir);
+	if( r->mask & TR_OPR )
+		printf(",\"opr\":%d",r->opr);
+	if( r->mask & TR_MEM )
+		printf(",\"addr\":%d,\"value\":%d",r->wa,r->wv);
+	printf("}}");
+	if( r->mask & (TR_ACC|TR_IX) )
+		printf(",\n{\"name\":\"regs\",\"ph\":\"C\",\"ts\":%llu,"
+			"\"pid\":0,\"tid\":%d,\"args\":{\"acc\":%d,\"ix\":%d}}",
+			n,board,r->acc,r->ix);
+}
+
+
+/*
+ *   A state record: an instant ("i") event with the registers and the
+ *   memory as a hex string, and the register counters
+ */
+void
+print_json_state(unsigned long long n, Record *r, int board, int first)
+{
+	int	a;
+
+	printf("%s{\"name\":\"state\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,"
+		"\"pid\":0,\"tid\":%d,\"args\":{\"pc\":%d,\"acc\":%d,"
+		"\"ix\":%d,\"flags\":%d,\"io\":%d,\"obuf\":%d,\"ibuf\":%d,"
+		"\"mem\":\"",first ? "" : ",\n",n,board,r->pc,r->acc,r->ix,
+		r->flags,r->io,r->obuf,r->ibuf);
+	for( a = 0 ; a < MEMORY_SIZE ; a++ )
+		printf("%02x",r->mem[a]);
+	printf("\"}},\n{\"name\":\"regs\",\"ph\":\"C\",\"ts\":%llu,"
+		"\"pid\":0,\"tid\":%d,\"args\":{\"acc\":%d,\"ix\":%d}}",
+		n,board,r->acc,r->ix);
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [-j] trace-file\n"
+		"   -j\t--- Chrome/Perfetto trace event JSON "
+		"(default: text)\n",prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	FILE			*fp;
+	unsigned char		header[TRACE_HEADER_SIZE];
+	Record			r;
+	unsigned long long	n;
+	int			json = 0, board, first = 1;
+	Uword			next_pc;
+
+	if( argc == 3 && !strcmp(argv[1],"-j") )
+		json = 1;
+	else if( argc != 2 ) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if( (fp = fopen(argv[argc-1],"rb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",argv[argc-1]);
+		return 1;
+	}
+	if( fread(header,1,TRACE_HEADER_SIZE,fp) != TRACE_HEADER_SIZE
+	    || memcmp(header,TRACE_MAGIC,8) || header[8] != TRACE_VERSION ) {
+		fprintf(stderr,"%s: not a trace file\n",argv[argc-1]);
+		fclose(fp);
+		return 1;
+	}
+	board = header[9];
+
+	/*
+	 *   A state record gives the registers and the memory (after the
+	 *   header and whenever they were changed by hand); every other
+	 *   record carries the changes
+	 */
+	memset(&r,0,sizeof(r));
+	next_pc = 0;
+	if( json )
+		printf("{\"traceEvents\":[\n");
+	for( n = 0 ; read_record(fp,&r) ; first = 0 ) {
+		if( r.mask == TR_SNAP ) {
+			if( json )
+				print_json_state(n,&r,board,first);
+			else
+				print_state(&r);
+			next_pc = r.pc;
+			continue;
+		}
+		if( !(r.mask & TR_PC) )
+			r.pc = next_pc;
+		if( json )
+			print_json(n,&r,board,first);
+		else
+			print_text(n,&r);
+
+		/*
+		 *   Taken branches and jumps show up as an explicit pc
+		 *   in the next record.
+		 */
+		next_pc = r.pc + ((r.mask & TR_OPR) ? 2 : 1);
+		n++;
+	}
+	if( json )
+		printf("\n]}\n");
+
+	fclose(fp);
+	return 0;
+}
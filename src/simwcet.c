@@ -0,0 +1,976 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	simwcet.c
+ *	Descrioption:	static worst-case execution time analyzer
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	"cpuboard.h"
+#include	"isa.h"
+
+
+/*=============================================================================
+ *   Analysis
+ *
+ *	Routines are address 0 (the main program) and the targets of JAL;
+ *	JR returns.  The control-flow graph of a routine is built from the
+ *	decode table.  Its loops are the natural loops of the back edges;
+ *	the bound of a loop is the number of times its header runs, given
+ *	by -l or found by induction:
+ *
+ *	    the only write to a register r (acc or ix) in the loop is
+ *	    ADD/SUB r,imm on every iteration, and a BZ/BNZ on every
+ *	    iteration leaves the loop when r equals a value that does not
+ *	    change in the loop (CMP r,X or the flags of the ADD/SUB)
+ *
+ *	The initial value of r and X come from a constant propagation of
+ *	acc, ix and the memory.  A loop is then one node costing bound x
+ *	its longest iteration, innermost first, and the worst case of a
+ *	routine is its longest path.  Instructions and cycles are maximized
+ *	separately.  A JAL costs the worst case of the routine called.
+ *===========================================================================*/
+#define	UNKNOWN		(-1)
+#define	UNBOUNDED	(~0ULL)
+#define	LOOP_MAX	IMEMORY_SIZE
+
+/* [IX+d] reaches the data region past 0xff; (IX+d) wraps in it */
+#define	IxAddr(B,D,X)	((B) == IX_MOD_ADDR_DATA ? 0x100 + (((D) + (X)) & 0xff) \
+						 : (D) + ((X) & 0xff))
+
+typedef struct cost {
+	Count	insns, cycles;
+} Cost;
+
+typedef struct insn {
+	Uword	ir, opr, len, code, a, b;
+	int	nsucc;
+	Uword	succ[2];
+} Insn;
+
+typedef struct state {
+	int	reached;
+	short	acc, ix;
+	short	mem[MEMORY_SIZE];
+} State;
+
+typedef struct set {
+	unsigned long long	w[IMEMORY_SIZE / 64];
+} Set;
+
+typedef struct loop {
+	Uword	header;
+	Set	body;
+	Count	bound;
+	Cost	cost;
+	char	why[80];
+} Loop;
+
+typedef struct routine {
+	Uword	entry;
+	int	done, busy;
+	Set	nodes;
+	Cost	wcet;
+	int	nloop;
+	Loop	*loop;
+	int	writes_ix;		/* with the routines it calls */
+	int	writes_any;		/* indexed store */
+	Uword	writes[MEMORY_SIZE];	/* absolute stores */
+	char	note[160];
+} Routine;
+
+Cpub	cpub;
+Insn	insn[IMEMORY_SIZE];
+Routine	*routine[IMEMORY_SIZE];
+Count	annotation[IMEMORY_SIZE];	/* -l: bound (0: none) */
+int	data_unknown;			/* -d */
+int	unbounded;
+
+/* per routine (the one being analyzed) */
+State	ins[IMEMORY_SIZE];		/* state before each instruction */
+Uword	reach[IMEMORY_SIZE][MEMORY_SIZE];	/* indexed ST: addresses */
+int	nreach[IMEMORY_SIZE];		/* (0: any) */
+int	refined;			/* new addresses found */
+Set	dom[IMEMORY_SIZE];
+int	npred[IMEMORY_SIZE];
+Uword	pred[IMEMORY_SIZE][IMEMORY_SIZE];
+int	top[IMEMORY_SIZE];		/* outermost loop analyzed (-1) */
+Cost	memo[IMEMORY_SIZE + LOOP_MAX];	/* nodes, then loops */
+int	visit[IMEMORY_SIZE + LOOP_MAX];	/* 1: on the path, 2: done */
+
+void	decode(void);
+Routine	*analyze(Uword);
+void	propagate(Routine *);
+void	transfer(State *, Uword);
+int	address(State *, Insn *);
+int	operand(State *, Insn *);
+int	dest(Uword, Routine *);
+void	dominators(Routine *);
+void	find_loops(Routine *);
+void	bound_loop(Routine *, Loop *);
+int	induction(Routine *, Loop *, Uword);
+int	unchanged(Loop *, int, int, int, int, Count);
+void	store_range(Loop *, int, int, Count);
+Cost	longest(Routine *, Loop *, int);
+Cost	node_cost(Routine *, int);
+void	report(Routine *);
+void	unreachable(void);
+void	usage(char *);
+
+#define	SetHas(S,A)	(((S)->w[(A) >> 6] >> ((A) & 63)) & 1)
+#define	SetAdd(S,A)	((S)->w[(A) >> 6] |= 1ULL << ((A) & 63))
+
+
+/*=============================================================================
+ *   Saturating Arithmetic of the Costs
+ *===========================================================================*/
+static Count
+sat_add(Count a, Count b)
+{
+	return (a == UNBOUNDED || b == UNBOUNDED || a + b < a) ? UNBOUNDED
+							      : a + b;
+}
+
+
+static Count
+sat_mul(Count a, Count b)
+{
+	if( a == 0 || b == 0 )
+		return 0;
+	return (a == UNBOUNDED || b == UNBOUNDED || a > UNBOUNDED / b)
+		? UNBOUNDED : a * b;
+}
+
+
+static Cost
+cost_add(Cost x, Cost y)
+{
+	x.insns = sat_add(x.insns,y.insns);
+	x.cycles = sat_add(x.cycles,y.cycles);
+	return x;
+}
+
+
+static Cost
+cost_max(Cost x, Cost y)
+{
+	if( y.insns > x.insns ) x.insns = y.insns;
+	if( y.cycles > x.cycles ) x.cycles = y.cycles;
+	return x;
+}
+
+
+/*=============================================================================
+ *   Instructions and Their Successors
+ *===========================================================================*/
+void
+decode(void)
+{
+	Insn		*p;
+	const Decode	*d;
+	int		a;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		p = &insn[a];
+		p->ir = cpub.mem[a];
+		p->opr = cpub.mem[(a + 1) & 0xff];
+		d = &isa_decode[p->ir];
+		p->len = d->len;
+		p->code = d->code;
+		p->a = d->a;
+		p->b = d->b;
+		p->nsucc = 0;
+		switch( p->code ) {
+		   case HLT: case JR: case INVALID:
+			break;
+		   case Bbc:
+			p->succ[p->nsucc++] = p->opr;
+			if( d->sub != 0x00 && p->opr != ((a + p->len) & 0xff) )
+				p->succ[p->nsucc++] = (a + p->len) & 0xff;
+			break;
+		   case ST:
+			if( p->b < ABS_ADDR_TEXT )
+				break;		/* error: halts */
+			p->succ[p->nsucc++] = (a + p->len) & 0xff;
+			break;
+		   default:		/* JAL returns to the next one */
+			p->succ[p->nsucc++] = (a + p->len) & 0xff;
+			break;
+		}
+	}
+}
+
+
+/*
+ *   Register written by the instruction at a: 1 acc, 2 ix, 3 both
+ */
+int
+dest(Uword a, Routine *callee)
+{
+	Insn	*p = &insn[a];
+
+	switch( p->code ) {
+	   case LD: case ADD: case ADC: case SUB: case SBC:
+	   case AND: case OR: case EOR: case Ssm: case Rsm:
+		return p->a ? 2 : 1;
+	   case IN:
+		return 1;
+	   case JAL:
+		return (callee == NULL || callee->writes_ix) ? 3 : 1;
+	}
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Routine Analysis
+ *===========================================================================*/
+Routine *
+analyze(Uword entry)
+{
+	Routine	*r = routine[entry];
+	Routine	*callee;
+	Uword	work[IMEMORY_SIZE];
+	int	n = 0, a, i, k;
+
+	if( r == NULL ) {
+		r = routine[entry] = calloc(1,sizeof(Routine));
+		r->entry = entry;
+	}
+	if( r->done || r->busy )
+		return r;		/* busy: recursion */
+	r->busy = 1;
+
+	/*
+	 *   Nodes; the routines called are analyzed first
+	 */
+	SetAdd(&r->nodes,entry);
+	work[n++] = entry;
+	while( n > 0 ) {
+		a = work[--n];
+		for( i = 0 ; i < insn[a].nsucc ; i++ )
+			if( !SetHas(&r->nodes,insn[a].succ[i]) ) {
+				SetAdd(&r->nodes,insn[a].succ[i]);
+				work[n++] = insn[a].succ[i];
+			}
+	}
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !SetHas(&r->nodes,a) )
+			continue;
+		if( insn[a].code == JAL ) {
+			callee = analyze(insn[a].opr);
+			if( callee->busy ) {
+				sprintf(r->note,"recursive call at 0x%02x",a);
+				callee->writes_ix = callee->writes_any = 1;
+			}
+			r->writes_ix |= callee->writes_ix;
+			r->writes_any |= callee->writes_any;
+			for( k = 0 ; k < MEMORY_SIZE ; k++ )
+				r->writes[k] |= callee->writes[k];
+		}
+		if( dest(a,NULL) & 2 && insn[a].code != JAL )
+			r->writes_ix = 1;
+		if( insn[a].code == ST ) {
+			if( insn[a].b >= IX_MOD_ADDR_TEXT )
+				r->writes_any = 1;
+			else if( insn[a].b >= ABS_ADDR_TEXT )
+				r->writes[address(NULL,&insn[a])] = 1;
+		}
+	}
+
+	/*
+	 *   Predecessors, constants, dominators and loops
+	 */
+	memset(npred,0,sizeof(npred));
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( SetHas(&r->nodes,a) )
+			for( i = 0 ; i < insn[a].nsucc ; i++ ) {
+				k = insn[a].succ[i];
+				pred[k][npred[k]++] = a;
+			}
+	dominators(r);
+	find_loops(r);
+
+	/*
+	 *   Bounds; the counters of the loops bound the addresses of their
+	 *   indexed stores, which may bound other loops
+	 */
+	memset(nreach,0,sizeof(nreach));
+	for( k = 0 ; k < 4 ; k++ ) {
+		propagate(r);
+		for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+			top[a] = -1;
+		refined = 0;
+		for( i = 0 ; i < r->nloop ; i++ ) {
+			bound_loop(r,&r->loop[i]);
+			for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+				if( SetHas(&r->loop[i].body,a) )
+					top[a] = i;
+		}
+		if( !refined )
+			break;
+	}
+
+	/*
+	 *   Worst cases: each loop becomes one node, innermost first
+	 */
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		top[a] = -1;
+	for( i = 0 ; i < r->nloop ; i++ ) {
+		memset(visit,0,sizeof(visit));
+		r->loop[i].cost = longest(r,&r->loop[i],r->loop[i].header);
+		r->loop[i].cost.insns = sat_mul(r->loop[i].cost.insns,
+						r->loop[i].bound);
+		r->loop[i].cost.cycles = sat_mul(r->loop[i].cost.cycles,
+						 r->loop[i].bound);
+		for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+			if( SetHas(&r->loop[i].body,a) )
+				top[a] = i;
+	}
+	memset(visit,0,sizeof(visit));
+	r->wcet = longest(r,NULL,top[entry] >= 0 ? IMEMORY_SIZE + top[entry]
+						 : entry);
+	if( r->note[0] )
+		r->wcet.insns = r->wcet.cycles = UNBOUNDED;
+
+	r->busy = 0;
+	r->done = 1;
+	return r;
+}
+
+
+/*=============================================================================
+ *   Constant Propagation (acc, ix and the memory)
+ *
+ *	The main program starts with the memory loaded (-d: the data
+ *	region unknown), other routines with the text area only.
+ *===========================================================================*/
+static int
+join(State *s, State *t)
+{
+	int	changed = 0, i;
+
+	if( !s->reached ) {
+		*s = *t;
+		return 1;
+	}
+#define	Join(X)	if( s->X != t->X && s->X != UNKNOWN ) \
+			{ s->X = UNKNOWN; changed = 1; }
+	Join(acc);
+	Join(ix);
+	for( i = 0 ; i < MEMORY_SIZE ; i++ ) {
+		Join(mem[i]);
+	}
+	return changed;
+}
+
+
+void
+propagate(Routine *r)
+{
+	static State	out;
+	Uword	work[IMEMORY_SIZE * 4];
+	int	n = 0, a, i;
+
+	memset(ins,0,sizeof(ins));
+	ins[r->entry].reached = 1;
+	ins[r->entry].acc = ins[r->entry].ix = UNKNOWN;
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		ins[r->entry].mem[i] = (i < IMEMORY_SIZE
+				       || (r->entry == 0 && !data_unknown))
+					? cpub.mem[i] : UNKNOWN;
+	work[n++] = r->entry;
+	while( n > 0 ) {
+		a = work[--n];
+		out = ins[a];
+		transfer(&out,a);
+		for( i = 0 ; i < insn[a].nsucc ; i++ )
+			if( join(&ins[insn[a].succ[i]],&out)
+			    && n < IMEMORY_SIZE * 4 )
+				work[n++] = insn[a].succ[i];
+	}
+}
+
+
+/*
+ *   Memory operand address (-1: unknown); s == NULL: absolute only
+ */
+int
+address(State *s, Insn *p)
+{
+	switch( p->b ) {
+	   case ABS_ADDR_TEXT:	return p->opr;
+	   case ABS_ADDR_DATA:	return 0x100 + p->opr;
+	   case IX_MOD_ADDR_TEXT:
+	   case IX_MOD_ADDR_DATA:
+		if( s == NULL || s->ix == UNKNOWN )
+			return -1;
+		return IxAddr(p->b,p->opr,s->ix);
+	}
+	return -1;
+}
+
+
+int
+operand(State *s, Insn *p)
+{
+	int	a;
+
+	switch( p->b ) {
+	   case ACC:		return s->acc;
+	   case IX:		return s->ix;
+	   case IMMEDIATE_ADDR:	return p->opr;
+	}
+	return (a = address(s,p)) < 0 ? UNKNOWN : s->mem[a];
+}
+
+
+void
+transfer(State *s, Uword a)
+{
+	Insn	*p = &insn[a];
+	Routine	*callee;
+	short	*r = p->a ? &s->ix : &s->acc;
+	int	x = *r, y = operand(s,p), i, m;
+	int	same = (p->b == ACC && !p->a) || (p->b == IX && p->a);
+
+	switch( p->code ) {
+	   case LD:	*r = y; break;
+	   case ST:
+		if( (m = address(s,p)) >= 0 )
+			s->mem[m] = x;
+		else
+			for( i = 0 ; i < MEMORY_SIZE ; i++ )
+				if( !nreach[a] || reach[a][i] )
+					s->mem[i] = UNKNOWN;
+		break;
+	   case ADD:	*r = (x < 0 || y < 0) ? UNKNOWN : (x + y) & 0xff; break;
+	   case SUB:	*r = same ? 0 : (x < 0 || y < 0) ? UNKNOWN
+							 : (x - y) & 0xff;
+		break;
+	   case AND:	*r = (x < 0 || y < 0) ? UNKNOWN : x & y; break;
+	   case OR:	*r = (x < 0 || y < 0) ? UNKNOWN : x | y; break;
+	   case EOR:	*r = same ? 0 : (x < 0 || y < 0) ? UNKNOWN : x ^ y;
+		break;
+	   case ADC: case SBC: case Ssm: case Rsm:
+		*r = UNKNOWN;
+		break;
+	   case IN:	s->acc = UNKNOWN; break;
+	   case JAL:
+		s->acc = (a + p->len) & 0xff;	/* JR returns with it */
+		callee = routine[p->opr];
+		if( callee == NULL || callee->writes_ix )
+			s->ix = UNKNOWN;
+		for( i = 0 ; i < MEMORY_SIZE ; i++ )
+			if( callee == NULL || callee->writes_any
+			    || callee->writes[i] )
+				s->mem[i] = UNKNOWN;
+		break;
+	}
+}
+
+
+/*=============================================================================
+ *   Dominators
+ *===========================================================================*/
+void
+dominators(Routine *r)
+{
+	Set	t;
+	int	a, i, k, changed;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		dom[a] = r->nodes;
+	memset(&dom[r->entry],0,sizeof(Set));
+	SetAdd(&dom[r->entry],r->entry);
+	do {
+		changed = 0;
+		for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+			if( !SetHas(&r->nodes,a) || a == r->entry )
+				continue;
+			t = r->nodes;
+			for( i = 0 ; i < npred[a] ; i++ )
+				for( k = 0 ; k < IMEMORY_SIZE / 64 ; k++ )
+					t.w[k] &= dom[pred[a][i]].w[k];
+			SetAdd(&t,a);
+			if( memcmp(&t,&dom[a],sizeof(Set)) ) {
+				dom[a] = t;
+				changed = 1;
+			}
+		}
+	} while( changed );
+}
+
+
+/*=============================================================================
+ *   Natural Loops (innermost first)
+ *
+ *	One loop per header.  An irreducible graph has a cycle without
+ *	a back edge, found by longest().
+ *===========================================================================*/
+static int
+loop_size(const void *x, const void *y)
+{
+	const Loop	*p = x, *q = y;
+	int		i, m = 0, n = 0;
+
+	for( i = 0 ; i < IMEMORY_SIZE ; i++ ) {
+		m += SetHas(&p->body,i);
+		n += SetHas(&q->body,i);
+	}
+	return m - n;
+}
+
+
+void
+find_loops(Routine *r)
+{
+	Uword	work[IMEMORY_SIZE];
+	Loop	*l;
+	int	a, h, i, n, p;
+
+	r->loop = calloc(LOOP_MAX,sizeof(Loop));
+	for( h = 0 ; h < IMEMORY_SIZE ; h++ ) {
+		if( !SetHas(&r->nodes,h) )
+			continue;
+		l = NULL;
+		for( i = 0 ; i < npred[h] ; i++ ) {
+			a = pred[h][i];
+			if( !SetHas(&dom[a],h) )
+				continue;	/* not a back edge */
+			if( l == NULL ) {
+				l = &r->loop[r->nloop++];
+				l->header = h;
+				SetAdd(&l->body,h);
+			}
+			n = 0;
+			if( !SetHas(&l->body,a) ) {
+				SetAdd(&l->body,a);
+				work[n++] = a;
+			}
+			while( n > 0 ) {
+				a = work[--n];
+				for( p = 0 ; p < npred[a] ; p++ )
+					if( !SetHas(&l->body,pred[a][p]) ) {
+						SetAdd(&l->body,pred[a][p]);
+						work[n++] = pred[a][p];
+					}
+			}
+		}
+	}
+	qsort(r->loop,r->nloop,sizeof(Loop),loop_size);
+}
+
+
+/*=============================================================================
+ *   Loop Bounds
+ *===========================================================================*/
+void
+bound_loop(Routine *r, Loop *l)
+{
+	int	a;
+
+	if( annotation[l->header] ) {
+		l->bound = annotation[l->header];
+		strcpy(l->why,"annotated");
+		return;
+	}
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( SetHas(&l->body,a) && induction(r,l,a) )
+			return;
+	l->bound = UNBOUNDED;
+	strcpy(l->why,"unbounded");
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( SetHas(&l->body,a) && insn[a].code == Bbc
+		    && isa_decode[insn[a].ir].poll ) {
+			sprintf(l->why,"unbounded: %s at 0x%02x waits for the "
+				"other board",isa_decode[insn[a].ir].name,a);
+			break;
+		}
+	if( l->why[9] == '\0' )
+		strcpy(l->why,"unbounded: no induction variable found");
+}
+
+
+/*
+ *   Try the BZ/BNZ at t as the exit test of the loop
+ */
+int
+induction(Routine *r, Loop *l, Uword t)
+{
+	Insn	*p = &insn[t], *q;
+	Uword	exit_taken, f, u = 0;
+	int	reg, x, v0 = UNKNOWN, step, before, nu = 0;
+	int	a, i, w;
+	Count	n;
+	static State	out;
+	State	entry;
+
+	/*
+	 *   The test: BZ leaving the loop, or BNZ staying in it; executed
+	 *   on every iteration, after the flags of its only predecessor
+	 */
+	if( p->code != Bbc || top[t] >= 0 || p->nsucc != 2 )
+		return 0;
+	if( SetHas(&l->body,p->succ[0]) == SetHas(&l->body,p->succ[1]) )
+		return 0;
+	exit_taken = !SetHas(&l->body,p->succ[0]);
+	if( !((isa_decode[p->ir].sub == 0x9 && exit_taken)
+	      || (isa_decode[p->ir].sub == 0x1 && !exit_taken)) )
+		return 0;
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( SetHas(&l->body,a) && insn[a].nsucc > 0
+		    && (insn[a].succ[0] == l->header
+			|| (insn[a].nsucc == 2 && insn[a].succ[1] == l->header))
+		    && !SetHas(&dom[a],t) )
+			return 0;	/* a latch not behind the test */
+	if( SetHas(&l->body,l->header) && npred[t] != 1 )
+		return 0;
+	f = pred[t][0];
+	q = &insn[f];
+	reg = q->a ? 2 : 1;
+
+	/*
+	 *   The counter: its only write in the loop is ADD/SUB r,imm
+	 */
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !SetHas(&l->body,a) )
+			continue;
+		w = dest(a,insn[a].code == JAL ? routine[insn[a].opr] : NULL);
+		if( !(w & reg) )
+			continue;
+		u = a;
+		nu++;
+	}
+	if( nu != 1 || top[u] >= 0 || insn[u].b != IMMEDIATE_ADDR
+	    || (insn[u].code != ADD && insn[u].code != SUB)
+	    || (insn[u].a ? 2 : 1) != reg )
+		return 0;
+	step = insn[u].code == ADD ? insn[u].opr : -insn[u].opr;
+
+	if( q->code == CMP && q->b >= IMMEDIATE_ADDR && q->b <= ABS_ADDR_DATA )
+		;
+	else if( f != u )
+		return 0;
+	if( f == u || SetHas(&dom[t],u) )
+		before = 1;
+	else if( SetHas(&dom[u],t) )
+		before = 0;
+	else
+		return 0;
+
+	/*
+	 *   The initial value and the value compared with
+	 */
+	memset(&entry,0,sizeof(entry));
+	for( i = 0 ; i < npred[l->header] ; i++ ) {
+		a = pred[l->header][i];
+		if( SetHas(&l->body,a) || !ins[a].reached )
+			continue;
+		out = ins[a];
+		transfer(&out,a);
+		join(&entry,&out);
+	}
+	if( l->header == r->entry && !entry.reached )
+		return 0;
+	if( entry.reached )
+		v0 = reg == 2 ? entry.ix : entry.acc;
+	if( v0 == UNKNOWN )
+		return 0;
+	if( f == u )
+		x = 0;
+	else if( q->b == IMMEDIATE_ADDR )
+		x = q->opr;
+	else if( (x = entry.mem[address(NULL,q)]) == UNKNOWN )
+		return 0;
+
+	/*
+	 *   Iterations: the header runs until r == x at the test
+	 */
+	for( n = 1 ; n <= 256 ; n++ )
+		if( ((v0 + step * (int)(before ? n : n - 1)) & 0xff) == x )
+			break;
+	if( n > 256 ) {
+		sprintf(l->why,"never leaves through 0x%02x",t);
+		return 0;
+	}
+	if( f != u && !unchanged(l,address(NULL,q),reg,v0,step,n) )
+		return 0;
+
+	l->bound = n;
+	if( reg == 2 )
+		store_range(l,v0,step,n);
+	sprintf(l->why,"induction on %s (0x%02x, step %d, exit at 0x%02x)",
+		reg == 2 ? "IX" : "ACC",v0,step,t);
+	return 1;
+}
+
+
+/*
+ *   Addresses of the indexed stores of the loop counting on ix
+ */
+void
+store_range(Loop *l, int v0, int step, Count n)
+{
+	int	a, m;
+	Count	k;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !SetHas(&l->body,a) || insn[a].code != ST
+		    || insn[a].b < IX_MOD_ADDR_TEXT || nreach[a] )
+			continue;
+		for( k = 0 ; k <= n ; k++ ) {
+			m = IxAddr(insn[a].b,insn[a].opr,v0 + step * (int)k);
+			if( !reach[a][m] ) {
+				reach[a][m] = 1;
+				nreach[a]++;
+			}
+		}
+		refined = 1;
+	}
+}
+
+
+/*
+ *   1 if nothing in the loop stores at m while the counter runs
+ *   through its values
+ */
+int
+unchanged(Loop *l, int m, int reg, int v0, int step, Count n)
+{
+	Insn	*p;
+	Routine	*callee;
+	int	a;
+	Count	k;
+
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !SetHas(&l->body,a) )
+			continue;
+		p = &insn[a];
+		if( p->code == JAL ) {
+			callee = routine[p->opr];
+			if( callee == NULL || callee->writes_any
+			    || callee->writes[m] )
+				return 0;
+		}
+		if( p->code != ST )
+			continue;
+		if( p->b == ABS_ADDR_TEXT || p->b == ABS_ADDR_DATA ) {
+			if( address(NULL,p) == m )
+				return 0;
+			continue;
+		}
+		if( reg != 2 )
+			return 0;	/* index unknown in the loop */
+		for( k = 0 ; k <= n ; k++ )
+			if( IxAddr(p->b,p->opr,v0 + step * (int)k) == m )
+				return 0;
+	}
+	return 1;
+}
+
+
+/*=============================================================================
+ *   Longest Paths
+ *
+ *	v is an instruction or IMEMORY_SIZE + a loop analyzed already.
+ *	Within the loop l a path ends at a back edge or an exit.
+ *===========================================================================*/
+Cost
+longest(Routine *r, Loop *l, int v)
+{
+	Cost	best = { 0, 0 };
+	Loop	*inner = v >= IMEMORY_SIZE ? &r->loop[v - IMEMORY_SIZE] : NULL;
+	int	a, i, s, u;
+
+	if( visit[v] == 2 )
+		return memo[v];
+	if( visit[v] == 1 ) {
+		if( !r->note[0] )
+			sprintf(r->note,"irreducible control flow at 0x%02x",
+				inner ? inner->header : v);
+		best.insns = best.cycles = UNBOUNDED;
+		return best;
+	}
+	visit[v] = 1;
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( inner ? !SetHas(&inner->body,a) : a != v )
+			continue;
+		for( i = 0 ; i < insn[a].nsucc ; i++ ) {
+			s = insn[a].succ[i];
+			if( inner != NULL && SetHas(&inner->body,s) )
+				continue;
+			if( l != NULL && (!SetHas(&l->body,s)
+					  || s == l->header) )
+				continue;
+			u = top[s] >= 0 ? IMEMORY_SIZE + top[s] : s;
+			best = cost_max(best,longest(r,l,u));
+		}
+	}
+	memo[v] = cost_add(node_cost(r,v),best);
+	visit[v] = 2;
+	return memo[v];
+}
+
+
+Cost
+node_cost(Routine *r, int v)
+{
+	Cost	c;
+
+	if( v >= IMEMORY_SIZE )
+		return r->loop[v - IMEMORY_SIZE].cost;
+	c.insns = 1;
+	c.cycles = isa_decode[insn[v].ir].cycles;
+	if( insn[v].code == JAL )
+		c = cost_add(c,routine[insn[v].opr]->wcet);
+	return c;
+}
+
+
+/*=============================================================================
+ *   Report
+ *===========================================================================*/
+static void
+print_cost(Cost c)
+{
+	if( c.insns == UNBOUNDED )
+		printf("unbounded");
+	else
+		printf("%llu instructions, %llu cycles",c.insns,c.cycles);
+}
+
+
+void
+report(Routine *r)
+{
+	Loop	*l;
+	int	a, i;
+
+	printf("routine 0x%02x%s: ",r->entry,r->entry == 0 ? " (main)" : "");
+	print_cost(r->wcet);
+	printf("%s%s%s\n",r->note[0] ? " (" : "",r->note,
+		r->note[0] ? ")" : "");
+	for( i = 0 ; i < r->nloop ; i++ ) {
+		l = &r->loop[i];
+		printf("   loop 0x%02x: ",l->header);
+		if( l->bound == UNBOUNDED )
+			printf("%s\n",l->why);
+		else {
+			printf("%llu iterations, ",l->bound);
+			print_cost(l->cost);
+			printf(" (%s)\n",l->why);
+		}
+		if( l->bound == UNBOUNDED )
+			unbounded = 1;
+	}
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ ) {
+		if( !SetHas(&r->nodes,a) )
+			continue;
+		if( insn[a].code == JR && r->entry == 0 )
+			printf("   warning: JR at 0x%02x in the main program "
+				"(the jump is not followed)\n",a);
+		if( insn[a].code == ST && (insn[a].b == ABS_ADDR_TEXT
+					   || insn[a].b == IX_MOD_ADDR_TEXT) )
+			printf("   warning: ST into the text area at 0x%02x "
+				"(the text is assumed not to change)\n",a);
+	}
+	if( r->wcet.insns == UNBOUNDED )
+		unbounded = 1;
+}
+
+
+/*
+ *   Text words no routine reaches, unless all zero
+ */
+void
+unreachable(void)
+{
+	Uword	used[IMEMORY_SIZE];
+	int	a, b, e, r;
+
+	memset(used,0,sizeof(used));
+	for( r = 0 ; r < IMEMORY_SIZE ; r++ )
+		if( routine[r] != NULL )
+			for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+				if( SetHas(&routine[r]->nodes,a) ) {
+					used[a] = 1;
+					used[(a + insn[a].len - 1) & 0xff] = 1;
+				}
+	for( a = 0 ; a < IMEMORY_SIZE ; a = e ) {
+		for( e = a ; e < IMEMORY_SIZE && used[e] == used[a] ; e++ )
+			;
+		if( used[a] )
+			continue;
+		for( b = a ; b < e && cpub.mem[b] == 0 ; b++ )
+			;
+		while( e > b && cpub.mem[e - 1] == 0 )
+			e--;
+		if( b < e )
+			printf("unreachable: 0x%02x-0x%02x\n",b,e - 1);
+		for( ; e < IMEMORY_SIZE && !used[e] ; e++ )
+			;
+	}
+}
+
+
+/*=============================================================================
+ *   Main Routine
+ *===========================================================================*/
+void
+usage(char *prog)
+{
+	fprintf(stderr,"usage: %s [options] program-file\n"
+		"   -l addr=n\t--- the loop at addr(hex) runs its header "
+		"at most n(decimal) times\n"
+		"   -d\t\t--- the initial data memory is unknown "
+		"(default: as loaded)\n"
+		"   program-file: a memory file, or assembly source (.s)\n",
+		prog);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	addr;
+	Count		n;
+	char		*ext;
+	int		opt, a;
+
+	while( (opt = getopt(argc,argv,"l:d")) != -1 ) {
+		switch( opt ) {
+		   case 'l':
+			if( sscanf(optarg,"%x=%llu",&addr,&n) != 2
+			    || addr > 0xff || n == 0 ) {
+				usage(argv[0]);
+				return 1;
+			}
+			annotation[addr] = n;
+			break;
+		   case 'd':	data_unknown = 1; break;
+		   default:	usage(argv[0]); return 1;
+		}
+	}
+	if( optind != argc - 1 ) {
+		usage(argv[0]);
+		return 1;
+	}
+	ext = strrchr(argv[optind],'.');
+	if( (ext != NULL && !strcmp(ext,".s")
+	     ? asm_file(&cpub,argv[optind])
+	     : read_mem_file(&cpub,argv[optind])) != 0 )
+		return 1;
+
+	decode();
+	analyze(0x00);
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		if( routine[a] != NULL )
+			report(routine[a]);
+	unreachable();
+	return unbounded ? 2 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	text.c
+ *	Descrioption:	text areas shared by the boards running one program
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"text.h"
+
+
+static void	text_map(Cpub *, Text *);
+static void	text_put(Text *);
+
+static Text		*texts;		/* in use */
+static pthread_mutex_t	text_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*=============================================================================
+ *   Share
+ *
+ *	The board takes the text of a board with the same words, or a new
+ *	one made from its own.  -1 if none could be allocated (the board
+ *	keeps its text in mem[]).
+ *===========================================================================*/
+int
+text_share(Cpub *cpub)
+{
+	Text			*t;
+	unsigned long long	key = 0xcbf29ce484222325ULL;	/* FNV-1a */
+	int			a;
+
+	if( cpub->text != NULL )
+		return 0;
+	for( a = 0 ; a < IMEMORY_SIZE ; a++ )
+		key = (key ^ cpub->mem[a]) * 0x100000001b3ULL;
+
+	pthread_mutex_lock(&text_lock);
+	for( t = texts ; t != NULL ; t = t->next )
+		if( t->key == key && !memcmp(t->word,cpub->mem,IMEMORY_SIZE) )
+			break;
+	if( t == NULL ) {
+		if( (t = malloc(sizeof(Text))) == NULL ) {
+			pthread_mutex_unlock(&text_lock);
+			fprintf(stderr,"Unable to allocate a shared text\n");
+			return -1;
+		}
+		t->refs = 0;
+		t->key = key;
+		t->seg = NULL;
+		memcpy(t->word,cpub->mem,IMEMORY_SIZE);
+		t->next = texts;
+		texts = t;
+	}
+	t->refs++;
+	pthread_mutex_unlock(&text_lock);
+	text_map(cpub,t);
+	return 0;
+}
+
+
+/*
+ *   The board takes the given text (of another board) without looking
+ *   at its own, which need not be loaded
+ */
+void
+text_attach(Cpub *cpub, Text *t)
+{
+	Text	*old = cpub->text;
+
+	if( old == t )
+		return;
+	pthread_mutex_lock(&text_lock);
+	t->refs++;
+	pthread_mutex_unlock(&text_lock);
+	text_map(cpub,t);
+	if( old != NULL )
+		text_put(old);
+}
+
+
+/*=============================================================================
+ *   Private Clone (copy-on-write)
+ *===========================================================================*/
+void
+text_private(Cpub *cpub)
+{
+	Text	*t = cpub->text;
+	int	i;
+
+	if( t == NULL )
+		return;
+	memcpy(cpub->mem,t->word,IMEMORY_SIZE);
+	for( i = 0 ; i < PAGES / 2 ; i++ )
+		cpub->page[i] = cpub->mem + (i << PAGE_SHIFT);
+	cpub->text = NULL;
+	text_put(t);
+}
+
+
+static void
+text_map(Cpub *cpub, Text *t)
+{
+	int	i;
+
+	for( i = 0 ; i < PAGES / 2 ; i++ )
+		cpub->page[i] = t->word + (i << PAGE_SHIFT);
+	cpub->text = t;
+}
+
+
+/*
+ *   The last reference frees the text and its superinstructions
+ */
+static void
+text_put(Text *t)
+{
+	Text	**p;
+
+	pthread_mutex_lock(&text_lock);
+	if( --t->refs == 0 ) {
+		for( p = &texts ; *p != t ; p = &(*p)->next )
+			;
+		*p = t->next;
+		free(t->seg);
+		free(t);
+	}
+	pthread_mutex_unlock(&text_lock);
+}
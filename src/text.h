@@ -0,0 +1,38 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	text.h
+ *	Descrioption:	text areas shared by the boards running one program
+ */
+
+/*=============================================================================
+ *   Shared Text
+ *
+ *	The text area of the boards with the same program, kept once with
+ *	counted references and never written.  A board reads it through
+ *	its text pages (MemAt(), TextOf()); its own mem[] text area is not
+ *	used meanwhile.  Anything storing into the text (store(), set_mem(),
+ *	gdb, a program load) first calls text_private(), which clones the
+ *	words back into the board's mem[] and drops the reference.  Texts
+ *	are looked up by a hash of the words under a lock, so the boards of
+ *	different threads find each other's.
+ *
+ *	The text area of mem[] stays in every Cpub, so sharing saves no
+ *	memory per board: what is shared is the copy the boards read (one
+ *	set of cache lines) and its superinstructions (fuse.c), and a board
+ *	taking a text copies nothing.  Dropping the area from Cpub would
+ *	move the whole memory layout (snapshots, simaot's code, the files)
+ *	for 256 bytes a board.
+ *===========================================================================*/
+typedef struct text {
+	struct text	*next;
+	int		refs;
+	unsigned long long	key;		/* hash of the words */
+	struct segment	*seg;		/* superinstructions (fuse.c) */
+	Uword		word[IMEMORY_SIZE];
+} Text;
+
+int	text_share(Cpub *);
+void	text_attach(Cpub *, Text *);
+void	text_private(Cpub *);
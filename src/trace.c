@@ -0,0 +1,262 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	trace.c
+ *	Descrioption:	binary execution trace with a background writer
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"dev.h"
+#include	"trace.h"
+
+
+static void	*trace_writer(void *);
+static void	trace_handoff(Trace *);
+
+
+/*=============================================================================
+ *   Open/Close a Trace of a CPU Board
+ *===========================================================================*/
+int
+trace_open(Cpub *cpub, int cpub_id, char *file)
+{
+	Trace		*tr;
+	unsigned char	header[TRACE_HEADER_SIZE];
+
+	if( cpub->trace != NULL )
+		trace_close(cpub);
+
+	if( (tr = malloc(sizeof(Trace))) == NULL ) {
+		fprintf(stderr,"Unable to allocate a trace buffer\n");
+		return -1;
+	}
+	if( (tr->fp = fopen(file,"wb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		free(tr);
+		return -1;
+	}
+
+	memcpy(header,TRACE_MAGIC,8);
+	header[8] = TRACE_VERSION;
+	header[9] = cpub_id;
+	fwrite(header,1,TRACE_HEADER_SIZE,tr->fp);
+
+	tr->pending = -1;
+	tr->done = 0;
+	tr->cur = 0;
+	tr->p = tr->page[0];
+	tr->end = tr->page[0] + TRACE_PAGE_SIZE;
+	tr->next_pc = -1;
+	tr->count = 0;
+	pthread_mutex_init(&tr->lock,NULL);
+	pthread_cond_init(&tr->cond,NULL);
+	if( pthread_create(&tr->writer,NULL,trace_writer,tr) != 0 ) {
+		fprintf(stderr,"Unable to start the trace writer\n");
+		fclose(tr->fp);
+		free(tr);
+		return -1;
+	}
+
+	cpub->trace = tr;
+	trace_snapshot(cpub);
+	return 0;
+}
+
+
+void
+trace_close(Cpub *cpub)
+{
+	Trace	*tr = cpub->trace;
+
+	if( tr == NULL )
+		return;
+
+	trace_handoff(tr);
+
+	pthread_mutex_lock(&tr->lock);
+	while( tr->pending != -1 )
+		pthread_cond_wait(&tr->cond,&tr->lock);
+	tr->done = 1;
+	pthread_cond_broadcast(&tr->cond);
+	pthread_mutex_unlock(&tr->lock);
+	pthread_join(tr->writer,NULL);
+
+	fprintf(stderr,"Trace: %llu instructions recorded.\n",tr->count);
+	fclose(tr->fp);
+	pthread_mutex_destroy(&tr->lock);
+	pthread_cond_destroy(&tr->cond);
+	free(tr);
+	cpub->trace = NULL;
+}
+
+
+/*=============================================================================
+ *   Double Buffering
+ *
+ *	The simulator fills one page while the writer thread drains the
+ *	other, so it only waits when the disk falls a whole page behind.
+ *===========================================================================*/
+static void
+trace_handoff(Trace *tr)
+{
+	pthread_mutex_lock(&tr->lock);
+	while( tr->pending != -1 )
+		pthread_cond_wait(&tr->cond,&tr->lock);
+	tr->fill[tr->cur] = tr->p - tr->page[tr->cur];
+	tr->pending = tr->cur;
+	pthread_cond_broadcast(&tr->cond);
+	pthread_mutex_unlock(&tr->lock);
+
+	tr->cur ^= 1;
+	tr->p = tr->page[tr->cur];
+	tr->end = tr->p + TRACE_PAGE_SIZE;
+}
+
+
+static void *
+trace_writer(void *arg)
+{
+	Trace	*tr = arg;
+	int	idx;
+
+	pthread_mutex_lock(&tr->lock);
+	while( 1 ) {
+		while( tr->pending == -1 && !tr->done )
+			pthread_cond_wait(&tr->cond,&tr->lock);
+		if( tr->pending == -1 )
+			break;	/* done */
+		idx = tr->pending;
+		pthread_mutex_unlock(&tr->lock);
+
+		fwrite(tr->page[idx],1,tr->fill[idx],tr->fp);
+
+		pthread_mutex_lock(&tr->lock);
+		tr->pending = -1;
+		pthread_cond_broadcast(&tr->cond);
+	}
+	pthread_mutex_unlock(&tr->lock);
+	return NULL;
+}
+
+
+/*=============================================================================
+ *   Execute an Instruction with Tracing
+ *
+ *	The devices are served first, as step_full() does, so that the
+ *	record starts from the handler when an interrupt is taken.  No
+ *	record is written when no instruction ran (still asleep, or halted
+ *	by a device).
+ *===========================================================================*/
+int
+trace_step(Cpub *cpub)
+{
+	Trace		*tr = cpub->trace;
+	Uword		pc, acc, ix, flags, io, obuf, opr;
+	unsigned char	*p, mask;
+	int		status;
+
+	if( cpub->dev != NULL && cpub->cycle >= cpub->dev->next ) {
+		status = dev_service(cpub);
+		if( status != RUN_STEP )
+			return status == DEV_ASLEEP ? RUN_STEP : RUN_HALT;
+	}
+	pc = cpub->pc;
+	acc = cpub->acc;
+	ix = cpub->ix;
+	flags = PackedFlags(cpub);
+	io = TraceIO(cpub);
+	obuf = cpub->obuf.buf;
+	opr = TextOf(cpub)[(Uword)(pc + 1)];
+
+	cpub->wf = 0;
+	status = step_counted(cpub);
+
+	if( tr->p + TRACE_RECORD_MAX > tr->end )
+		trace_handoff(tr);
+
+	/*
+	 *   Append only what has changed
+	 */
+	p = tr->p + 1;
+	mask = 0;
+	if( pc != tr->next_pc ) {	/* jumped or set by hand */
+		mask |= TR_PC;
+		*p++ = pc;
+	}
+	*p++ = cpub->ir;
+	if( cpub->mar == (Uword)(pc + 1) ) {
+		mask |= TR_OPR;
+		*p++ = opr;
+	}
+	if( cpub->acc != acc ) {
+		mask |= TR_ACC;
+		*p++ = cpub->acc;
+	}
+	if( cpub->ix != ix ) {
+		mask |= TR_IX;
+		*p++ = cpub->ix;
+	}
+	if( PackedFlags(cpub) != flags ) {
+		mask |= TR_FLAGS;
+		*p++ = PackedFlags(cpub);
+	}
+	if( TraceIO(cpub) != io || cpub->obuf.buf != obuf ) {
+		mask |= TR_IO;
+		*p++ = TraceIO(cpub);
+		*p++ = cpub->obuf.buf;
+	}
+	if( cpub->wf ) {
+		mask |= TR_MEM;
+		*p++ = cpub->wa & 0xff;
+		*p++ = cpub->wa >> 8;
+		*p++ = MemAt(cpub,cpub->wa);
+	}
+	if( status == RUN_HALT )
+		mask |= TR_HALT;
+	*tr->p = mask;
+	tr->p = p;
+
+	tr->next_pc = (Uword)(pc + ((mask & TR_OPR) ? 2 : 1));
+	tr->count++;
+	return status;
+}
+
+
+/*=============================================================================
+ *   Full State
+ *
+ *	After the header, and after the state is changed at the prompt or
+ *	by the debugger (s, w, r, asm; register and memory writes of gdb).
+ *	The memory is as the board sees it (text and data pages).
+ *===========================================================================*/
+void
+trace_snapshot(Cpub *cpub)
+{
+	Trace		*tr = cpub->trace;
+	unsigned char	*p;
+	int		a;
+
+	if( tr == NULL )
+		return;
+	if( tr->p + TRACE_SNAP_SIZE > tr->end )
+		trace_handoff(tr);
+
+	p = tr->p;
+	*p++ = TR_SNAP;
+	*p++ = cpub->pc;
+	*p++ = cpub->acc;
+	*p++ = cpub->ix;
+	*p++ = PackedFlags(cpub);
+	*p++ = TraceIO(cpub);
+	*p++ = cpub->obuf.buf;
+	*p++ = cpub->ibuf->buf;
+	for( a = 0 ; a < MEMORY_SIZE ; a++ )
+		*p++ = MemAt(cpub,a);
+	tr->p = p;
+	tr->next_pc = cpub->pc;
+}
@@ -0,0 +1,69 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	trace.h
+ *	Descrioption:	binary execution trace (writer and record format)
+ */
+
+#include	<pthread.h>
+
+/*=============================================================================
+ *   Trace File Format
+ *
+ *	header:	"CPUTRACE" version(1) board-id(1)
+ *	record:	mask(1) [pc] ir [operand] [acc] [ix] [flags]
+ *		[of|if<<1 obuf] [addr-lo addr-hi value]
+ *	state:	TR_SNAP(1) pc acc ix flags of|if<<1 obuf ibuf mem[000-1ff]
+ *
+ *	Only the fields flagged in the mask byte are present.  The pc is
+ *	omitted when it directly follows the previous instruction (or the
+ *	pc of a state record).  A state record follows the header and is
+ *	written again whenever the state is changed by hand, so a record
+ *	is always relative to a known state.
+ *===========================================================================*/
+#define	TRACE_MAGIC	"CPUTRACE"
+#define	TRACE_VERSION	2
+#define	TRACE_HEADER_SIZE	10
+
+#define	TR_PC		0x01	/* pc is not sequential */
+#define	TR_OPR		0x02	/* second word */
+#define	TR_ACC		0x04
+#define	TR_IX		0x08
+#define	TR_FLAGS	0x10	/* cf<<3 | vf<<2 | nf<<1 | zf */
+#define	TR_IO		0x20	/* obuf.flag | ibuf->flag<<1, obuf.buf */
+#define	TR_MEM		0x40	/* memory write */
+#define	TR_HALT		0x80
+#define	TR_SNAP		(TR_MEM | TR_HALT)	/* full state: a halting */
+						/* instruction writes nothing */
+
+#define	TRACE_RECORD_MAX	12
+#define	TRACE_SNAP_SIZE		(8 + MEMORY_SIZE)
+
+#define	TraceIO(C)	((C)->obuf.flag | (C)->ibuf->flag<<1)
+
+
+/*=============================================================================
+ *   Trace Writer
+ *===========================================================================*/
+#define	TRACE_PAGE_SIZE	(64*1024)
+
+typedef struct trace {
+	FILE		*fp;
+	pthread_t	writer;		/* background writer thread */
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int		pending;	/* page handed to the writer (-1: none) */
+	int		done;
+	int		cur;		/* page being filled */
+	size_t		fill[2];
+	unsigned char	*p, *end;	/* write pointer in the current page */
+	int		next_pc;	/* pc expected by the next record */
+	unsigned long long	count;	/* records written */
+	unsigned char	page[2][TRACE_PAGE_SIZE];
+} Trace;
+
+int	trace_open(Cpub *, int, char *);
+void	trace_close(Cpub *);
+int	trace_step(Cpub *);
+void	trace_snapshot(Cpub *);
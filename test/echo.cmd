@@ -0,0 +1,5 @@
+r ../test/echo.txt
+io in echo.in
+io out /dev/null
+c
+q
@@ -0,0 +1,13 @@
+; flags.s: flag dependencies of the pipeline model (simpipe).
+; RLA rotates through cf, which SLL IX sets: a flags stall without
+; forwarding.  RRL does not read cf, and BNI tests the input flag
+; only: no stall.
+	.text 00
+	LD	IX,81
+	SLL	IX
+	RLA	ACC
+	SLL	IX
+	RRL	ACC
+	SLL	IX
+	BNI	next
+next:	HLT
@@ -0,0 +1,7 @@
+r ../test/irq.txt
+dev intc 00
+dev timer 10
+trace irq.tr
+c 44
+trace off
+q